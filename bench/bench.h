@@ -0,0 +1,25 @@
+/* Aerials Audio Core Benchmarks */
+#pragma once
+
+// Shared by the benchmarks under bench/, which are built next to the tests but not run by ctest:
+// each one includes core.cpp first, runs on the null backend, and prints one line per case.
+
+/* Includes */
+#include "test.h"
+
+
+/* Timing */
+inline double AmBenchSeconds() {
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// Calls fn(i) n times, & prints the nanoseconds per call
+template<typename F>
+double AmBench(const char* name, uint32_t n, const F& fn) {
+	const auto start = AmBenchSeconds();
+	for(uint32_t i = 0; i < n; i++)
+		fn(i);
+	const auto ns = ( AmBenchSeconds() - start ) * 1e9 / n;
+	printf("%-40s %10.1f ns\n", name, ns);
+	return ns;
+}
@@ -0,0 +1,64 @@
+/* Decode Benchmark */
+// Decode throughput of AmDecodePCM, i.e. what CreateResource spends per buffer before metering & compaction:
+// a synthesized 16-bit WAV & Ogg Vorbis by default, and any files given on the command line besides, each decoded n times.
+// There is no MP3 encoder at hand, so MP3s are timed against Vorbis from files, e.g. ./bench_decode 20 song.mp3 song.ogg
+#include "core.cpp"
+#include "bench.h"
+#include "vorbis.h"
+
+static bool AmBenchRead(const char* path, std::vector<uint8_t>& out) {
+	const auto f = fopen(path, "rb");
+	if(!f)
+		return false;
+	fseek(f, 0, SEEK_END);
+	out.resize( (size_t)ftell(f) );
+	fseek(f, 0, SEEK_SET);
+	const auto ok = fread(out.data(), 1, out.size(), f) == out.size();
+	fclose(f);
+	return ok;
+}
+
+// Decodes buf n times into the Player format, & prints the time per decode & the audio decoded per second of work
+static void AmBenchDecode(const char* name, const std::vector<uint8_t>& buf, uint32_t n, ma_uint32 channels, ma_uint32 rate) {
+	ma_uint64 frames = 0;
+	const auto ns = AmBench(name, n, [&](uint32_t) {
+		const auto P = AmDecodePCM(buf.data(), buf.size(), channels, rate);
+		AM_CHECK(P);
+		frames = P -> Frames;
+		AmPCMRelease(P);
+	});
+	printf("%-40s %10.1f x realtime\n", "", (double)frames / rate * 1e9 / ns);
+}
+
+int main(int argc, char** argv) {
+	const uint32_t n = ( argc > 1 ) ? (uint32_t)atoi(argv[1]) : 20;
+	AcAudio::Config config;
+	const char* error = nullptr;
+	AM_CHECK( AcAudio::Init(config, error) );
+	const auto channels = ma_engine_get_channels(&PlayerEngine);
+	const auto rate = ma_engine_get_sample_rate(&PlayerEngine);
+
+	// Ten seconds of WAV, at the device rate & at 44.1 kHz against it (resampled), then of stereo Vorbis at the device rate
+	AmBenchDecode( "WAV 10 s", AmTestSine(rate * 10, 2, rate, 440.0f), n, channels, rate );
+	AmBenchDecode( "WAV 10 s, 44.1 kHz source", AmTestSine(441000, 2, 44100, 440.0f), n, channels, rate );
+	AmBenchDecode( "Vorbis 10 s", AmTestVorbis(rate * 10, 2, rate, [rate](uint32_t f, uint32_t c) {
+		return 0.3f * sinf(6.2831853f * (c ? 440.0f : 660.0f) * f / rate) + 0.1f * sinf(6.2831853f * 3000.0f * f / rate);
+	}), n, channels, rate );
+
+	// Files, labelled by format, e.g. ./bench_decode 20 song.mp3
+	for(int i = 2; i < argc; i++) {
+		std::vector<uint8_t> buf;
+		if( !AmBenchRead(argv[i], buf) ) {
+			fprintf(stderr, "%s: unreadable\n", argv[i]);
+			continue;
+		}
+		const char* format = (buf.size() >= 4 && memcmp(buf.data(), "OggS", 4) == 0) ? "Vorbis"
+						   : (buf.size() >= 4 && memcmp(buf.data(), "RIFF", 4) == 0) ? "WAV" : "MP3";
+		char name[256];
+		snprintf(name, sizeof(name), "%s %s", format, argv[i]);
+		AmBenchDecode(name, buf, n, channels, rate);
+	}
+
+	AcAudio::Final();
+	return 0;
+}
@@ -0,0 +1,50 @@
+/* FFI Fast Path Benchmark */
+// The ffi.h exports against the AcAudio:: calls they wrap, i.e. what the FFI path adds over the core itself.
+// The Lua C API path (argument checks, luaL_checkudata, pushes) needs a Lua state: lua/acaudio_bench.lua times it in-engine.
+#include "core.cpp"
+#include "ffi.h"
+#include "bench.h"
+
+static volatile double AmSink;   // Keeps the results alive
+
+int main(int argc, char** argv) {
+	const uint32_t n = ( argc > 1 ) ? (uint32_t)atoi(argv[1]) : 2000000;
+	AcAudio::Config config;
+	const char* error = nullptr;
+	AM_CHECK( AcAudio::Init(config, error) );
+	const auto rate = ma_engine_get_sample_rate(&PlayerEngine);
+	const auto wav = AmTestSine(rate, 2, rate, 440.0f);
+	const auto R = AcAudio::CreateResource(wav.data(), wav.size(), false, 0.0, false, error);
+	AM_CHECK(R);
+	double length_ms;
+	const auto U = AcAudio::CreateUnit(R, length_ms);
+	AM_CHECK(U);
+	AmHandle H = { U, AcAudio::Generation(), AM_HANDLE_UNIT };   // As ext.cpp allocates it
+
+	// Queries
+	AmBench("GetTime (direct)", n, [&](uint32_t) { AmSink = AcAudio::GetTime(U); });
+	AmBench("GetTime (FFI)", n, [&](uint32_t) { AmSink = AcAudioFfiGetTime(&H); });
+	AmBench("GetTimeFrames (direct)", n, [&](uint32_t) { AmSink = (double)AcAudio::GetTimeFrames(U); });
+	AmBench("GetTimeFrames (FFI)", n, [&](uint32_t) { AmSink = (double)AcAudioFfiGetTimeFrames(&H); });
+	AmBench("CheckPlaying (direct)", n, [&](uint32_t) { AmSink = AcAudio::CheckPlaying(U); });
+	AmBench("CheckPlaying (FFI)", n, [&](uint32_t) { AmSink = AcAudioFfiCheckPlaying(&H); });
+
+	// Play/Stop pairs, with the device stopped so that the rings get drained here instead
+	ma_engine_stop(&PlayerEngine);
+	const auto m = n / 16;
+	AmBench("PlayUnit + StopUnit (direct)", m, [&](uint32_t) {
+		AcAudio::PlayUnit(U, false, 0.0);
+		AcAudio::StopUnit(U, true);
+		AmApplyCommands();
+	});
+	AmBench("PlayUnit + StopUnit (FFI)", m, [&](uint32_t) {
+		AcAudioFfiPlayUnit(&H, 0, 0.0);
+		AcAudioFfiStopUnit(&H, 1);
+		AmApplyCommands();
+	});
+
+	AcAudio::ReleaseUnit(U);
+	AcAudio::ReleaseResource(R);
+	AcAudio::Final();
+	return 0;
+}
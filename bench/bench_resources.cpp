@@ -0,0 +1,42 @@
+/* Batch Decode Benchmark */
+// AcAudio::CreateResources on a keysound set at 1, 2, 4 & one thread per core, for the scaling of job_threads.
+// JobThreads is set directly between the runs, as Init() would from the Config; every run releases what it created.
+#include "core.cpp"
+#include "bench.h"
+
+int main(int argc, char** argv) {
+	const uint32_t n = ( argc > 1 ) ? (uint32_t)atoi(argv[1]) : 5;
+	const uint32_t count = ( argc > 2 ) ? (uint32_t)atoi(argv[2]) : 64;
+	AcAudio::Config config;
+	const char* error = nullptr;
+	AM_CHECK( AcAudio::Init(config, error) );
+	const auto rate = ma_engine_get_sample_rate(&PlayerEngine);
+
+	// Half-second keysounds at 44.1 kHz, so that every one gets resampled too
+	std::vector< std::vector<uint8_t> > wavs;
+	std::vector<AcAudio::Bytes> bufs;
+	for(uint32_t i = 0; i < count; i++)
+		wavs.push_back( AmTestSine(22050, 2, 44100, 220.0f + 10.0f * i) );
+	for(const auto& wav : wavs)
+		bufs.push_back( { wav.data(), wav.size() } );
+
+	const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+	const uint32_t threads[] = { 1, 2, 4, cores };
+	printf("%u keysounds, %u cores, device rate %u\n", count, cores, rate);
+	for(const bool extra : { false, true })
+		for(const auto t : threads) {
+			JobThreads = std::min(t, (ma_uint32)MA_RESOURCE_MANAGER_MAX_JOB_THREAD_COUNT);
+			char name[64];
+			snprintf(name, sizeof(name), "%s, %u threads", extra ? "Normalize + compact" : "Decode", JobThreads);
+			std::vector<AmResource*> Rs;
+			AmBench(name, n, [&](uint32_t) {
+				AM_CHECK( AcAudio::CreateResources(bufs, extra, -14.0, extra, Rs, error) );
+				for(const auto R : Rs)
+					AcAudio::ReleaseResource(R);
+				AcAudio::Update();   // As a frame would, freeing whatever got retired
+			});
+		}
+
+	AcAudio::Final();
+	return 0;
+}
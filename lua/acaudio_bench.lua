@@ -0,0 +1,62 @@
+-- AcAudio Fast Path Benchmark
+--
+-- Times the acaudio_fast functions against the AcAudio ones in a loop over one unit, and prints the ns per call;
+-- unlike bench/bench_ffi, this goes through the Lua C API path (argument checks, userdata checks, pushes) too.
+-- Run it by hand once the engine is up, with a unit of any resource, e.g.
+--     require("acaudio.lua.acaudio_bench").Run(unit, 200000)
+-- The FFI rows only differ from the C API ones with the JIT on; the header line tells which path Fast takes.
+--
+local Fast = require "acaudio.lua.acaudio_fast"
+local M = {}
+
+local Now = AcAudio.GetMonotonicNs
+local BATCH = 256   -- PlayUnit + StopUnit pairs, i.e. half the command queue, between drains by the audio thread
+
+local function Report(name, ns, n)
+    print(string.format("%-34s %8.1f ns per call", name, ns / n))
+end
+
+local function TimeQuery(name, fn, unit, n)
+    fn(unit)   -- Warm up, & let the loop below get traced
+    local start = Now()
+    for _ = 1, n do
+        fn(unit)
+    end
+    Report(name, Now() - start, n)
+end
+
+local function TimePlayStop(name, play, stop, unit, n)
+    -- Batches, so that a full queue never fails the calls; the waits for the audio thread are left out
+    local ns, failed, done = 0, 0, 0
+    while done < n do
+        local m = math.min(BATCH, n - done)
+        local start = Now()
+        for _ = 1, m do
+            if not play(unit, false, 0) then failed = failed + 1 end
+            stop(unit, true)
+        end
+        ns = ns + (Now() - start)
+        done = done + m
+        local until_ns = Now() + 20e6
+        while Now() < until_ns do end
+    end
+    Report(name, ns, 2 * n)
+    if failed > 0 then
+        print(string.format("%-34s %8d PlayUnit calls failed", "", failed))
+    end
+end
+
+function M.Run(unit, n)
+    n = n or 200000
+    print(string.format("acaudio_fast: %s path, %d calls per query", Fast.ffi and "FFI" or "C API", n))
+    TimeQuery("GetTime (C API)", AcAudio.GetTime, unit, n)
+    TimeQuery("GetTime (fast)", Fast.GetTime, unit, n)
+    TimeQuery("GetTimeFrames (C API)", AcAudio.GetTimeFrames, unit, n)
+    TimeQuery("GetTimeFrames (fast)", Fast.GetTimeFrames, unit, n)
+    TimeQuery("CheckPlaying (C API)", AcAudio.CheckPlaying, unit, n)
+    TimeQuery("CheckPlaying (fast)", Fast.CheckPlaying, unit, n)
+    TimePlayStop("PlayUnit + StopUnit (C API)", AcAudio.PlayUnit, AcAudio.StopUnit, unit, math.floor(n / 16))
+    TimePlayStop("PlayUnit + StopUnit (fast)", Fast.PlayUnit, Fast.StopUnit, unit, math.floor(n / 16))
+end
+
+return M
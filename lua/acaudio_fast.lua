@@ -0,0 +1,74 @@
+-- AcAudio Fast Path
+--
+-- PlayUnit, StopUnit, CheckPlaying, GetTime & GetTimeFrames through the LuaJIT FFI,
+-- so that hot gameplay loops stay in JIT traces; the AcAudio functions otherwise.
+-- Same arguments & returns as the AcAudio functions; M.ffi tells which path is taken.
+--
+local M = {
+    PlayUnit = AcAudio.PlayUnit,
+    StopUnit = AcAudio.StopUnit,
+    CheckPlaying = AcAudio.CheckPlaying,
+    GetTime = AcAudio.GetTime,
+    GetTimeFrames = AcAudio.GetTimeFrames,
+    ffi = false,
+}
+
+-- Only with the JIT on, since interpreted FFI calls are slower than the C API;
+-- and only if unit handles can be told apart, since C can't check what it gets
+local has_ffi, ffi = pcall(require, "ffi")
+local Unit = AcAudio.UnitMetatable
+if not ( has_ffi and jit and jit.status() and Unit ) then
+    return M
+end
+
+ffi.cdef [[
+    int AcAudioFfiPlayUnit(void* unit, int is_looping, double delay_ms);
+    int AcAudioFfiStopUnit(void* unit, int rewind);
+    int AcAudioFfiCheckPlaying(void* unit);
+    double AcAudioFfiGetTime(void* unit);
+    int64_t AcAudioFfiGetTimeFrames(void* unit);
+]]
+
+-- The engine may not export them (e.g. static builds stripping the symbols)
+local C = ffi.C
+if not pcall(function() return C.AcAudioFfiGetTimeFrames end) then
+    return M
+end
+
+local getmetatable, tonumber = getmetatable, tonumber
+local Play, Stop, Playing = C.AcAudioFfiPlayUnit, C.AcAudioFfiStopUnit, C.AcAudioFfiCheckPlaying
+local Time, TimeFrames = C.AcAudioFfiGetTime, C.AcAudioFfiGetTimeFrames
+
+-- Anything but a unit handle (light userdata, other modules' userdata, cdata...) would reach C as some pointer,
+-- so only values with the unit metatable get through; a released or stale handle then fails in C
+function M.PlayUnit(unit, is_looping, delay_ms)
+    return getmetatable(unit) == Unit and Play(unit, is_looping and 1 or 0, delay_ms or 0) == 1
+end
+
+function M.StopUnit(unit, rewind_to_start)
+    return getmetatable(unit) == Unit and Stop(unit, rewind_to_start and 1 or 0) == 1
+end
+
+function M.CheckPlaying(unit)
+    if getmetatable(unit) ~= Unit then return nil end
+    local status = Playing(unit)
+    if status < 0 then return nil end
+    return status == 1
+end
+
+function M.GetTime(unit)
+    if getmetatable(unit) ~= Unit then return nil end
+    local ms = Time(unit)
+    if ms < 0 then return nil end
+    return ms
+end
+
+function M.GetTimeFrames(unit)
+    if getmetatable(unit) ~= Unit then return nil end
+    local frames = TimeFrames(unit)
+    if frames < 0 then return nil end
+    return tonumber(frames)
+end
+
+M.ffi = true
+return M
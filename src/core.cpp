@@ -0,0 +1,4527 @@
+/* Aerials Audio Core */
+// See core.h; nothing in here depends on dmsdk or Lua.
+
+/* Includes */
+#include "core.h"
+#include <miniaudio.h>   // Trimmings are moved to ext.manifest now
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <new>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#ifdef _WIN32
+	#ifndef NOMINMAX
+	#define NOMINMAX
+	#endif
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/resource.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+#if defined(__linux__)   // Android included
+	#include <sys/syscall.h>
+#endif
+
+
+/* Callback Profiling */
+// Written by the audio threads only, read by the Lua thread through GetStats().
+
+struct AmEngineStats {
+	std::atomic<uint64_t> Callbacks, Frames;
+	std::atomic<uint32_t> Histogram[AM_STATS_BUCKETS];
+	std::atomic<uint32_t> Underruns, LateCallbacks;   // Gap > 2 periods / Processing > 1 period
+	std::atomic<uint32_t> PeakVoices;
+	std::atomic<float> Load, PeakLoad;   // Processing time / Period budget, Load is smoothed
+	std::atomic<int> Priority;   // AmPriority applied to the device thread by its first callback
+	std::atomic<uint32_t> Cores;   // Cores the device thread is pinned to, 0 if not pinned
+	uint64_t LastStartNs;   // Audio thread only
+};
+AmEngineStats PlayerStats, PreviewStats;
+std::atomic<uint32_t> PlayerVoices;   // Units started and not yet stopped or ended
+
+inline uint64_t AmNowNs() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count();
+}
+
+static void AmStatsRecord(AmEngineStats& St, uint64_t T0, uint64_t T1, uint32_t frames, uint32_t rate, uint32_t voices) {
+	const double budget = (double)frames * 1e9 / (double)rate;   // ns
+	const float load = (float)( (double)(T1 - T0) / budget );
+
+	// Relaxed single-writer updates: the Lua thread only needs a roughly consistent snapshot
+	int bucket = (int)(load * 8.0f);
+	bucket = (bucket < AM_STATS_BUCKETS) ? bucket : AM_STATS_BUCKETS - 1;
+	St.Histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+	St.Callbacks.fetch_add(1, std::memory_order_relaxed);
+	St.Frames.fetch_add(frames, std::memory_order_relaxed);
+	if(load > 1.0f)
+		St.LateCallbacks.fetch_add(1, std::memory_order_relaxed);
+
+	// A gap over 1s means the device was stopped & restarted, rather than an underrun
+	if(St.LastStartNs) {
+		const auto gap = T0 - St.LastStartNs;
+		if( (gap > 2.0 * budget) && (gap < 1000000000ull) )
+			St.Underruns.fetch_add(1, std::memory_order_relaxed);
+	}
+	St.LastStartNs = T0;
+
+	St.Load.store( St.Load.load(std::memory_order_relaxed) * 0.9f + load * 0.1f, std::memory_order_relaxed );
+	if( load > St.PeakLoad.load(std::memory_order_relaxed) )
+		St.PeakLoad.store(load, std::memory_order_relaxed);
+	if( voices > St.PeakVoices.load(std::memory_order_relaxed) )
+		St.PeakVoices.store(voices, std::memory_order_relaxed);
+}
+
+
+/* Thread Scheduling */
+// Device threads belong to the backends, so they get raised & pinned from inside their first callback;
+// worker threads lower themselves when they start. Levels come from the Config given to Init().
+int AudioPriority = AM_PRIORITY_REALTIME, JobPriority = AM_PRIORITY_LOW;
+std::atomic<int> JobPriorityApplied(AM_PRIORITY_DEFAULT);   // By the last worker started
+#if defined(__linux__)
+cpu_set_t BigCores;   // The cores of the highest max frequency, on big.LITTLE SoCs
+uint32_t BigCoreCount;   // 0 if all cores are alike, or pinning is disabled
+#endif
+
+static void AmFindBigCores() {   // Lua thread, in Init()
+#if defined(__linux__)
+	CPU_ZERO(&BigCores);
+	BigCoreCount = 0;
+	const long n = std::min<long>( sysconf(_SC_NPROCESSORS_CONF), CPU_SETSIZE );
+	std::vector<unsigned long> freqs( n > 0 ? n : 0, 0 );
+	unsigned long top = 0;
+	for(long i = 0; i < n; i++) {
+		char path[96];
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%ld/cpufreq/cpuinfo_max_freq", i);
+		if( auto f = fopen(path, "r") ) {
+			if( fscanf(f, "%lu", &freqs[i]) != 1 )
+				freqs[i] = 0;
+			fclose(f);
+		}
+		top = std::max(top, freqs[i]);
+	}
+	for(long i = 0; i < n; i++)
+		if(top && freqs[i] == top) {
+			CPU_SET(i, &BigCores);
+			BigCoreCount++;
+		}
+	if(BigCoreCount == (uint32_t)n)
+		BigCoreCount = 0;   // Homogeneous; leave it to the scheduler
+#endif
+}
+static int AmRaiseThread(int level) {   // Returns the level applied to the calling thread
+	if(level <= AM_PRIORITY_DEFAULT)
+		return AM_PRIORITY_DEFAULT;
+#if defined(_WIN32)
+	if( level >= AM_PRIORITY_REALTIME && SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) )
+		return AM_PRIORITY_REALTIME;
+	if( SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST) )
+		return AM_PRIORITY_HIGH;
+#elif defined(__linux__)
+	int policy;
+	sched_param sp;
+	if( pthread_getschedparam(pthread_self(), &policy, &sp) == 0 && (policy == SCHED_FIFO || policy == SCHED_RR) )
+		return AM_PRIORITY_REALTIME;   // Already, e.g. AAudio's low-latency callback thread
+	if(level >= AM_PRIORITY_REALTIME) {
+		sp.sched_priority = std::min( sched_get_priority_min(SCHED_FIFO) + 2, sched_get_priority_max(SCHED_FIFO) );
+		if( pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) == 0 )
+			return AM_PRIORITY_REALTIME;
+	}
+	if( setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), -16) == 0 )   // Android's THREAD_PRIORITY_AUDIO
+		return AM_PRIORITY_HIGH;
+#endif
+	return AM_PRIORITY_DEFAULT;   // Refused, or left to the OS; CoreAudio's IO threads are real-time already
+}
+static uint32_t AmPinThread() {   // Returns the count of cores the calling thread got pinned to
+#if defined(__linux__)
+	if( BigCoreCount && sched_setaffinity(0, sizeof(BigCores), &BigCores) == 0 )
+		return BigCoreCount;
+#endif
+	return 0;
+}
+static void AmLowerThread() {   // Called first by worker threads; never on the Lua thread
+	if(JobPriority >= AM_PRIORITY_DEFAULT)
+		return;
+	int applied = AM_PRIORITY_DEFAULT;
+#if defined(_WIN32)
+	if( SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL) )
+		applied = AM_PRIORITY_LOW;
+#elif defined(__APPLE__)
+	if( pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0) == 0 )
+		applied = AM_PRIORITY_LOW;
+#elif defined(__linux__)
+	if( setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10) == 0 )   // Android's THREAD_PRIORITY_BACKGROUND
+		applied = AM_PRIORITY_LOW;
+#endif
+	JobPriorityApplied.store(applied, std::memory_order_relaxed);
+}
+
+
+/* Command Queue */
+// Single-producer/single-consumer ring; Head is written by the producer only, and Tail by the consumer only.
+template<typename T, uint32_t N> struct AmRing {
+	static_assert( (N & (N-1)) == 0, "AmRing capacity must be a power of 2" );
+	T Slots[N];
+	std::atomic<uint32_t> Head, Tail;
+
+	bool Push(const T& v) {
+		const auto h = Head.load(std::memory_order_relaxed);
+		if( h - Tail.load(std::memory_order_acquire) == N )
+			return false;   // Full
+		Slots[h & (N-1)] = v;
+		Head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+	bool Pop(T& v) {
+		const auto t = Tail.load(std::memory_order_relaxed);
+		if( Head.load(std::memory_order_acquire) == t )
+			return false;   // Empty
+		v = Slots[t & (N-1)];
+		Tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+
+
+/* Memory Accounting */
+// miniaudio allocates through per-subsystem callbacks, each one tagged with its arena; so does everything here that
+// holds audio, from the encoded copies to the decoded PCM, the ADPCM blocks, and the buffers of the sources & the bus.
+// Every block carries its size in a 16-byte header, so that frees & reallocs can be accounted without a lookup.
+const char* const AmMemoryTagNames[AM_MEM_TAGS] = { "pcm", "stream", "sound", "decoder", "encoded" };
+constexpr size_t AM_MEM_HEADER = 16;
+
+struct AmMemoryArena {
+	std::atomic<int64_t> Bytes, Peak;
+	std::atomic<uint64_t> Allocations;
+};
+AmMemoryArena AmArenas[AM_MEM_TAGS];
+
+inline void AmMemAccount(AmMemoryArena& A, int64_t delta) {
+	const auto now = A.Bytes.fetch_add(delta, std::memory_order_relaxed) + delta;
+	auto peak = A.Peak.load(std::memory_order_relaxed);
+	while( now > peak && !A.Peak.compare_exchange_weak(peak, now, std::memory_order_relaxed) ) {}
+}
+static void* AmMemAlloc(size_t sz, void* pUserData) {
+	const auto base = (uint8_t*)malloc(sz + AM_MEM_HEADER);
+	if(!base)
+		return nullptr;
+	*(size_t*)base = sz;
+	auto& A = AmArenas[(uintptr_t)pUserData];
+	AmMemAccount(A, (int64_t)sz);
+	A.Allocations.fetch_add(1, std::memory_order_relaxed);
+	return base + AM_MEM_HEADER;
+}
+static void AmMemFree(void* p, void* pUserData) {
+	if(!p)
+		return;
+	const auto base = (uint8_t*)p - AM_MEM_HEADER;
+	AmMemAccount( AmArenas[(uintptr_t)pUserData], -(int64_t)*(size_t*)base );
+	free(base);
+}
+static void* AmMemRealloc(void* p, size_t sz, void* pUserData) {
+	if(!p)
+		return AmMemAlloc(sz, pUserData);
+	const auto old = (uint8_t*)p - AM_MEM_HEADER;
+	const auto was = *(size_t*)old;
+	const auto base = (uint8_t*)realloc(old, sz + AM_MEM_HEADER);
+	if(!base)
+		return nullptr;
+	*(size_t*)base = sz;
+	AmMemAccount( AmArenas[(uintptr_t)pUserData], (int64_t)sz - (int64_t)was );
+	return base + AM_MEM_HEADER;
+}
+inline ma_allocation_callbacks AmAllocator(AmMemoryTag tag) {
+	return { (void*)(uintptr_t)tag, AmMemAlloc, AmMemRealloc, AmMemFree };
+}
+
+// Objects, arrays & containers of our own; nullptr on failure, like the callbacks
+template<typename T> T* AmMemNew(AmMemoryTag tag) {
+	const auto p = AmMemAlloc( sizeof(T), (void*)(uintptr_t)tag );
+	return p ? new(p) T() : nullptr;
+}
+template<typename T> void AmMemDelete(T* p, AmMemoryTag tag) {
+	if(!p)
+		return;
+	p -> ~T();
+	AmMemFree( p, (void*)(uintptr_t)tag );
+}
+inline float* AmMemFloats(size_t n, AmMemoryTag tag) {
+	return (float*)AmMemAlloc( n * sizeof(float), (void*)(uintptr_t)tag );
+}
+template<typename T, AmMemoryTag Tag> struct AmTagged {   // An std allocator over an arena
+	typedef T value_type;
+	template<typename U> struct rebind { typedef AmTagged<U, Tag> other; };
+	AmTagged() = default;
+	template<typename U> AmTagged(const AmTagged<U, Tag>&) {}
+	T* allocate(size_t n) {
+		const auto p = (T*)AmMemAlloc( n * sizeof(T), (void*)(uintptr_t)Tag );
+		if(!p)
+			throw std::bad_alloc();
+		return p;
+	}
+	void deallocate(T* p, size_t) { AmMemFree( p, (void*)(uintptr_t)Tag ); }
+	template<typename U> bool operator==(const AmTagged<U, Tag>&) const { return true; }
+	template<typename U> bool operator!=(const AmTagged<U, Tag>&) const { return false; }
+};
+
+// Chart arenas: encoded copies made while one is open get bump-allocated from large chunks,
+// which are dropped all at once after the arena is closed and its last resource is released.
+constexpr size_t AM_CHART_CHUNK = 4 << 20;
+struct AmChartArena {
+	std::vector<uint8_t*> Chunks;
+	uint8_t* Current;   // Bump-allocated up to Used
+	size_t Used;
+	uint32_t Refs;   // Resources with bytes in here
+	bool Open;
+};
+
+static void* AmChartAlloc(AmChartArena* A, size_t sz) {   // nullptr if out of memory
+	sz = (sz + AM_MEM_HEADER - 1) / AM_MEM_HEADER * AM_MEM_HEADER;
+	if(sz > AM_CHART_CHUNK / 4) {   // e.g. songs; a chunk of their own, leaving the current one for keysounds
+		const auto C = (uint8_t*)AmMemAlloc(sz, (void*)AM_MEM_ENCODED);
+		if(C)
+			A -> Chunks.push_back(C);
+		return C;
+	}
+	if( !A -> Current || A -> Used + sz > AM_CHART_CHUNK ) {
+		const auto C = (uint8_t*)AmMemAlloc(AM_CHART_CHUNK, (void*)AM_MEM_ENCODED);
+		if(!C)
+			return nullptr;   // The current chunk stays, for smaller copies
+		A -> Chunks.push_back(C);
+		A -> Current = C;
+		A -> Used = 0;
+	}
+	const auto p = A -> Current + A -> Used;
+	A -> Used += sz;
+	return p;
+}
+static void AmChartDrop(AmChartArena* A) {   // Once closed & unreferenced
+	for(auto C : A -> Chunks)
+		AmMemFree(C, (void*)AM_MEM_ENCODED);
+	delete A;
+}
+
+/* Memory VFS */
+// Paths are files, memory-mapped read-only: decoders then read straight from the page cache, with no copies on our side.
+// The one exception is "am://<token>", which opens the buffer registered by AmRegisterMemory() under that token in place,
+// so that preview streams can read in-memory buffers; paths given to the API never get there, see AmIsMemoryPath().
+struct AmMemoryFile {
+	const uint8_t* Data;
+	size_t Size, Cursor;
+	bool Mapped;   // Unmapped on close
+};
+struct AmMemorySource {   // Registered by the Lua thread, opened by job threads
+	const uint8_t* Data;
+	size_t Size;
+	std::atomic<uint64_t> Token;   // 0 when none; stored last
+};
+AmMemorySource AmMemory;
+uint64_t AmMemoryTokens;   // Lua thread only
+
+inline bool AmIsMemoryPath(const char* path) {
+	return strncmp(path, "am://", 5) == 0;
+}
+static void AmRegisterMemory(const void* data, size_t size, char* path, size_t capacity) {   // Lua thread; replaces the last one
+	AmMemory.Token.store(0, std::memory_order_relaxed);
+	AmMemory.Data = (const uint8_t*)data;
+	AmMemory.Size = size;
+	const auto token = ++AmMemoryTokens;
+	AmMemory.Token.store(token, std::memory_order_release);
+	snprintf( path, capacity, "am://%llu", (unsigned long long)token );
+}
+static void AmUnregisterMemory() {
+	AmMemory.Token.store(0, std::memory_order_release);
+}
+
+static const uint8_t* AmMapFile(const char* path, size_t& size) {   // UTF-8 path; nullptr for missing or empty files
+#ifdef _WIN32
+	wchar_t wpath[MAX_PATH * 2];
+	if( !MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, MAX_PATH * 2) )
+		return nullptr;
+	const auto file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return nullptr;
+	LARGE_INTEGER length;
+	HANDLE mapping = nullptr;
+	if( GetFileSizeEx(file, &length) && length.QuadPart > 0 && (uint64_t)length.QuadPart <= SIZE_MAX )
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if(!mapping)
+		return nullptr;
+	const auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);   // The view keeps the mapping alive
+	size = (size_t)length.QuadPart;
+	return (const uint8_t*)view;
+#else
+	const int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return nullptr;
+	struct stat st;
+	void* view = MAP_FAILED;
+	if( fstat(fd, &st) == 0 && st.st_size > 0 )
+		view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);   // So does the mapping here
+	if(view == MAP_FAILED)
+		return nullptr;
+	madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);   // Decoders read front to back
+	size = (size_t)st.st_size;
+	return (const uint8_t*)view;
+#endif
+}
+static void AmUnmapFile(const void* data, size_t size) {
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap( (void*)data, size );
+#endif
+}
+
+static ma_result AmVFSOpen(ma_vfs* pVFS, const char* pFilePath, ma_uint32 openMode, ma_vfs_file* pFile) {
+	if(openMode & MA_OPEN_MODE_WRITE)
+		return MA_ACCESS_DENIED;
+	if( !AmIsMemoryPath(pFilePath) ) {
+		size_t length;
+		const auto data = AmMapFile(pFilePath, length);
+		if(!data)
+			return MA_DOES_NOT_EXIST;
+		*pFile = new AmMemoryFile{ data, length, 0, true };
+		return MA_SUCCESS;
+	}
+
+	// Only the registered token opens anything; there is no way to name an address
+	char* end;
+	const auto token = strtoull(pFilePath + 5, &end, 10);
+	if( *end || !token || token != AmMemory.Token.load(std::memory_order_acquire) )
+		return MA_DOES_NOT_EXIST;
+	*pFile = new AmMemoryFile{ AmMemory.Data, AmMemory.Size, 0, false };
+	return MA_SUCCESS;
+}
+static ma_result AmVFSOpenW(ma_vfs* pVFS, const wchar_t* pFilePath, ma_uint32 openMode, ma_vfs_file* pFile) {
+	return MA_DOES_NOT_EXIST;
+}
+static ma_result AmVFSClose(ma_vfs* pVFS, ma_vfs_file file) {
+	const auto F = (AmMemoryFile*)file;
+	if(F -> Mapped)
+		AmUnmapFile(F -> Data, F -> Size);
+	delete F;
+	return MA_SUCCESS;
+}
+static ma_result AmVFSRead(ma_vfs* pVFS, ma_vfs_file file, void* pDst, size_t sizeInBytes, size_t* pBytesRead) {
+	const auto F = (AmMemoryFile*)file;
+	const auto n = (sizeInBytes < F->Size - F->Cursor) ? sizeInBytes : F->Size - F->Cursor;
+	memcpy(pDst, F->Data + F->Cursor, n);
+	F->Cursor += n;
+	if(pBytesRead)
+		*pBytesRead = n;
+	return (n == 0 && sizeInBytes > 0) ? MA_AT_END : MA_SUCCESS;
+}
+static ma_result AmVFSWrite(ma_vfs* pVFS, ma_vfs_file file, const void* pSrc, size_t sizeInBytes, size_t* pBytesWritten) {
+	return MA_ACCESS_DENIED;
+}
+static ma_result AmVFSSeek(ma_vfs* pVFS, ma_vfs_file file, ma_int64 offset, ma_seek_origin origin) {
+	const auto F = (AmMemoryFile*)file;
+	ma_int64 base = (origin == ma_seek_origin_start) ? 0 : (origin == ma_seek_origin_current) ? (ma_int64)F->Cursor : (ma_int64)F->Size;
+	base += offset;
+	if( base < 0 || base > (ma_int64)F->Size )
+		return MA_BAD_SEEK;
+	F->Cursor = (size_t)base;
+	return MA_SUCCESS;
+}
+static ma_result AmVFSTell(ma_vfs* pVFS, ma_vfs_file file, ma_int64* pCursor) {
+	*pCursor = (ma_int64)( (AmMemoryFile*)file ) -> Cursor;
+	return MA_SUCCESS;
+}
+static ma_result AmVFSInfo(ma_vfs* pVFS, ma_vfs_file file, ma_file_info* pInfo) {
+	pInfo -> sizeInBytes = ( (AmMemoryFile*)file ) -> Size;
+	return MA_SUCCESS;
+}
+ma_vfs_callbacks AmMemoryVFS = {
+	AmVFSOpen, AmVFSOpenW, AmVFSClose, AmVFSRead, AmVFSWrite, AmVFSSeek, AmVFSTell, AmVFSInfo
+};
+
+
+/* Time Stretching */
+// WSOLA over an inner f32 data source. The inner cursor stays in chart time, while the output runs at Rate x the chart speed.
+// Search & overlap-add loops are plain contiguous float loops, left for the compiler to vectorize under -Ofast.
+struct AmStretch {
+	ma_data_source_base Base;   // Must be the first member
+	ma_data_source* Inner;
+	const std::atomic<float>* Rate;
+	ma_uint32 Channels, N, H, D;   // Window length, Synthesis hop (N/2), Search radius (N/4)
+	float *Window, *Fifo, *Mono, *Ola;   // Allocated by AmStretchPrepare() on the Lua thread, before any non-1x rate is stored
+	ma_uint32 Cap, Frames, End;   // Fifo capacity & valid frames; End is where the inner data stopped
+	ma_int64 Prev;   // Chosen position of the previous segment in Fifo
+	double Next;   // Ideal position of the next segment in Fifo
+	ma_uint32 Ready;   // Output frames ready at Ola[0 .. Ready*Channels)
+	float ReadyRate;
+	double Cursor;   // Chart position of the next output frame, in inner frames
+	bool Active, Ended;
+	bool Synced, Passed;   // Synced: the last segment sat right at the chart position, at 1x; Passed: Fifo input went out as is since
+};
+constexpr float AM_RATE_MIN = 0.25f, AM_RATE_MAX = 2.0f;
+
+static void AmStretchReset(AmStretch* T, ma_uint64 cursor) {
+	T -> Frames = 0;	T -> End = ~0u;
+	T -> Prev = -1;		T -> Next = 0.0;
+	T -> Ready = 0;		T -> Cursor = (double)cursor;
+	T -> Active = false;	T -> Ended = false;
+	T -> Synced = false;	T -> Passed = false;
+	if(T -> Ola)
+		memset( T -> Ola, 0, sizeof(float) * T -> N * T -> Channels );
+}
+static bool AmStretchFill(AmStretch* T, ma_uint32 need) {   // Returns false if nothing is left at all
+	if(need > T -> Cap)
+		need = T -> Cap;
+	while(T -> Frames < need) {
+		const auto C = T -> Channels;
+		auto dst = T -> Fifo + T -> Frames * C;
+		ma_uint64 got = 0;
+		if(!T -> Ended) {
+			ma_data_source_read_pcm_frames(T -> Inner, dst, need - T -> Frames, &got);
+			if(got < need - T -> Frames) {
+				T -> Ended = true;
+				T -> End = T -> Frames + (ma_uint32)got;
+			}
+		}
+		if(T -> Ended) {   // Pad with silence beyond the end
+			memset( dst + got * C, 0, sizeof(float) * (need - T -> Frames - got) * C );
+			got = need - T -> Frames;
+		}
+
+		// Downmix for the similarity search
+		auto mono = T -> Mono + T -> Frames;
+		for(ma_uint32 i = 0; i < got; i++) {
+			float sum = 0.0f;
+			for(ma_uint32 c = 0; c < C; c++)
+				sum += dst[i*C + c];
+			mono[i] = sum;
+		}
+		T -> Frames += (ma_uint32)got;
+	}
+	return !(T -> Ended) || ( T -> Prev + (ma_int64)T -> H < (ma_int64)T -> End );
+}
+static float AmStretchSimilarity(const float* __restrict a, const float* __restrict b, ma_uint32 n) {
+	float xy = 0.0f, yy = 1e-9f;
+	for(ma_uint32 i = 0; i < n; i++) {
+		xy += a[i] * b[i];
+		yy += b[i] * b[i];
+	}
+	return xy / sqrtf(yy);
+}
+static bool AmStretchStep(AmStretch* T, float rate) {   // Produces H frames into Ola
+	const auto N = T -> N, H = T -> H, D = T -> D, C = T -> Channels;
+	const auto centre = (ma_int64)(T -> Next + 0.5);
+	const auto lo = (centre > (ma_int64)D) ? centre - D : 0;
+	const auto hi = centre + D;
+	if( !AmStretchFill( T, (ma_uint32)( ((T -> Prev + (ma_int64)H > hi) ? T -> Prev + H : hi) + N ) ) )
+		return false;
+
+	if(T -> Passed) {   // The input went out as is up to Prev + H, so it fades out from there, as a segment at Prev would
+		for(ma_uint32 i = 0; i < H; i++)
+			for(ma_uint32 c = 0; c < C; c++)
+				T -> Ola[i*C + c] = T -> Window[i + H] * T -> Fifo[(T -> Prev + H + i)*C + c];
+		T -> Passed = false;
+	}
+
+	// Pick the segment most similar to the natural continuation of the previous one;
+	// at 1x the one right at the chart position instead, so that AmStretchRead() can hand the input out as is after it
+	ma_int64 a = 0;
+	if(T -> Prev < 0) {   // Fresh: pretend the previous segment was the same data, so there is no fade-in
+		for(ma_uint32 i = 0; i < H; i++)
+			for(ma_uint32 c = 0; c < C; c++)
+				T -> Ola[i*C + c] = T -> Window[i + H] * T -> Fifo[i*C + c];
+	}
+	else if(rate == 1.0f)
+		a = centre;
+	else {
+		const auto target = T -> Mono + T -> Prev + H;
+		float best = -3.4e38f;
+		for(auto k = lo; k <= hi; k += 4) {   // Coarse
+			const auto s = AmStretchSimilarity(target, T -> Mono + k, H);
+			if(s > best) { best = s; a = k; }
+		}
+		const auto flo = (a - 3 > lo) ? a - 3 : lo, fhi = (a + 3 < hi) ? a + 3 : hi;
+		for(auto k = flo; k <= fhi; k++) {   // Fine
+			const auto s = AmStretchSimilarity(target, T -> Mono + k, H);
+			if(s > best) { best = s; a = k; }
+		}
+	}
+
+	// Overlap-add; the Hann window sums to 1 at 50% overlap
+	const auto src = T -> Fifo + a * C;
+	for(ma_uint32 i = 0; i < N; i++) {
+		const auto w = T -> Window[i];
+		for(ma_uint32 c = 0; c < C; c++)
+			T -> Ola[i*C + c] += w * src[i*C + c];
+	}
+	T -> Ready = H;
+	T -> ReadyRate = rate;
+	T -> Synced = (rate == 1.0f);
+	T -> Prev = a;
+	T -> Next += H * rate;
+
+	// Drop the input that no later segment can reach
+	const auto reach = (ma_int64)T -> Next - (ma_int64)D;
+	const auto drop = (ma_uint32)( (reach < T -> Prev) ? ((reach > 0) ? reach : 0) : T -> Prev );
+	if(drop) {
+		memmove( T -> Fifo, T -> Fifo + drop * C, sizeof(float) * (T -> Frames - drop) * C );
+		memmove( T -> Mono, T -> Mono + drop, sizeof(float) * (T -> Frames - drop) );
+		T -> Frames -= drop;	T -> Prev -= drop;	T -> Next -= drop;
+		if(T -> End != ~0u)
+			T -> End -= drop;
+	}
+	return true;
+}
+
+static ma_result AmStretchRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead) {
+	const auto T = (AmStretch*)pDataSource;
+	const auto rate = T -> Rate -> load(std::memory_order_acquire);   // Pairs with the store after AmStretchPrepare(): a non-1x rate means the buffers are in
+
+	// Bypass at 1x until a stretching session starts; a session lasts until the rate is back at 1x, or the next seek
+	if( !T -> Active ) {
+		if(rate == 1.0f)
+			return ma_data_source_read_pcm_frames(T -> Inner, pFramesOut, frameCount, pFramesRead);
+		ma_uint64 cursor = 0;
+		ma_data_source_get_cursor_in_pcm_frames(T -> Inner, &cursor);
+		AmStretchReset(T, cursor);
+		T -> Active = true;
+	}
+
+	const auto C = T -> Channels, H = T -> H;
+	auto out = (float*)pFramesOut;
+	ma_uint64 done = 0;
+	while(done < frameCount) {
+		if( !T -> Ready ) {
+			// Back at 1x: past a segment at the chart position, the buffered input continues its fade-out as is,
+			// and once that is out, so does the inner source, bit-exact
+			if( rate == 1.0f && T -> Synced ) {
+				const auto from = (ma_uint32)(T -> Prev + H);
+				const auto last = std::min(T -> Frames, T -> End);
+				const auto n = (ma_uint32)std::min<ma_uint64>( frameCount - done, (last > from) ? last - from : 0 );
+				memcpy( out + done * C, T -> Fifo + from * C, sizeof(float) * n * C );
+				done += n;
+				T -> Prev += n;		T -> Next += n;		T -> Cursor += n;
+				T -> Passed = T -> Passed || n;
+				if(from + n < last || T -> Ended)
+					break;
+				T -> Active = false;
+				ma_uint64 read = 0;
+				ma_data_source_read_pcm_frames(T -> Inner, out + done * C, frameCount - done, &read);
+				done += read;
+				break;
+			}
+			if( !AmStretchStep(T, rate) )
+				break;
+		}
+		const auto offset = H - T -> Ready;
+		const auto n = (frameCount - done < T -> Ready) ? (ma_uint32)(frameCount - done) : T -> Ready;
+		memcpy( out + done * C, T -> Ola + offset * C, sizeof(float) * n * C );
+		done += n;
+		T -> Ready -= n;
+		T -> Cursor += n * T -> ReadyRate;
+		if( !T -> Ready ) {   // Shift the pending half in
+			memmove( T -> Ola, T -> Ola + H * C, sizeof(float) * H * C );
+			memset( T -> Ola + H * C, 0, sizeof(float) * H * C );
+		}
+	}
+
+	if(pFramesRead)
+		*pFramesRead = done;
+	return (done < frameCount) ? MA_AT_END : MA_SUCCESS;
+}
+static ma_result AmStretchSeek(ma_data_source* pDataSource, ma_uint64 frameIndex) {
+	const auto T = (AmStretch*)pDataSource;
+	AmStretchReset(T, frameIndex);
+	return ma_data_source_seek_to_pcm_frame(T -> Inner, frameIndex);
+}
+static ma_result AmStretchGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels, ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap) {
+	return ma_data_source_get_data_format( ((AmStretch*)pDataSource) -> Inner, pFormat, pChannels, pSampleRate, pChannelMap, channelMapCap );
+}
+static ma_result AmStretchGetCursor(ma_data_source* pDataSource, ma_uint64* pCursor) {
+	const auto T = (AmStretch*)pDataSource;
+	if( !T -> Active )
+		return ma_data_source_get_cursor_in_pcm_frames(T -> Inner, pCursor);
+	*pCursor = (ma_uint64)T -> Cursor;
+	return MA_SUCCESS;
+}
+static ma_result AmStretchGetLength(ma_data_source* pDataSource, ma_uint64* pLength) {
+	return ma_data_source_get_length_in_pcm_frames( ((AmStretch*)pDataSource) -> Inner, pLength );
+}
+ma_data_source_vtable AmStretchVTable = {
+	AmStretchRead, AmStretchSeek, AmStretchGetDataFormat, AmStretchGetCursor, AmStretchGetLength, nullptr, 0
+};
+
+static ma_result AmStretchInit(AmStretch* T, ma_data_source* pInner, const std::atomic<float>* pRate) {
+	ma_format format;
+	ma_uint32 channels, rate;
+	auto result = ma_data_source_get_data_format(pInner, &format, &channels, &rate, nullptr, 0);
+	if(result != MA_SUCCESS)
+		return result;
+	if(format != ma_format_f32)
+		return MA_FORMAT_NOT_SUPPORTED;
+
+	auto config = ma_data_source_config_init();
+		 config.vtable = &AmStretchVTable;
+	result = ma_data_source_init(&config, &T -> Base);
+	if(result != MA_SUCCESS)
+		return result;
+
+	ma_uint32 N = 256;   // ~20ms windows, at a power of 2
+	while(N * 2 <= rate / 40)
+		N *= 2;
+	T -> Inner = pInner;		T -> Rate = pRate;
+	T -> Channels = channels;	T -> N = N;		T -> H = N / 2;		T -> D = N / 4;
+	T -> Window = T -> Fifo = T -> Mono = T -> Ola = nullptr;
+	T -> Cap = 3 * N;
+	AmStretchReset(T, 0);
+	return MA_SUCCESS;
+}
+static void AmStretchPrepare(AmStretch* T) {   // Lua thread, before a non-1x rate gets published
+	if(T -> Fifo)
+		return;
+	const auto N = T -> N, C = T -> Channels;
+	T -> Window = AmMemFloats(N, AM_MEM_SOUND);
+	for(ma_uint32 i = 0; i < N; i++)   // Periodic Hann
+		T -> Window[i] = 0.5f - 0.5f * cosf(6.2831853f * i / N);
+	T -> Mono = AmMemFloats(T -> Cap, AM_MEM_SOUND);
+	T -> Ola = AmMemFloats(N * C, AM_MEM_SOUND);
+	memset( T -> Ola, 0, N * C * sizeof(float) );
+	T -> Fifo = AmMemFloats(T -> Cap * C, AM_MEM_SOUND);   // Published by the rate store that follows, see AmStretchRead()
+}
+static void AmStretchUninit(AmStretch* T) {
+	ma_data_source_uninit(&T -> Base);
+	AmMemFree(T -> Window, (void*)AM_MEM_SOUND);	AmMemFree(T -> Fifo, (void*)AM_MEM_SOUND);
+	AmMemFree(T -> Mono, (void*)AM_MEM_SOUND);		AmMemFree(T -> Ola, (void*)AM_MEM_SOUND);
+	T -> Window = T -> Fifo = T -> Mono = T -> Ola = nullptr;
+}
+
+
+/* IMA-ADPCM */
+// Compact storage for keysounds: 4 bits per sample in blocks of AM_ADPCM_BLOCK frames, each block starting from its own header,
+// so that any frame is reachable by decoding at most one block. Channels are decoded in lockstep, one lane per channel.
+constexpr ma_uint32 AM_ADPCM_BLOCK = 256;
+constexpr ma_uint32 AM_ADPCM_HEADER = 4;   // Per channel: int16 predictor, uint8 step index, padding
+constexpr ma_uint32 AM_BUS_BLOCKS = 16;   // Decoded blocks cached by the Player bus; power of 2
+const int16_t AmADPCMSteps[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+	130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060,
+	1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+	7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+const int8_t AmADPCMIndices[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+
+struct AmADPCM {
+	ma_uint32 Channels, SampleRate;
+	ma_uint64 Frames;
+	uint64_t Serial;   // Unique per encoding, so that cached blocks never outlive it, even at a reused address
+	std::vector< uint8_t, AmTagged<uint8_t, AM_MEM_PCM> > Blocks;   // Per block, per channel: a header, then AM_ADPCM_BLOCK nibbles (low nibble first)
+};
+std::atomic<uint64_t> AmADPCMSerials;   // 0 is never handed out
+inline void AmADPCMFree(AmADPCM* A) {
+	AmMemDelete(A, AM_MEM_PCM);
+}
+inline size_t AmADPCMStride(ma_uint32 channels) {
+	return channels * (AM_ADPCM_HEADER + AM_ADPCM_BLOCK / 2);
+}
+
+// Both sides share this reconstruction, (2 * magnitude + 1) * step / 8, instead of the branchy reference one
+inline void AmADPCMStep(int32_t& pred, int32_t& index, uint32_t nibble) {
+	const int32_t step = AmADPCMSteps[index];
+	const int32_t diff = ( (int32_t)(2 * (nibble & 7) + 1) * step ) >> 3;
+	pred += (nibble & 8) ? -diff : diff;
+	pred = (pred < -32768) ? -32768 : (pred > 32767) ? 32767 : pred;
+	index += AmADPCMIndices[nibble];
+	index = (index < 0) ? 0 : (index > 88) ? 88 : index;
+}
+
+static double AmADPCMEncodeRun(const float* pcm, ma_uint32 C, int32_t& pred, int32_t& index, uint8_t* nibbles) {
+	/* Encodes one channel of a block from the given state, and returns the squared error. */
+	double error = 0.0;
+	memset(nibbles, 0, AM_ADPCM_BLOCK / 2);
+	for(ma_uint32 i = 0; i < AM_ADPCM_BLOCK; i++) {
+		auto x = pcm[i * C] * 32768.0f;
+		x = (x < -32768.0f) ? -32768.0f : (x > 32767.0f) ? 32767.0f : x;
+		const auto d = (int32_t)x - pred;
+		auto magnitude = ( (d < 0 ? -d : d) * 4 ) / AmADPCMSteps[index];
+		magnitude = (magnitude > 7) ? 7 : magnitude;
+		const auto nibble = (uint32_t)magnitude | ( (d < 0) ? 8u : 0u );
+		AmADPCMStep(pred, index, nibble);
+		nibbles[i / 2] |= (i & 1) ? (uint8_t)(nibble << 4) : (uint8_t)nibble;
+		error += (x - pred) * (double)(x - pred);
+	}
+	return error;
+}
+static AmADPCM* AmADPCMEncode(ma_data_source* pSource) {   // Reads an f32 source to its end
+	ma_format format;
+	ma_uint32 channels, rate;
+	if( ma_data_source_get_data_format(pSource, &format, &channels, &rate, nullptr, 0) != MA_SUCCESS || format != ma_format_f32 )
+		return nullptr;
+
+	const auto A = AmMemNew<AmADPCM>(AM_MEM_PCM);
+	if(!A)
+		return nullptr;
+	A -> Channels = channels;		A -> SampleRate = rate;		A -> Frames = 0;
+	A -> Serial = ++AmADPCMSerials;
+	const auto C = channels;
+	const auto stride = AmADPCMStride(channels);
+	std::vector<float> pcm(AM_ADPCM_BLOCK * C);
+	std::vector<int32_t> pred(C, 0), index(C, 0);
+	uint8_t trial[AM_ADPCM_BLOCK / 2];
+	for(;;) {
+		ma_uint64 read = 0;
+		const auto result = ma_data_source_read_pcm_frames(pSource, pcm.data(), AM_ADPCM_BLOCK, &read);
+		if(!read)
+			break;
+		std::fill( pcm.begin() + read * C, pcm.end(), 0.0f );
+
+		A -> Blocks.resize(A -> Blocks.size() + stride);
+		auto block = &A -> Blocks[A -> Blocks.size() - stride];
+		for(ma_uint32 c = 0; c < C; c++) {
+			// The header may start from any step index, so attacks don't wait for the step size to ramp up
+			auto out = block + c * (AM_ADPCM_HEADER + AM_ADPCM_BLOCK / 2);
+			int32_t best_pred = pred[c], best_index = index[c], start = index[c];
+			auto best = AmADPCMEncodeRun(&pcm[c], C, best_pred, best_index, out + AM_ADPCM_HEADER);
+			for(int32_t candidate = 0; candidate <= 88; candidate += 4) {
+				int32_t p = pred[c], i = candidate;
+				const auto error = AmADPCMEncodeRun(&pcm[c], C, p, i, trial);
+				if(error < best) {
+					best = error;
+					best_pred = p;		best_index = i;		start = candidate;
+					memcpy(out + AM_ADPCM_HEADER, trial, sizeof(trial));
+				}
+			}
+			const auto header = (int16_t)pred[c];
+			memcpy(out, &header, 2);
+			out[2] = (uint8_t)start;	out[3] = 0;
+			pred[c] = best_pred;		index[c] = best_index;
+		}
+		A -> Frames += read;
+		if(result != MA_SUCCESS || read < AM_ADPCM_BLOCK)
+			break;
+	}
+	return A;
+}
+static void AmADPCMDecode(const AmADPCM* A, ma_uint64 block, float* out) {   // AM_ADPCM_BLOCK interleaved frames
+	const auto C = A -> Channels;
+	const auto src = &A -> Blocks[block * AmADPCMStride(C)];
+	const ma_uint32 span = AM_ADPCM_HEADER + AM_ADPCM_BLOCK / 2;
+	int32_t pred[MA_MAX_CHANNELS], index[MA_MAX_CHANNELS];
+	for(ma_uint32 c = 0; c < C; c++) {
+		int16_t p;
+		memcpy(&p, src + c * span, 2);
+		pred[c] = p;
+		index[c] = src[c * span + 2];
+	}
+	for(ma_uint32 i = 0; i < AM_ADPCM_BLOCK; i++) {
+		const auto shift = (i & 1) * 4;
+		for(ma_uint32 c = 0; c < C; c++) {
+			const uint32_t nibble = ( src[c * span + AM_ADPCM_HEADER + i / 2] >> shift ) & 15;
+			AmADPCMStep(pred[c], index[c], nibble);
+			out[i * C + c] = pred[c] * (1.0f / 32768.0f);
+		}
+	}
+}
+
+// A cursor over AmADPCM storage; one per unit
+struct AmADPCMSource {
+	ma_data_source_base Base;
+	const AmADPCM* Data;
+	ma_uint64 Cursor, Cached;   // Cached: the block in Block, or ~0
+	float* Block;
+};
+static ma_result AmADPCMRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead) {
+	const auto S = (AmADPCMSource*)pDataSource;
+	const auto A = S -> Data;
+	const auto C = A -> Channels;
+	auto out = (float*)pFramesOut;
+	ma_uint64 done = 0;
+	while( done < frameCount && S -> Cursor < A -> Frames ) {
+		const auto block = S -> Cursor / AM_ADPCM_BLOCK;
+		if(S -> Cached != block) {
+			AmADPCMDecode(A, block, S -> Block);
+			S -> Cached = block;
+		}
+		const auto offset = (ma_uint32)(S -> Cursor % AM_ADPCM_BLOCK);
+		auto n = std::min<ma_uint64>( frameCount - done, AM_ADPCM_BLOCK - offset );
+		n = std::min<ma_uint64>( n, A -> Frames - S -> Cursor );
+		memcpy( out + done * C, S -> Block + offset * C, sizeof(float) * n * C );
+		done += n;
+		S -> Cursor += n;
+	}
+	if(pFramesRead)
+		*pFramesRead = done;
+	return (done < frameCount) ? MA_AT_END : MA_SUCCESS;
+}
+static ma_result AmADPCMSeek(ma_data_source* pDataSource, ma_uint64 frameIndex) {
+	const auto S = (AmADPCMSource*)pDataSource;
+	S -> Cursor = std::min(frameIndex, S -> Data -> Frames);
+	return MA_SUCCESS;
+}
+static ma_result AmADPCMGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels, ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap) {
+	const auto A = ((AmADPCMSource*)pDataSource) -> Data;
+	*pFormat = ma_format_f32;
+	*pChannels = A -> Channels;
+	*pSampleRate = A -> SampleRate;
+	ma_channel_map_init_standard(ma_standard_channel_map_default, pChannelMap, channelMapCap, A -> Channels);
+	return MA_SUCCESS;
+}
+static ma_result AmADPCMGetCursor(ma_data_source* pDataSource, ma_uint64* pCursor) {
+	*pCursor = ((AmADPCMSource*)pDataSource) -> Cursor;
+	return MA_SUCCESS;
+}
+static ma_result AmADPCMGetLength(ma_data_source* pDataSource, ma_uint64* pLength) {
+	*pLength = ((AmADPCMSource*)pDataSource) -> Data -> Frames;
+	return MA_SUCCESS;
+}
+ma_data_source_vtable AmADPCMVTable = {
+	AmADPCMRead, AmADPCMSeek, AmADPCMGetDataFormat, AmADPCMGetCursor, AmADPCMGetLength, nullptr, 0
+};
+
+static ma_result AmADPCMInit(AmADPCMSource* S, const AmADPCM* A) {
+	auto config = ma_data_source_config_init();
+		 config.vtable = &AmADPCMVTable;
+	const auto result = ma_data_source_init(&config, &S -> Base);
+	if(result != MA_SUCCESS)
+		return result;
+	S -> Data = A;
+	S -> Cursor = 0;
+	S -> Cached = ~(ma_uint64)0;
+	S -> Block = AmMemFloats(AM_ADPCM_BLOCK * A -> Channels, AM_MEM_SOUND);
+	if(!S -> Block) {
+		ma_data_source_uninit(&S -> Base);
+		return MA_OUT_OF_MEMORY;
+	}
+	return MA_SUCCESS;
+}
+static void AmADPCMUninit(AmADPCMSource* S) {
+	ma_data_source_uninit(&S -> Base);
+	AmMemFree(S -> Block, (void*)AM_MEM_SOUND);
+	S -> Block = nullptr;
+}
+
+
+
+/* Decoders */
+// Custom backends for every ma_decoder here, tried before the stock WAV, FLAC & MP3 ones; defined with Ogg Vorbis below.
+constexpr ma_uint32 AM_DECODERS = 1;
+extern ma_decoding_backend_vtable* AmDecoders[AM_DECODERS];
+
+
+
+/* Decoded PCM */
+// Player resources are decoded straight from memory by a private ma_decoder, into a buffer of their own:
+// nothing gets registered by name, so that any number of decodings can run at once, on any threads.
+constexpr ma_uint64 AM_PCM_SLACK = 1024;   // Frames over the reported length, which is an estimate once resampled
+
+struct AmPCM {   // Shared by a resource & the cursors reading it, and freed with the last ref
+	std::atomic<uint32_t> Refs;
+	float* Data;   // Interleaved f32
+	ma_uint64 Frames;
+	ma_uint32 Channels, SampleRate;
+};
+
+inline AmPCM* AmPCMRetain(AmPCM* P) {
+	P -> Refs.fetch_add(1, std::memory_order_relaxed);
+	return P;
+}
+inline void AmPCMRelease(AmPCM* P) {
+	if( P && P -> Refs.fetch_sub(1, std::memory_order_acq_rel) == 1 ) {
+		AmMemFree(P -> Data, (void*)AM_MEM_PCM);
+		AmMemDelete(P, AM_MEM_PCM);
+	}
+}
+static AmPCM* AmDecodePCM(const void* data, size_t size, ma_uint32 channels, ma_uint32 rate) {   // nullptr on failure; thread-safe
+	auto decoder_config		= ma_decoder_config_init(ma_format_f32, channels, rate);
+		 decoder_config.allocationCallbacks	= AmAllocator(AM_MEM_DECODER);
+		 decoder_config.ppCustomBackendVTables	= AmDecoders;
+		 decoder_config.customBackendCount		= AM_DECODERS;
+	ma_decoder decoder;
+	if( ma_decoder_init_memory(data, size, &decoder_config, &decoder) != MA_SUCCESS )
+		return nullptr;
+
+	// Sized once from the reported length, if any; grown by halves otherwise
+	ma_uint64 capacity = 0, frames = 0;
+	if( ma_decoder_get_length_in_pcm_frames(&decoder, &capacity) != MA_SUCCESS )
+		capacity = 0;
+	capacity = (capacity ? capacity : rate) + AM_PCM_SLACK;
+	auto pcm = (float*)AmMemAlloc( (size_t)(capacity * channels * sizeof(float)), (void*)AM_MEM_PCM );
+	while(pcm) {
+		ma_uint64 read = 0;
+		const auto result = ma_decoder_read_pcm_frames(&decoder, pcm + frames * channels, capacity - frames, &read);
+		frames += read;
+		if(result != MA_SUCCESS || frames < capacity)
+			break;
+
+		const auto grown = (float*)AmMemRealloc( pcm, (size_t)((capacity + capacity / 2) * channels * sizeof(float)), (void*)AM_MEM_PCM );
+		if(!grown) {
+			AmMemFree(pcm, (void*)AM_MEM_PCM);
+			pcm = nullptr;
+		}
+		else {
+			pcm = grown;
+			capacity += capacity / 2;
+		}
+	}
+	ma_decoder_uninit(&decoder);
+	if(!pcm || !frames) {
+		AmMemFree(pcm, (void*)AM_MEM_PCM);
+		return nullptr;
+	}
+
+	// Give back the slack
+	if(frames < capacity) {
+		const auto shrunk = (float*)AmMemRealloc( pcm, (size_t)(frames * channels * sizeof(float)), (void*)AM_MEM_PCM );
+		if(shrunk)
+			pcm = shrunk;
+	}
+	const auto P = AmMemNew<AmPCM>(AM_MEM_PCM);
+	if(!P) {
+		AmMemFree(pcm, (void*)AM_MEM_PCM);
+		return nullptr;
+	}
+	P -> Refs = 1;
+	P -> Data = pcm;
+	P -> Frames = frames;
+	P -> Channels = channels;
+	P -> SampleRate = rate;
+	return P;
+}
+static ma_result AmPCMRefInit(const AmPCM* P, ma_audio_buffer_ref* pRef) {   // A cursor over the frames, in place
+	const auto result = ma_audio_buffer_ref_init(ma_format_f32, P -> Channels, P -> Data, P -> Frames, pRef);
+	pRef -> sampleRate = P -> SampleRate;   // Not taken by the init
+	return result;
+}
+
+/* Sound Banks */
+// A bank file is a header, an index of entries, and then the PCM of every entry, each one aligned to AM_BANK_ALIGN bytes.
+// PCM is stored decoded (interleaved f32, in the Player device format of the build time), so that loading a whole bank is one mapping,
+// and its resources play in place through ma_audio_buffer_ref cursors. All fields are little-endian.
+constexpr uint32_t AM_BANK_MAGIC = 0x4B424D41;   // "AMBK"
+constexpr uint32_t AM_BANK_VERSION = 1;
+constexpr uint64_t AM_BANK_ALIGN = 64;
+struct AmBankHeader {
+	uint32_t Magic, Version;
+	uint32_t Count, Reserved;
+};
+struct AmBankEntry {
+	uint64_t NameHash;   // Of the entry name; dmHashString64() in the Lua binding
+	uint64_t Offset, Frames;   // Offset in bytes, from the start of the file
+	uint32_t Channels, SampleRate;
+	uint32_t Format;   // ma_format, only ma_format_f32 for now
+	float Gain;   // Normalization gain of the source resource
+};
+static_assert(sizeof(AmBankHeader) == 16 && sizeof(AmBankEntry) == 40, "Bank structs must match the file layout");
+
+struct AmBank {   // A mapped bank file, shared by the resources created from it
+	const uint8_t* Data;
+	size_t Size;
+	uint32_t Refs;   // Unmapped when the last resource gets released
+};
+
+static const AmBankEntry* AmBankIndex(const uint8_t* data, size_t size, uint32_t& count) {   // nullptr if malformed
+	AmBankHeader H;
+	if(size < sizeof(H))
+		return nullptr;
+	memcpy(&H, data, sizeof(H));
+	if( H.Magic != AM_BANK_MAGIC || H.Version != AM_BANK_VERSION || H.Count == 0 || H.Count > (size - sizeof(H)) / sizeof(AmBankEntry) )
+		return nullptr;
+
+	const auto E = (const AmBankEntry*)(data + sizeof(H));
+	for(uint32_t i = 0; i < H.Count; i++) {
+		if( E[i].Format != ma_format_f32 || E[i].Channels == 0 || E[i].Channels > MA_MAX_CHANNELS || E[i].SampleRate == 0 )
+			return nullptr;
+
+		// PCM after the index & within the file; Frames is compared by division, so that Frames * Channels * 4 can't wrap
+		const uint64_t frame_bytes = E[i].Channels * sizeof(float);
+		const uint64_t index_end = sizeof(H) + (uint64_t)H.Count * sizeof(AmBankEntry);
+		if( (E[i].Offset % AM_BANK_ALIGN) != 0 || E[i].Offset < index_end || E[i].Offset > size )
+			return nullptr;
+		if( E[i].Frames == 0 || E[i].Frames > (size - E[i].Offset) / frame_bytes )
+			return nullptr;
+	}
+	count = H.Count;
+	return E;
+}
+static ma_result AmBankRefInit(const AmBank* B, const AmBankEntry* E, ma_audio_buffer_ref* pRef) {   // A cursor over one entry
+	const auto result = ma_audio_buffer_ref_init( ma_format_f32, E -> Channels, B -> Data + E -> Offset, E -> Frames, pRef );
+	pRef -> sampleRate = E -> SampleRate;   // Not taken by the init
+	return result;
+}
+
+static FILE* AmOpenWrite(const char* path) {   // UTF-8 path
+#ifdef _WIN32
+	wchar_t wpath[MAX_PATH * 2];
+	if( !MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, MAX_PATH * 2) )
+		return nullptr;
+	return _wfopen(wpath, L"wb");
+#else
+	return fopen(path, "wb");
+#endif
+}
+
+/* FFT */
+// Real-input FFT, done as a half-size complex FFT on split re/im arrays plus a post-pass.
+// Twiddles are stored per stage, so that every butterfly loop runs over contiguous memory and vectorizes under -Ofast.
+struct AmFFT {
+	ma_uint32 N, M;   // Real size, complex size (N/2)
+	std::vector<float> Cos, Sin;   // Stage twiddles: stage "half" at [half - 1, 2*half - 1)
+	std::vector<float> PostCos, PostSin;   // exp(-2*pi*i*k/N), k in [0, M)
+	std::vector<ma_uint32> Reverse;   // Bit reversal permutation of M
+
+	explicit AmFFT(ma_uint32 n) : N(n), M(n/2), Cos(n/2), Sin(n/2), PostCos(n/2), PostSin(n/2), Reverse(n/2) {
+		for(ma_uint32 half = 1; half < M; half *= 2)
+			for(ma_uint32 j = 0; j < half; j++) {
+				Cos[half - 1 + j] = cosf(3.14159265f * j / half);
+				Sin[half - 1 + j] = -sinf(3.14159265f * j / half);
+			}
+		for(ma_uint32 k = 0; k < M; k++) {
+			PostCos[k] = cosf(6.2831853f * k / N);
+			PostSin[k] = -sinf(6.2831853f * k / N);
+		}
+		ma_uint32 bits = 0;
+		while( (1u << bits) < M )
+			bits++;
+		for(ma_uint32 i = 0; i < M; i++) {
+			ma_uint32 r = 0;
+			for(ma_uint32 b = 0; b < bits; b++)
+				r |= ( (i >> b) & 1 ) << (bits - 1 - b);
+			Reverse[i] = r;
+		}
+	}
+
+	void Forward(float* __restrict re, float* __restrict im) const {   // In-place complex FFT of M points
+		for(ma_uint32 i = 0; i < M; i++) {
+			const auto r = Reverse[i];
+			if(r > i) {
+				std::swap(re[i], re[r]);
+				std::swap(im[i], im[r]);
+			}
+		}
+		for(ma_uint32 half = 1; half < M; half *= 2) {
+			const float* __restrict wr = &Cos[half - 1];
+			const float* __restrict wi = &Sin[half - 1];
+			for(ma_uint32 base = 0; base < M; base += half * 2) {
+				float* __restrict ar = re + base;			float* __restrict ai = im + base;
+				float* __restrict br = re + base + half;	float* __restrict bi = im + base + half;
+				for(ma_uint32 j = 0; j < half; j++) {
+					const auto tr = br[j] * wr[j] - bi[j] * wi[j];
+					const auto ti = br[j] * wi[j] + bi[j] * wr[j];
+					br[j] = ar[j] - tr;		bi[j] = ai[j] - ti;
+					ar[j] += tr;			ai[j] += ti;
+				}
+			}
+		}
+	}
+
+	// Power spectrum of N real samples into pow[0 .. N/2]; re & im are scratch arrays of N/2
+	void Power(const float* in, const float* window, float* re, float* im, float* pow) const {
+		for(ma_uint32 i = 0; i < M; i++) {   // Even samples into re, odd ones into im
+			re[i] = in[2*i] * window[2*i];
+			im[i] = in[2*i + 1] * window[2*i + 1];
+		}
+		Forward(re, im);
+		pow[0] = (re[0] + im[0]) * (re[0] + im[0]);   // DC & Nyquist are real
+		pow[M] = (re[0] - im[0]) * (re[0] - im[0]);
+		for(ma_uint32 k = 1; k < M; k++) {
+			const auto a = re[k], b = im[k], c = re[M - k], d = -im[M - k];
+			const auto er = 0.5f * (a + c), ei = 0.5f * (b + d);
+			const auto orr = 0.5f * (b - d), oi = -0.5f * (a - c);
+			const auto xr = er + PostCos[k] * orr - PostSin[k] * oi;
+			const auto xi = ei + PostCos[k] * oi + PostSin[k] * orr;
+			pow[k] = xr * xr + xi * xi;
+		}
+	}
+};
+
+
+/* Ogg Vorbis */
+// Vorbis I, decoded by a miniaudio custom backend: custom backends get tried before the stock ones, so .ogg buffers decode for
+// Player resources, banks & Preview streams alike. Floors 0 & 1, residues 0, 1 & 2, and any channel count are covered.
+// The Ogg file is held whole (in place from memory, or as one copy of a stream), and its pages are indexed once at init:
+// the last granule position gives the length, and a seek bisects the index, then decodes on from a page whose granule it knows.
+// The IMDCT is a DCT-IV over a quarter-size AmFFT, between two twiddle passes.
+constexpr int AM_VORBIS_TABLE = 10;   // Huffman lookup bits
+constexpr ma_uint32 AM_VORBIS_ENTRIES_MAX = 1u << 20, AM_VORBIS_VALUES_MAX = 1u << 22;   // Far over any encoder's books
+
+struct AmVorbisBits {   // LSB-first reader over one packet; reading past its end yields zeros, and sets End
+	const uint8_t* Data;
+	size_t Size, At;   // In bits
+	bool End;
+
+	AmVorbisBits(const uint8_t* data, size_t bytes) : Data(data), Size(bytes * 8), At(0), End(false) {}
+	uint32_t Peek(int n) const {   // n <= 32
+		const auto byte = At >> 3, bytes = Size >> 3;
+		uint64_t v = 0;
+		if(byte + 8 <= bytes)
+			memcpy(&v, Data + byte, 8);   // Little-endian hosts
+		else
+			for(size_t i = 0; i < 5 && byte + i < bytes; i++)
+				v |= (uint64_t)Data[byte + i] << (8 * i);
+		return (uint32_t)( (v >> (At & 7)) & ((1ull << n) - 1) );
+	}
+	bool Skip(size_t n) {
+		if(At + n > Size) {
+			At = Size;
+			End = true;
+			return false;
+		}
+		At += n;
+		return true;
+	}
+	uint32_t Read(int n) {
+		const auto v = Peek(n);
+		return Skip(n) ? v : 0;
+	}
+};
+inline int AmILog(uint32_t v) {   // Bits needed for v
+	int n = 0;
+	for(; v; v >>= 1)
+		n++;
+	return n;
+}
+inline float AmVorbisFloat(uint32_t x) {   // float32_unpack
+	const double mantissa = x & 0x1fffff;
+	return (float)ldexp( (x & 0x80000000u) ? -mantissa : mantissa, (int)((x & 0x7fe00000u) >> 21) - 788 );
+}
+
+// Codebooks
+struct AmVorbisBook {
+	ma_uint32 Dims, Entries;
+	int TableBits, Single;   // Single: the used entry of a book that has only one, or -1
+	std::vector<uint8_t> Lengths;   // 0 for unused entries
+	std::vector<uint32_t> Codes;   // Codewords bit-reversed, i.e. in reading order
+	std::vector<int32_t> Table;   // Entry by the next TableBits bits, or -1 for longer codewords
+	std::vector<ma_uint32> Long;   // Entries of longer codewords
+	std::vector<float> Values;   // Dims values per entry, when the book has a lookup
+
+	int Decode(AmVorbisBits& B) const {   // Entry, or -1 at the end of the packet
+		if(Single >= 0)
+			return B.Skip(Lengths[Single]) ? Single : -1;
+		if( !Table.empty() ) {
+			const auto e = Table[ B.Peek(TableBits) ];
+			if(e >= 0)
+				return B.Skip(Lengths[e]) ? e : -1;
+			const auto bits = B.Peek(32);
+			for(const auto l : Long)
+				if( (bits & (uint32_t)((1ull << Lengths[l]) - 1)) == Codes[l] )
+					return B.Skip(Lengths[l]) ? (int)l : -1;
+		}
+		B.Skip(B.Size);   // Not a codeword: the packet is over
+		return -1;
+	}
+	const float* Vector(AmVorbisBits& B) const {   // nullptr at the end of the packet
+		const auto e = Decode(B);
+		return (e < 0 || Values.empty()) ? nullptr : &Values[(size_t)e * Dims];
+	}
+};
+
+static bool AmVorbisCodewords(AmVorbisBook& K) {   // Assigned in entry order, each one taking the lowest free leaf of its length
+	uint32_t available[33] = {};
+	ma_uint32 used = 0;
+	int longest = 0;
+	K.Codes.assign(K.Entries, 0);
+	K.Single = -1;
+	for(ma_uint32 e = 0; e < K.Entries; e++) {
+		const int length = K.Lengths[e];
+		if(!length)
+			continue;
+		longest = std::max(longest, length);
+		if(!used++) {
+			for(int i = 1; i <= length; i++)
+				available[i] = 1u << (32 - i);
+			K.Single = (int)e;
+			continue;
+		}
+		int z = length;
+		while( z > 0 && !available[z] )
+			z--;
+		if(!z)
+			return false;   // Overspecified
+		const auto code = available[z];
+		available[z] = 0;
+		for(int y = length; y > z; y--)
+			available[y] = code + (1u << (32 - y));
+		uint32_t reversed = 0;
+		for(int b = 0; b < 32; b++)
+			reversed |= ( (code >> (31 - b)) & 1u ) << b;
+		K.Codes[e] = reversed;
+	}
+	if(used != 1)
+		K.Single = -1;
+
+	K.TableBits = std::min(longest, AM_VORBIS_TABLE);
+	K.Table.assign( used ? (size_t)1 << K.TableBits : 0, -1 );
+	K.Long.clear();
+	for(ma_uint32 e = 0; e < K.Entries; e++) {
+		const int length = K.Lengths[e];
+		if(length > K.TableBits)
+			K.Long.push_back(e);
+		else if(length)
+			for(uint32_t fill = K.Codes[e]; fill < (1u << K.TableBits); fill += 1u << length)
+				K.Table[fill] = (int32_t)e;
+	}
+	return true;
+}
+static ma_uint32 AmVorbisLookup1(ma_uint32 entries, ma_uint32 dims) {   // The greatest r with r^dims <= entries
+	const auto power = [dims](double r) {
+		double p = 1.0;
+		for(ma_uint32 d = 0; d < dims && p <= 1e18; d++)
+			p *= r;
+		return p;
+	};
+	auto r = (ma_uint32)floor( pow((double)entries, 1.0 / dims) );
+	while( r > 0 && power(r) > entries )
+		r--;
+	while( power(r + 1) <= entries )
+		r++;
+	return r;
+}
+static bool AmVorbisReadBook(AmVorbisBits& B, AmVorbisBook& K) {
+	if( B.Read(24) != 0x564342 )
+		return false;
+	K.Dims = B.Read(16);
+	K.Entries = B.Read(24);
+	if(K.Entries > AM_VORBIS_ENTRIES_MAX)
+		return false;
+
+	// Codeword lengths
+	K.Lengths.assign(K.Entries, 0);
+	if( !B.Read(1) ) {   // Unordered, maybe sparse
+		const bool sparse = B.Read(1);
+		for(ma_uint32 e = 0; e < K.Entries && !B.End; e++)
+			if( !sparse || B.Read(1) )
+				K.Lengths[e] = (uint8_t)( B.Read(5) + 1 );
+	}
+	else {   // Ordered: runs of increasing lengths
+		ma_uint32 length = B.Read(5) + 1;
+		for(ma_uint32 e = 0; e < K.Entries; length++) {
+			const auto run = B.Read( AmILog(K.Entries - e) );
+			if( B.End || length > 32 || run > K.Entries - e )
+				return false;
+			memset(&K.Lengths[e], (int)length, run);
+			e += run;
+		}
+	}
+
+	// Vector lookup, expanded into one row of values per entry
+	const auto lookup = B.Read(4);
+	if(lookup == 1 || lookup == 2) {
+		const auto minimum = AmVorbisFloat( B.Read(32) ), delta = AmVorbisFloat( B.Read(32) );
+		const int bits = (int)B.Read(4) + 1;
+		const bool sequence = B.Read(1);
+		const auto count = (lookup == 1) ? (ma_uint64)AmVorbisLookup1(K.Entries, K.Dims) : (ma_uint64)K.Entries * K.Dims;
+		if( !K.Dims || (ma_uint64)K.Entries * K.Dims > AM_VORBIS_VALUES_MAX || count * bits > B.Size - B.At )
+			return false;
+		std::vector<uint32_t> multiplicands(count);
+		for(auto& m : multiplicands)
+			m = B.Read(bits);
+		K.Values.resize( (size_t)K.Entries * K.Dims );
+		for(ma_uint32 e = 0; e < K.Entries; e++) {
+			float last = 0.0f;
+			ma_uint64 divisor = 1;
+			for(ma_uint32 d = 0; d < K.Dims; d++) {
+				const auto m = (lookup == 1) ? multiplicands[(e / divisor) % count] : multiplicands[(size_t)e * K.Dims + d];
+				const auto v = m * delta + minimum + last;
+				K.Values[(size_t)e * K.Dims + d] = v;
+				if(sequence)
+					last = v;
+				if(divisor <= e)
+					divisor *= count;
+			}
+		}
+	}
+	else if(lookup)
+		return false;
+	return !B.End && AmVorbisCodewords(K);
+}
+
+// Floors, decoded straight into curves of multipliers
+struct AmVorbisFloor {
+	int Type;
+	// Type 0
+	int Order, Rate, BarkSize, AmpBits, AmpOffset;
+	std::vector<uint8_t> Books;
+	std::vector<int> Map[2];   // Bark map per blocksize
+	// Type 1
+	int Multiplier;
+	std::vector<uint8_t> Partitions;   // Class per partition
+	int ClassDims[16], ClassSubs[16], ClassMaster[16], SubBooks[16][8];
+	std::vector<int> X;
+	std::vector<uint8_t> Sorted, Low, High;   // X order, & the neighbors of each point
+};
+inline double AmBark(double x) {
+	return 13.1 * atan(0.00074 * x) + 2.24 * atan(1.85e-8 * x * x) + 1e-4 * x;
+}
+static const float* AmVorbisInverseDB() {   // floor1_inverse_dB_table: 140 dB over 256 steps
+	static const std::vector<float> table = [] {
+		std::vector<float> t(256);
+		for(int i = 0; i < 256; i++)
+			t[i] = (float)pow( 10.0, (i - 255) * 140.0 / 256.0 / 20.0 );
+		return t;
+	}();
+	return table.data();
+}
+static bool AmVorbisReadFloor(AmVorbisBits& B, AmVorbisFloor& F, const std::vector<AmVorbisBook>& books, const ma_uint32 blocksizes[2]) {
+	F.Type = B.Read(16);
+	if(F.Type == 0) {
+		F.Order = B.Read(8);	F.Rate = B.Read(16);	F.BarkSize = B.Read(16);
+		F.AmpBits = B.Read(6);	F.AmpOffset = B.Read(8);
+		F.Books.resize( B.Read(4) + 1 );
+		for(auto& b : F.Books)
+			if( (b = (uint8_t)B.Read(8)) >= books.size() )
+				return false;
+		if(B.End || F.Order < 1 || F.Rate < 1 || F.BarkSize < 1)
+			return false;
+		for(int w = 0; w < 2; w++) {
+			const ma_uint32 n = blocksizes[w] / 2;
+			const auto scale = F.BarkSize / AmBark(0.5 * F.Rate);
+			F.Map[w].resize(n);
+			for(ma_uint32 i = 0; i < n; i++)
+				F.Map[w][i] = std::min( F.BarkSize - 1, (int)floor(AmBark((double)F.Rate * i / (2.0 * n)) * scale) );
+		}
+		return true;
+	}
+	if(F.Type != 1)
+		return false;
+
+	F.Partitions.resize( B.Read(5) );
+	int classes = 0;
+	for(auto& p : F.Partitions) {
+		p = (uint8_t)B.Read(4);
+		classes = std::max(classes, p + 1);
+	}
+	for(int c = 0; c < classes; c++) {
+		F.ClassDims[c] = B.Read(3) + 1;
+		F.ClassSubs[c] = B.Read(2);
+		F.ClassMaster[c] = F.ClassSubs[c] ? (int)B.Read(8) : -1;
+		if( F.ClassMaster[c] >= (int)books.size() )
+			return false;
+		for(int s = 0; s < (1 << F.ClassSubs[c]); s++)
+			if( (F.SubBooks[c][s] = (int)B.Read(8) - 1) >= (int)books.size() )
+				return false;
+	}
+	F.Multiplier = B.Read(2) + 1;
+	const int bits = B.Read(4);
+	F.X = { 0, 1 << bits };
+	for(const auto p : F.Partitions)
+		for(int d = 0; d < F.ClassDims[p]; d++)
+			F.X.push_back( B.Read(bits) );
+	const auto values = F.X.size();
+	if(B.End || values > 65)
+		return false;
+
+	F.Sorted.resize(values);
+	for(size_t i = 0; i < values; i++)
+		F.Sorted[i] = (uint8_t)i;
+	std::sort( F.Sorted.begin(), F.Sorted.end(), [&F](uint8_t a, uint8_t b) { return F.X[a] < F.X[b]; } );
+	for(size_t i = 1; i < values; i++)
+		if( F.X[ F.Sorted[i] ] == F.X[ F.Sorted[i - 1] ] )
+			return false;
+	F.Low.assign(values, 0);
+	F.High.assign(values, 1);
+	for(size_t i = 2; i < values; i++)
+		for(size_t j = 0; j < i; j++) {
+			if( F.X[j] < F.X[i] && F.X[j] > F.X[ F.Low[i] ] )
+				F.Low[i] = (uint8_t)j;
+			if( F.X[j] > F.X[i] && F.X[j] < F.X[ F.High[i] ] )
+				F.High[i] = (uint8_t)j;
+		}
+	return true;
+}
+inline int AmRenderPoint(int x0, int y0, int x1, int y1, int x) {
+	const auto off = (int)( (int64_t)abs(y1 - y0) * (x - x0) / (x1 - x0) );
+	return (y1 < y0) ? y0 - off : y0 + off;
+}
+static void AmRenderLine(int x0, int y0, int x1, int y1, float* curve, int n, const float* db) {
+	const int dy = y1 - y0, adx = x1 - x0;
+	if(adx <= 0)
+		return;
+	const int base = dy / adx, sy = (dy < 0) ? base - 1 : base + 1;
+	const int ady = abs(dy) - abs(base) * adx;
+	int y = y0, err = 0;
+	for(int x = x0; x < x1 && x < n; x++) {
+		if(x > x0) {
+			err += ady;
+			if(err >= adx) {
+				err -= adx;
+				y += sy;
+			}
+			else
+				y += base;
+		}
+		curve[x] = db[ std::max(0, std::min(255, y)) ];
+	}
+}
+
+// Residues
+struct AmVorbisResidue {
+	int Type, Classes, ClassBook;
+	ma_uint32 Begin, End, PartitionSize;
+	int Books[64][8];   // Per class & pass, -1 when none
+};
+static bool AmVorbisReadResidue(AmVorbisBits& B, AmVorbisResidue& R, const std::vector<AmVorbisBook>& books) {
+	R.Type = B.Read(16);
+	R.Begin = B.Read(24);
+	R.End = B.Read(24);
+	R.PartitionSize = B.Read(24) + 1;
+	R.Classes = B.Read(6) + 1;
+	R.ClassBook = B.Read(8);
+	if( R.Type > 2 || R.ClassBook >= (int)books.size() || !books[R.ClassBook].Dims )
+		return false;
+	int cascade[64];
+	for(int c = 0; c < R.Classes; c++) {
+		const int low = B.Read(3);
+		cascade[c] = ( B.Read(1) ? (int)B.Read(5) * 8 : 0 ) + low;
+	}
+	for(int c = 0; c < R.Classes; c++)
+		for(int pass = 0; pass < 8; pass++)
+			if( (R.Books[c][pass] = ((cascade[c] >> pass) & 1) ? (int)B.Read(8) : -1) >= (int)books.size() )
+				return false;
+	return !B.End;
+}
+
+// Mappings & modes
+struct AmVorbisMapping {
+	int Submaps;
+	std::vector<uint8_t> Magnitude, Angle, Mux;
+	int Floor[16], Residue[16];
+};
+struct AmVorbisMode {
+	int Long, Mapping;
+};
+
+// Decoder
+struct AmOggPage {
+	size_t Header, Body;   // Offsets in the file
+	ma_int64 Granule;   // -1 when no packet ends on the page
+	ma_uint64 Known;   // The last granule up to here
+	uint8_t Flags, Segments;
+};
+struct AmVorbis {
+	ma_data_source_base Base;   // Must be the first member
+	ma_allocation_callbacks Allocator;
+	const uint8_t* Data;
+	size_t Size;
+	void* Owned;   // The copy of a stream, or nullptr when read in place
+	std::vector<AmOggPage> Pages;
+
+	// Setup
+	ma_uint32 Channels, SampleRate, Blocksize[2];
+	std::vector<AmVorbisBook> Books;
+	std::vector<AmVorbisFloor> Floors;
+	std::vector<AmVorbisResidue> Residues;
+	std::vector<AmVorbisMapping> Mappings;
+	std::vector<AmVorbisMode> Modes;
+	std::vector<AmFFT> FFT;   // Per blocksize, of Blocksize/4 complex points
+	std::vector<float> Twiddle[2];   // Per blocksize: pre cos & sin, post cos & sin, Blocksize/4 each
+	std::vector<float> Window[2];   // Rising slopes of Blocksize/2
+
+	// Packets
+	size_t Page, Segment, Offset;   // Next segment, & its offset in the page body
+	size_t FirstPage, FirstSegment, FirstOffset;   // Where the audio packets start
+	std::vector<uint8_t> Packet;
+
+	// Decoding; buffers are strided per channel
+	std::vector<float> Spectrum, Curve, Block, Previous, Interleaved, Scratch;
+	std::vector<uint8_t> Classes;
+	ma_uint32 PreviousFrames;   // Right slope held from the last block, 0 before the first one
+	std::vector<float> Out;   // Interleaved frames of the last packet, from stream frame OutStart
+	ma_uint32 OutFrames, OutRead;
+	ma_uint64 OutStart, Cursor, Length;
+	ma_int64 Next;   // Stream frame where the next packet's frames start, -1 until a granule tells it after a seek
+};
+
+static bool AmVorbisReadPacket(AmVorbis* V, ma_int64& granule) {   // The next whole packet into V -> Packet; false at the end
+	// granule: the page's, if the packet is the last one to end on its page; -1 otherwise
+	V -> Packet.clear();
+	granule = -1;
+	bool skip = false;   // Dropping the tail of a packet whose head was not read
+	for(; V -> Page < V -> Pages.size(); V -> Page++, V -> Segment = 0, V -> Offset = 0) {
+		const auto& P = V -> Pages[V -> Page];
+		const auto lacing = V -> Data + P.Header + 27;
+		if( V -> Segment == 0 && (P.Flags & 1) && V -> Packet.empty() )
+			skip = true;
+		else if( V -> Segment == 0 && !(P.Flags & 1) && !V -> Packet.empty() )
+			V -> Packet.clear();   // Its tail is missing
+		while(V -> Segment < P.Segments) {
+			const auto length = lacing[V -> Segment++];
+			if(!skip) {
+				const auto from = V -> Data + P.Body + V -> Offset;
+				V -> Packet.insert(V -> Packet.end(), from, from + length);
+			}
+			V -> Offset += length;
+			if(length == 255)
+				continue;
+			if(skip) {
+				skip = false;
+				continue;
+			}
+			bool last = true;
+			for(auto s = V -> Segment; s < P.Segments && last; s++)
+				last = lacing[s] == 255;
+			if(last)
+				granule = P.Granule;
+			return true;
+		}
+	}
+	return false;
+}
+static void AmVorbisRestart(AmVorbis* V, size_t page, size_t segment, size_t offset, ma_int64 next) {
+	V -> Page = page;
+	V -> Segment = segment;
+	V -> Offset = offset;
+	V -> PreviousFrames = 0;
+	V -> OutFrames = V -> OutRead = 0;
+	V -> OutStart = 0;
+	V -> Next = next;
+}
+
+static bool AmVorbisFloorCurve(const AmVorbis* V, const AmVorbisFloor& F, AmVorbisBits& B, int w, float* curve) {   // false: unused
+	const int n = (int)V -> Blocksize[w] / 2;
+	if(F.Type == 0) {
+		const auto amplitude = B.Read(F.AmpBits);
+		const auto book = B.Read( AmILog((uint32_t)F.Books.size()) );
+		if( !amplitude || book >= F.Books.size() )
+			return false;
+		const auto& K = V -> Books[ F.Books[book] ];
+		std::vector<float> lsp;
+		float last = 0.0f;
+		while( (int)lsp.size() < F.Order ) {
+			const auto v = K.Vector(B);
+			if(!v)
+				return false;
+			for(ma_uint32 d = 0; d < K.Dims; d++)
+				lsp.push_back(v[d] + last);
+			last = lsp.back();
+		}
+		for(auto& c : lsp)
+			c = cosf(c);
+		const auto& map = F.Map[w];
+		const double top = ldexp(1.0, F.AmpBits) - 1.0;
+		for(int i = 0; i < n; ) {
+			const double cw = cos( 3.14159265358979 * map[i] / F.BarkSize );
+			double p = (F.Order & 1) ? 1.0 - cw * cw : 0.5 * (1.0 - cw);
+			double q = (F.Order & 1) ? 0.25 : 0.5 * (1.0 + cw);
+			for(int k = 0; k < F.Order; k++)
+				( (k & 1) ? p : q ) *= 4.0 * (lsp[k] - cw) * (lsp[k] - cw);
+			const auto linear = (float)exp( 0.11512925 * (amplitude * F.AmpOffset / (top * sqrt(p + q)) - F.AmpOffset) );
+			const auto bark = map[i];
+			do
+				curve[i++] = linear;
+			while( i < n && map[i] == bark );
+		}
+		return true;
+	}
+
+	static const int ranges[4] = { 256, 128, 86, 64 };
+	if( !B.Read(1) )
+		return false;
+	const int range = ranges[F.Multiplier - 1], bits = AmILog(range - 1);
+	int Y[65];
+	bool step2[65];
+	Y[0] = B.Read(bits);
+	Y[1] = B.Read(bits);
+	size_t offset = 2;
+	for(const auto c : F.Partitions) {
+		const int subs = F.ClassSubs[c], mask = (1 << subs) - 1;
+		int sub = subs ? V -> Books[ F.ClassMaster[c] ].Decode(B) : 0;
+		if(sub < 0)
+			return false;
+		for(int d = 0; d < F.ClassDims[c]; d++, sub >>= subs) {
+			const int book = F.SubBooks[c][sub & mask];
+			Y[offset + d] = (book >= 0) ? V -> Books[book].Decode(B) : 0;
+			if(Y[offset + d] < 0)
+				return false;
+		}
+		offset += F.ClassDims[c];
+	}
+	if(B.End)
+		return false;
+
+	// Amplitudes, each one predicted from its neighbors
+	const auto values = F.X.size();
+	step2[0] = step2[1] = true;
+	for(size_t i = 2; i < values; i++) {
+		const int lo = F.Low[i], hi = F.High[i];
+		const int predicted = AmRenderPoint(F.X[lo], Y[lo], F.X[hi], Y[hi], F.X[i]);
+		const int val = Y[i], highroom = range - predicted, lowroom = predicted;
+		const int room = std::min(highroom, lowroom) * 2;
+		step2[i] = val != 0;
+		if(!val)
+			Y[i] = predicted;
+		else {
+			step2[lo] = step2[hi] = true;
+			if(val >= room)
+				Y[i] = (highroom > lowroom) ? val - lowroom + predicted : predicted - val + highroom - 1;
+			else
+				Y[i] = (val & 1) ? predicted - (val + 1) / 2 : predicted + val / 2;
+		}
+	}
+
+	// Lines between the points in use, in X order
+	const auto db = AmVorbisInverseDB();
+	int lx = 0, ly = Y[0] * F.Multiplier, hx = 0, hy = 0;
+	for(size_t s = 1; s < values; s++) {
+		const auto i = F.Sorted[s];
+		if(step2[i]) {
+			hx = F.X[i];
+			hy = Y[i] * F.Multiplier;
+			AmRenderLine(lx, ly, hx, hy, curve, n, db);
+			lx = hx;
+			ly = hy;
+		}
+	}
+	if(hx < n)
+		AmRenderLine(hx, hy, n, hy, curve, n, db);
+	return true;
+}
+
+static void AmVorbisPartitions(AmVorbis* V, const AmVorbisResidue& R, AmVorbisBits& B, float** vectors, const bool* skip, int count, ma_uint32 size, int format) {
+	const auto begin = std::min(R.Begin, size), end = std::min(R.End, size);
+	const auto& classbook = V -> Books[R.ClassBook];
+	const ma_uint32 words = classbook.Dims;   // Classifications per classbook codeword
+	const ma_uint32 parts = (end > begin) ? (end - begin) / R.PartitionSize : 0;
+	const ma_uint32 stride = parts + words;
+	uint8_t* classes = V -> Classes.data();
+	for(int pass = 0; pass < 8; pass++)
+		for(ma_uint32 p = 0; p < parts; ) {
+			if(!pass)
+				for(int c = 0; c < count; c++) {
+					if(skip[c])
+						continue;
+					auto temp = classbook.Decode(B);
+					if(temp < 0)
+						return;
+					for(int i = (int)words - 1; i >= 0; i--) {
+						classes[c * stride + p + i] = (uint8_t)(temp % R.Classes);
+						temp /= R.Classes;
+					}
+				}
+			for(ma_uint32 i = 0; i < words && p < parts; i++, p++)
+				for(int c = 0; c < count; c++) {
+					const int book = skip[c] ? -1 : R.Books[ classes[c * stride + p] ][pass];
+					if(book < 0)
+						continue;
+					const auto& K = V -> Books[book];
+					const auto out = vectors[c] + begin + p * R.PartitionSize;
+					if(format == 0) {   // Each vector spread over the partition, at a step of size / dims
+						const ma_uint32 step = R.PartitionSize / std::max<ma_uint32>(K.Dims, 1);
+						for(ma_uint32 s = 0; s < step; s++) {
+							const auto v = K.Vector(B);
+							if(!v)
+								return;
+							for(ma_uint32 d = 0; d < K.Dims; d++)
+								out[s + d * step] += v[d];
+						}
+					}
+					else   // Vectors in order
+						for(ma_uint32 s = 0; s < R.PartitionSize; ) {
+							const auto v = K.Vector(B);
+							if(!v)
+								return;
+							for(ma_uint32 d = 0; d < K.Dims && s < R.PartitionSize; d++)
+								out[s++] += v[d];
+						}
+				}
+		}
+}
+static void AmVorbisResidueDecode(AmVorbis* V, const AmVorbisResidue& R, AmVorbisBits& B, float** vectors, const bool* skip, int count, ma_uint32 n) {
+	if(R.Type < 2)
+		return AmVorbisPartitions(V, R, B, vectors, skip, count, n, R.Type);
+
+	// Type 2: the channels interleaved into one vector, decoded as type 1 unless all of them are skipped
+	if( std::all_of(skip, skip + count, [](bool s) { return s; }) )
+		return;
+	float* interleaved = V -> Interleaved.data();
+	const bool none = false;
+	memset( interleaved, 0, sizeof(float) * n * count );
+	AmVorbisPartitions(V, R, B, &interleaved, &none, 1, n * count, 1);
+	for(ma_uint32 i = 0; i < n; i++)
+		for(int c = 0; c < count; c++)
+			vectors[c][i] = interleaved[i * count + c];
+}
+
+static void AmVorbisIMDCT(AmVorbis* V, int w, const float* X, float* y) {   // n/2 coefficients into n samples, unscaled
+	// A DCT-IV of the coefficients (re-indexed as n/4 complex points, twiddled, FFT'd & twiddled again), then unfolded
+	const ma_uint32 n = V -> Blocksize[w], half = n / 2, quarter = n / 4;
+	const float* pc = &V -> Twiddle[w][0];					const float* ps = pc + quarter;
+	const float* qc = pc + 2 * quarter;						const float* qs = pc + 3 * quarter;
+	float* re = V -> Scratch.data();	float* im = re + quarter;	float* u = im + quarter;
+	for(ma_uint32 k = 0; k < quarter; k++) {
+		const auto a = X[2 * k], b = X[half - 1 - 2 * k];
+		re[k] = a * pc[k] + b * ps[k];
+		im[k] = b * pc[k] - a * ps[k];
+	}
+	V -> FFT[w].Forward(re, im);
+	for(ma_uint32 j = 0; j < quarter; j++) {
+		u[2 * j] = re[j] * qc[j] + im[j] * qs[j];
+		u[half - 1 - 2 * j] = re[j] * qs[j] - im[j] * qc[j];
+	}
+	for(ma_uint32 i = 0; i < quarter; i++)
+		y[i] = u[i + quarter];
+	for(ma_uint32 i = quarter; i < 3 * quarter; i++)
+		y[i] = -u[3 * quarter - 1 - i];
+	for(ma_uint32 i = 3 * quarter; i < n; i++)
+		y[i] = -u[i - 3 * quarter];
+}
+
+static bool AmVorbisAudio(AmVorbis* V, ma_uint32& start, ma_uint32& count, ma_uint32& lead) {   // Decodes V -> Packet; its frames are Block[start, start + count)
+	// lead: how far the frames run past the block's center, where the granule positions count to
+	AmVorbisBits B( V -> Packet.data(), V -> Packet.size() );
+	if( B.Read(1) != 0 )
+		return false;
+	const auto mode = B.Read( AmILog((uint32_t)V -> Modes.size() - 1) );
+	if( mode >= V -> Modes.size() )
+		return false;
+	const int w = V -> Modes[mode].Long;
+	const auto& M = V -> Mappings[ V -> Modes[mode].Mapping ];
+	const ma_uint32 n = V -> Blocksize[w], half = n / 2, b0 = V -> Blocksize[0];
+	const bool prev = w ? B.Read(1) : true, next = w ? B.Read(1) : true;   // Long neighbors
+	if(B.End)
+		return false;
+
+	// Window slopes: a short neighbor of a long block overlaps it around its quarters
+	const ma_uint32 left_start = prev ? 0 : n / 4 - b0 / 4, left_n = prev ? half : b0 / 2;
+	const ma_uint32 right_start = next ? half : 3 * n / 4 - b0 / 4, right_n = next ? half : b0 / 2;
+
+	// Floors, then residues per submap, for the channels whose floor is in use, or coupled with one that is
+	const auto C = V -> Channels;
+	const ma_uint32 stride = V -> Blocksize[1] / 2;
+	bool used[256], decode[256], skip[256];
+	float* vectors[256];
+	for(ma_uint32 c = 0; c < C; c++)
+		used[c] = decode[c] = AmVorbisFloorCurve(V, V -> Floors[ M.Floor[M.Mux[c]] ], B, w, &V -> Curve[c * stride]);
+	for(size_t s = 0; s < M.Magnitude.size(); s++)
+		if( decode[M.Magnitude[s]] || decode[M.Angle[s]] )
+			decode[M.Magnitude[s]] = decode[M.Angle[s]] = true;
+	for(int s = 0; s < M.Submaps; s++) {
+		int count = 0;
+		for(ma_uint32 c = 0; c < C; c++)
+			if(M.Mux[c] == s) {
+				vectors[count] = &V -> Spectrum[c * stride];
+				skip[count] = !decode[c];
+				memset( vectors[count], 0, sizeof(float) * half );
+				count++;
+			}
+		AmVorbisResidueDecode(V, V -> Residues[ M.Residue[s] ], B, vectors, skip, count, half);
+	}
+
+	// Inverse coupling, last step first
+	for(size_t s = M.Magnitude.size(); s-- > 0; ) {
+		float* mag = &V -> Spectrum[M.Magnitude[s] * stride];
+		float* ang = &V -> Spectrum[M.Angle[s] * stride];
+		for(ma_uint32 i = 0; i < half; i++) {
+			const auto m = mag[i], a = ang[i];
+			if(m > 0.0f) {
+				if(a > 0.0f)	ang[i] = m - a;
+				else		{ ang[i] = m;	mag[i] = m + a; }
+			}
+			else {
+				if(a > 0.0f)	ang[i] = m + a;
+				else		{ ang[i] = m;	mag[i] = m - a; }
+			}
+		}
+	}
+
+	// Curves, IMDCT, & the overlap with the last block's right slope
+	const bool overlap = V -> PreviousFrames == left_n;
+	const float* window = V -> Window[left_n == V -> Blocksize[1] / 2].data();
+	for(ma_uint32 c = 0; c < C; c++) {
+		float* X = &V -> Spectrum[c * stride];
+		const float* curve = &V -> Curve[c * stride];
+		if(used[c])
+			for(ma_uint32 i = 0; i < half; i++)
+				X[i] *= curve[i];
+		else
+			memset( X, 0, sizeof(float) * half );
+		float* y = &V -> Block[c * V -> Blocksize[1]];
+		AmVorbisIMDCT(V, w, X, y);
+
+		const float* held = &V -> Previous[c * stride];
+		float* rise = y + left_start;
+		if(overlap)
+			for(ma_uint32 j = 0; j < left_n; j++)
+				rise[j] = rise[j] * window[j] + held[j] * window[left_n - 1 - j];
+		else
+			for(ma_uint32 j = 0; j < left_n; j++)
+				rise[j] *= window[j];
+		memcpy( &V -> Previous[c * stride], y + right_start, sizeof(float) * right_n );
+	}
+	start = V -> PreviousFrames ? left_start : half;   // The first block only gives the flat part past its center
+	count = right_start - start;
+	lead = right_start - half;
+	V -> PreviousFrames = right_n;
+	return true;
+}
+
+static bool AmVorbisNextPacket(AmVorbis* V) {   // Decodes one more packet into Out; false at the end of the stream
+	ma_int64 granule;
+	if( !AmVorbisReadPacket(V, granule) )
+		return false;
+	V -> OutFrames = V -> OutRead = 0;
+	ma_uint32 start, count, lead;
+	if( !AmVorbisAudio(V, start, count, lead) )
+		return true;   // Skipped
+
+	if(V -> Next >= 0) {
+		// Keep the frames from the cursor on, up to the length
+		const auto begin = (ma_uint64)V -> Next;
+		const auto end = std::min<ma_uint64>(begin + count, V -> Length);
+		const auto from = std::max(begin, V -> Cursor);
+		if(end > from) {
+			const auto C = V -> Channels;
+			const auto offset = start + (ma_uint32)(from - begin);
+			V -> OutFrames = (ma_uint32)(end - from);
+			V -> OutStart = from;
+			for(ma_uint32 c = 0; c < C; c++) {
+				const float* y = &V -> Block[c * V -> Blocksize[1]] + offset;
+				float* out = V -> Out.data() + c;
+				for(ma_uint32 i = 0; i < V -> OutFrames; i++)
+					out[i * C] = y[i];
+			}
+		}
+		V -> Next += count;
+	}
+	else if(granule >= 0)
+		V -> Next = granule + lead;   // The next packet's frames start where this one's ended
+	return true;
+}
+
+// Data Source
+static ma_result AmVorbisRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead) {
+	const auto V = (AmVorbis*)pDataSource;
+	const auto C = V -> Channels;
+	auto out = (float*)pFramesOut;
+	ma_uint64 done = 0;
+	while(done < frameCount) {
+		if(V -> OutRead < V -> OutFrames) {
+			const auto n = (ma_uint32)std::min<ma_uint64>( frameCount - done, V -> OutFrames - V -> OutRead );
+			if(out)
+				memcpy( out + done * C, &V -> Out[V -> OutRead * C], sizeof(float) * n * C );
+			V -> OutRead += n;
+			V -> Cursor += n;
+			done += n;
+		}
+		else if( !AmVorbisNextPacket(V) )
+			break;
+	}
+	if(pFramesRead)
+		*pFramesRead = done;
+	return (done < frameCount) ? MA_AT_END : MA_SUCCESS;
+}
+static ma_result AmVorbisSeek(ma_data_source* pDataSource, ma_uint64 frameIndex) {
+	const auto V = (AmVorbis*)pDataSource;
+	const auto target = std::min(frameIndex, V -> Length);
+	V -> Cursor = target;
+
+	// Still held, or a little ahead: decode on
+	if( V -> Next >= 0 && target >= V -> OutStart && target < V -> OutStart + V -> OutFrames ) {
+		V -> OutRead = (ma_uint32)(target - V -> OutStart);
+		return MA_SUCCESS;
+	}
+	if( V -> Next >= 0 && target >= (ma_uint64)V -> Next && target < (ma_uint64)V -> Next + V -> SampleRate ) {
+		V -> OutRead = V -> OutFrames;
+		return MA_SUCCESS;
+	}
+
+	// Otherwise from some pages before the last one at or before the target, further back while that lands past it
+	const auto last = std::upper_bound( V -> Pages.begin() + V -> FirstPage, V -> Pages.end(), target,
+		[](ma_uint64 t, const AmOggPage& P) { return t < P.Known; } ) - V -> Pages.begin();
+	for(size_t back = 2; ; back *= 4) {
+		if( (size_t)last <= V -> FirstPage + back ) {
+			AmVorbisRestart(V, V -> FirstPage, V -> FirstSegment, V -> FirstOffset, 0);
+			return MA_SUCCESS;
+		}
+		AmVorbisRestart(V, last - back, 0, 0, -1);
+		while( V -> Next < 0 && AmVorbisNextPacket(V) ) {}
+		if( V -> Next >= 0 && (ma_uint64)V -> Next <= target )
+			return MA_SUCCESS;
+	}
+}
+static ma_result AmVorbisGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels, ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap) {
+	const auto V = (AmVorbis*)pDataSource;
+	*pFormat = ma_format_f32;
+	*pChannels = V -> Channels;
+	*pSampleRate = V -> SampleRate;
+	ma_channel_map_init_standard(ma_standard_channel_map_vorbis, pChannelMap, channelMapCap, V -> Channels);
+	return MA_SUCCESS;
+}
+static ma_result AmVorbisGetCursor(ma_data_source* pDataSource, ma_uint64* pCursor) {
+	*pCursor = ((AmVorbis*)pDataSource) -> Cursor;
+	return MA_SUCCESS;
+}
+static ma_result AmVorbisGetLength(ma_data_source* pDataSource, ma_uint64* pLength) {
+	*pLength = ((AmVorbis*)pDataSource) -> Length;
+	return MA_SUCCESS;
+}
+ma_data_source_vtable AmVorbisVTable = {
+	AmVorbisRead, AmVorbisSeek, AmVorbisGetDataFormat, AmVorbisGetCursor, AmVorbisGetLength, nullptr, 0
+};
+
+// Opening
+static uint32_t AmOggCRC(const uint8_t* page, size_t size) {   // Over the page, with its CRC field taken as zeros
+	static const std::vector<uint32_t> table = [] {
+		std::vector<uint32_t> t(256);
+		for(uint32_t i = 0; i < 256; i++) {
+			uint32_t r = i << 24;
+			for(int b = 0; b < 8; b++)
+				r = (r & 0x80000000u) ? (r << 1) ^ 0x04c11db7u : r << 1;
+			t[i] = r;
+		}
+		return t;
+	}();
+	uint32_t crc = 0;
+	for(size_t i = 0; i < size; i++)
+		crc = (crc << 8) ^ table[ ((crc >> 24) ^ ((i >= 22 && i < 26) ? 0 : page[i])) & 0xff ];
+	return crc;
+}
+static bool AmOggIndex(AmVorbis* V) {   // Pages of the first logical stream, up to its end
+	const auto le = [](const uint8_t* p, int n) {
+		uint64_t v = 0;
+		for(int i = n - 1; i >= 0; i--)
+			v = (v << 8) | p[i];
+		return v;
+	};
+	bool found = false;
+	uint64_t serial = 0, known = 0;
+	for(size_t at = 0; at + 27 <= V -> Size; ) {
+		const auto h = V -> Data + at;
+		const size_t header = 27 + h[26];
+		size_t body = 0;
+		if(at + header <= V -> Size)
+			for(size_t s = 27; s < header; s++)
+				body += h[s];
+		if( memcmp(h, "OggS", 4) != 0 || h[4] != 0 || at + header + body > V -> Size || AmOggCRC(h, header + body) != le(h + 22, 4) ) {
+			at++;   // Resync
+			continue;
+		}
+		if(!found && (h[5] & 2)) {
+			found = true;
+			serial = le(h + 14, 4);
+		}
+		if( found && le(h + 14, 4) == serial ) {
+			AmOggPage P;
+			P.Header = at;
+			P.Body = at + header;
+			P.Granule = (ma_int64)le(h + 6, 8);
+			P.Flags = h[5];
+			P.Segments = h[26];
+			if(P.Granule >= 0)
+				known = (ma_uint64)P.Granule;
+			P.Known = known;
+			V -> Pages.push_back(P);
+			if(P.Flags & 4)
+				break;
+		}
+		at += header + body;
+	}
+	return !V -> Pages.empty();
+}
+inline bool AmVorbisHeader(const std::vector<uint8_t>& packet, uint8_t type) {
+	return packet.size() >= 7 && packet[0] == type && memcmp(&packet[1], "vorbis", 6) == 0;
+}
+static bool AmVorbisSetup(AmVorbis* V) {   // The 3 header packets
+	ma_int64 granule;
+
+	// Identification
+	if( !AmVorbisReadPacket(V, granule) || !AmVorbisHeader(V -> Packet, 1) )
+		return false;
+	AmVorbisBits I( V -> Packet.data() + 7, V -> Packet.size() - 7 );
+	const auto version = I.Read(32);
+	V -> Channels = I.Read(8);
+	V -> SampleRate = I.Read(32);
+	I.Read(32);		I.Read(32);		I.Read(32);   // Bitrates
+	const int b0 = I.Read(4), b1 = I.Read(4);
+	if( version || !V -> Channels || !V -> SampleRate || b0 < 6 || b1 > 13 || b0 > b1 || !I.Read(1) || I.End )
+		return false;
+	V -> Blocksize[0] = 1u << b0;
+	V -> Blocksize[1] = 1u << b1;
+
+	// Comments: nothing taken
+	if( !AmVorbisReadPacket(V, granule) || !AmVorbisHeader(V -> Packet, 3) )
+		return false;
+
+	// Setup: codebooks, time placeholders, floors, residues, mappings & modes
+	if( !AmVorbisReadPacket(V, granule) || !AmVorbisHeader(V -> Packet, 5) )
+		return false;
+	AmVorbisBits B( V -> Packet.data() + 7, V -> Packet.size() - 7 );
+	V -> Books.resize( B.Read(8) + 1 );
+	for(auto& K : V -> Books)
+		if( !AmVorbisReadBook(B, K) )
+			return false;
+	for(int t = B.Read(6) + 1; t > 0; t--)
+		if( B.Read(16) )
+			return false;
+	V -> Floors.resize( B.Read(6) + 1 );
+	for(auto& F : V -> Floors)
+		if( !AmVorbisReadFloor(B, F, V -> Books, V -> Blocksize) )
+			return false;
+	V -> Residues.resize( B.Read(6) + 1 );
+	for(auto& R : V -> Residues)
+		if( !AmVorbisReadResidue(B, R, V -> Books) )
+			return false;
+	V -> Mappings.resize( B.Read(6) + 1 );
+	const auto C = V -> Channels;
+	for(auto& M : V -> Mappings) {
+		if( B.Read(16) )
+			return false;
+		M.Submaps = B.Read(1) ? B.Read(4) + 1 : 1;
+		if( B.Read(1) )
+			for(int s = B.Read(8) + 1; s > 0; s--) {
+				const auto mag = B.Read( AmILog(C - 1) ), ang = B.Read( AmILog(C - 1) );
+				if(mag == ang || mag >= C || ang >= C)
+					return false;
+				M.Magnitude.push_back( (uint8_t)mag );
+				M.Angle.push_back( (uint8_t)ang );
+			}
+		if( B.Read(2) )
+			return false;
+		M.Mux.assign(C, 0);
+		if(M.Submaps > 1)
+			for(auto& mux : M.Mux)
+				if( (mux = (uint8_t)B.Read(4)) >= M.Submaps )
+					return false;
+		for(int s = 0; s < M.Submaps; s++) {
+			B.Read(8);   // Time placeholder
+			M.Floor[s] = B.Read(8);
+			M.Residue[s] = B.Read(8);
+			if( M.Floor[s] >= (int)V -> Floors.size() || M.Residue[s] >= (int)V -> Residues.size() )
+				return false;
+		}
+	}
+	V -> Modes.resize( B.Read(6) + 1 );
+	for(auto& O : V -> Modes) {
+		O.Long = B.Read(1);
+		const auto window = B.Read(16), transform = B.Read(16);
+		O.Mapping = B.Read(8);
+		if( window || transform || O.Mapping >= (int)V -> Mappings.size() )
+			return false;
+	}
+	if( !B.Read(1) || B.End )
+		return false;
+	V -> FirstPage = V -> Page;
+	V -> FirstSegment = V -> Segment;
+	V -> FirstOffset = V -> Offset;
+
+	// Transforms, windows & buffers
+	for(int w = 0; w < 2; w++) {
+		const auto n = V -> Blocksize[w], half = n / 2, quarter = n / 4;
+		V -> FFT.emplace_back(half);
+		auto& T = V -> Twiddle[w];
+		T.resize(4 * quarter);
+		for(ma_uint32 k = 0; k < quarter; k++) {
+			T[k] = (float)cos(3.14159265358979 * k / half);
+			T[quarter + k] = (float)sin(3.14159265358979 * k / half);
+			T[2 * quarter + k] = (float)cos(3.14159265358979 * (k + 0.25) / half);
+			T[3 * quarter + k] = (float)sin(3.14159265358979 * (k + 0.25) / half);
+		}
+		V -> Window[w].resize(half);
+		for(ma_uint32 i = 0; i < half; i++) {
+			const auto s = sin( (i + 0.5) / half * 1.5707963267949 );
+			V -> Window[w][i] = (float)sin( 1.5707963267949 * s * s );
+		}
+	}
+	const size_t half = V -> Blocksize[1] / 2;
+	V -> Spectrum.assign(C * half, 0.0f);
+	V -> Curve.assign(C * half, 0.0f);
+	V -> Block.assign(C * half * 2, 0.0f);
+	V -> Previous.assign(C * half, 0.0f);
+	V -> Interleaved.assign(C * half, 0.0f);
+	V -> Scratch.assign(half * 2, 0.0f);
+	V -> Out.assign(C * half * 2, 0.0f);   // Up to 3/4 of a long block, when a short one follows
+	size_t classes = 0;
+	for(const auto& R : V -> Residues) {
+		const auto words = V -> Books[R.ClassBook].Dims;
+		classes = std::max( classes, (R.Type == 2) ? C * half / R.PartitionSize + words : C * (half / R.PartitionSize + words) );
+	}
+	V -> Classes.assign(classes, 0);
+	V -> Length = V -> Pages.back().Known;
+	AmVorbisRestart(V, V -> FirstPage, V -> FirstSegment, V -> FirstOffset, 0);
+	return true;
+}
+
+// Backend
+static void AmVorbisClose(AmVorbis* V) {
+	ma_data_source_uninit(&V -> Base);
+	ma_free(V -> Owned, &V -> Allocator);
+	delete V;
+}
+static ma_result AmVorbisOpen(const void* data, size_t size, void* owned, const ma_allocation_callbacks* pAllocationCallbacks, ma_data_source** ppBackend) {
+	const auto V = new AmVorbis();
+	auto config = ma_data_source_config_init();
+		 config.vtable = &AmVorbisVTable;
+	ma_data_source_init(&config, &V -> Base);
+	V -> Allocator = *pAllocationCallbacks;
+	V -> Data = (const uint8_t*)data;
+	V -> Size = size;
+	V -> Owned = owned;
+	if( !AmOggIndex(V) || !AmVorbisSetup(V) ) {
+		AmVorbisClose(V);
+		return MA_INVALID_FILE;
+	}
+	*ppBackend = &V -> Base;
+	return MA_SUCCESS;
+}
+static ma_result AmVorbisInit(void*, ma_read_proc onRead, ma_seek_proc, ma_tell_proc, void* pReadSeekTellUserData, const ma_decoding_backend_config*, const ma_allocation_callbacks* pAllocationCallbacks, ma_data_source** ppBackend) {
+	/* Streams get read whole, so that seeks can bisect the page index. */
+	uint8_t magic[4];
+	size_t got = 0;
+	if( onRead(pReadSeekTellUserData, magic, 4, &got) != MA_SUCCESS || got != 4 || memcmp(magic, "OggS", 4) != 0 )
+		return MA_INVALID_FILE;
+	size_t size = 4, capacity = 1 << 20;
+	auto data = (uint8_t*)ma_malloc(capacity, pAllocationCallbacks);
+	for(;;) {
+		if(!data)
+			return MA_OUT_OF_MEMORY;
+		if(size == 4)
+			memcpy(data, magic, 4);
+		got = 0;
+		const auto result = onRead(pReadSeekTellUserData, data + size, capacity - size, &got);
+		size += got;
+		if(result != MA_SUCCESS || !got)
+			break;
+		if(size == capacity) {
+			const auto grown = (uint8_t*)ma_realloc(data, capacity * 2, pAllocationCallbacks);
+			if(!grown)
+				ma_free(data, pAllocationCallbacks);
+			data = grown;
+			capacity *= 2;
+		}
+	}
+	return AmVorbisOpen(data, size, data, pAllocationCallbacks, ppBackend);
+}
+static ma_result AmVorbisInitMemory(void*, const void* pData, size_t dataSize, const ma_decoding_backend_config*, const ma_allocation_callbacks* pAllocationCallbacks, ma_data_source** ppBackend) {
+	if( dataSize < 4 || memcmp(pData, "OggS", 4) != 0 )
+		return MA_INVALID_FILE;
+	return AmVorbisOpen(pData, dataSize, nullptr, pAllocationCallbacks, ppBackend);
+}
+static void AmVorbisUninit(void*, ma_data_source* pBackend, const ma_allocation_callbacks*) {
+	AmVorbisClose( (AmVorbis*)pBackend );
+}
+ma_decoding_backend_vtable AmVorbisBackend = {
+	AmVorbisInit, nullptr, nullptr, AmVorbisInitMemory, AmVorbisUninit
+};
+ma_decoding_backend_vtable* AmDecoders[AM_DECODERS] = { &AmVorbisBackend };
+
+
+/* Loudness Metering */
+// EBU R128 / ITU-R BS.1770: K-weighted mean squares over 100ms segments, gated 400ms blocks, and a 4x oversampled true peak.
+// Audio is metered in chunks of deinterleaved channels; the biquads are recursive, but the FIR & reductions are contiguous loops.
+constexpr ma_uint32 AM_METER_CHUNK = 1024;
+constexpr ma_uint32 AM_PEAK_TAPS = 12;   // Per phase, 4 phases
+struct AmLoudnessMeter {
+	ma_uint32 Channels, SampleRate;
+	double B[2][3], A[2][3];   // Pre-filter (high shelf) & RLB (high-pass)
+	std::vector<double> State;   // 4 per channel
+	std::vector<float> Weights, History;   // History: AM_PEAK_TAPS - 1 per channel
+	float Taps[4][AM_PEAK_TAPS];   // Polyphase interpolator, by phase
+
+	std::vector<double> Segments;   // Weighted mean squares per 100ms
+	double SegmentSum;
+	ma_uint32 SegmentFrames, SegmentLength;
+	ma_uint64 Frames;
+	float Peak;
+
+	AmLoudnessMeter(ma_uint32 channels, ma_uint32 rate) : Channels(channels), SampleRate(rate),
+		State(channels * 4, 0.0), Weights(channels, 1.0f), History(channels * (AM_PEAK_TAPS - 1), 0.0f),
+		SegmentSum(0.0), SegmentFrames(0), SegmentLength(rate / 10), Frames(0), Peak(0.0f) {
+		// Coefficients at any rate, as in libebur128
+		double K = tan(3.14159265358979 * 1681.974450955533 / rate), Q = 0.7071752369554196;
+		const double Vh = pow(10.0, 3.999843853973347 / 20.0), Vb = pow(Vh, 0.4996667741545416);
+		double a0 = 1.0 + K / Q + K * K;
+		B[0][0] = (Vh + Vb * K / Q + K * K) / a0;	B[0][1] = 2.0 * (K * K - Vh) / a0;	B[0][2] = (Vh - Vb * K / Q + K * K) / a0;
+		A[0][0] = 1.0;	A[0][1] = 2.0 * (K * K - 1.0) / a0;		A[0][2] = (1.0 - K / Q + K * K) / a0;
+		K = tan(3.14159265358979 * 38.13547087602444 / rate);		Q = 0.5003270373238773;
+		a0 = 1.0 + K / Q + K * K;
+		B[1][0] = 1.0;	B[1][1] = -2.0;		B[1][2] = 1.0;
+		A[1][0] = 1.0;	A[1][1] = 2.0 * (K * K - 1.0) / a0;		A[1][2] = (1.0 - K / Q + K * K) / a0;
+
+		// 5.1: no LFE, and surrounds at +1.5dB; everything else counts as a front channel
+		if(channels == 6) {
+			Weights[3] = 0.0f;		Weights[4] = Weights[5] = 1.41f;
+		}
+
+		// Hann-windowed sinc at 4x, 48 taps centered on tap 24
+		for(ma_uint32 n = 0; n < 4 * AM_PEAK_TAPS; n++) {
+			const double x = (n - 24.0) / 4.0;
+			const double sinc = (x == 0.0) ? 1.0 : sin(3.14159265358979 * x) / (3.14159265358979 * x);
+			Taps[n % 4][n / 4] = (float)( sinc * (0.5 + 0.5 * cos(3.14159265358979 * (n - 24.0) / 24.0)) );
+		}
+	}
+
+	void Feed(const float* pcm, ma_uint64 frames) {   // Interleaved f32
+		const auto C = Channels, H = AM_PEAK_TAPS - 1;
+		float x[H + AM_METER_CHUNK], y[4][AM_METER_CHUNK];
+		double sq[AM_METER_CHUNK];
+		while(frames) {
+			const auto n = (ma_uint32)std::min<ma_uint64>(frames, AM_METER_CHUNK);
+			std::fill(sq, sq + n, 0.0);
+			for(ma_uint32 c = 0; c < C; c++) {
+				for(ma_uint32 i = 0; i < n; i++)
+					x[H + i] = pcm[i * C + c];
+				std::copy(&History[c * H], &History[c * H] + H, x);
+				std::copy(x + n, x + n + H, &History[c * H]);
+
+				// True peak: each phase accumulates over contiguous samples
+				for(ma_uint32 p = 0; p < 4; p++) {
+					float* __restrict out = y[p];
+					std::fill(out, out + n, 0.0f);
+					for(ma_uint32 k = 0; k < AM_PEAK_TAPS; k++) {
+						const float t = Taps[p][k];
+						const float* __restrict in = x + H - k;
+						for(ma_uint32 i = 0; i < n; i++)
+							out[i] += in[i] * t;
+					}
+					float peak = Peak;
+					for(ma_uint32 i = 0; i < n; i++)
+						peak = std::max( peak, fabsf(out[i]) );
+					Peak = peak;
+				}
+
+				// K-weighting, in double for the low corner at high rates
+				if(Weights[c] == 0.0f)
+					continue;
+				double* z = &State[c * 4];
+				const double w = Weights[c];
+				for(ma_uint32 i = 0; i < n; i++) {
+					double v = x[H + i];
+					for(int s = 0; s < 2; s++) {
+						const double out = B[s][0] * v + z[s * 2];
+						z[s * 2] = B[s][1] * v - A[s][1] * out + z[s * 2 + 1];
+						z[s * 2 + 1] = B[s][2] * v - A[s][2] * out;
+						v = out;
+					}
+					sq[i] += w * v * v;
+				}
+			}
+
+			// 100ms segments
+			for(ma_uint32 i = 0; i < n; i++) {
+				SegmentSum += sq[i];
+				if(++SegmentFrames == SegmentLength) {
+					Segments.push_back(SegmentSum / SegmentLength);
+					SegmentSum = 0.0;
+					SegmentFrames = 0;
+				}
+			}
+			pcm += n * C;
+			frames -= n;
+			Frames += n;
+		}
+	}
+
+	bool Integrated(double& lufs) const {   // False if everything got gated; sounds shorter than one block are measured as one
+		std::vector<double> blocks;
+		for(size_t i = 3; i < Segments.size(); i++)
+			blocks.push_back( (Segments[i - 3] + Segments[i - 2] + Segments[i - 1] + Segments[i]) / 4.0 );
+		if( blocks.empty() ) {
+			double sum = SegmentSum;
+			for(auto s : Segments)
+				sum += s * SegmentLength;
+			blocks.push_back( Frames ? sum / Frames : 0.0 );
+		}
+
+		// Absolute gate at -70 LUFS, then a relative one at -10 LU
+		const double absolute = pow(10.0, (-70.0 + 0.691) / 10.0);
+		double sum = 0.0;
+		size_t count = 0;
+		for(auto b : blocks)
+			if(b > absolute) {
+				sum += b;
+				count++;
+			}
+		if(!count)
+			return false;
+		const double relative = sum / count * 0.1;
+		sum = 0.0;
+		count = 0;
+		for(auto b : blocks)
+			if( b > absolute && b > relative ) {
+				sum += b;
+				count++;
+			}
+		lufs = -0.691 + 10.0 * log10(sum / count);
+		return true;
+	}
+	double TruePeak() const {   // dBTP
+		return 20.0 * log10( std::max(Peak, 1e-10f) );
+	}
+};
+
+
+/* Core Implementations */
+// "Am": Aerials miniaudio; the AcAudio:: functions below are the API of core.h, in the order of the Lua bindings
+
+// The "Preview" Engine (fast to load, and slow to play)
+ma_engine PreviewEngine;
+ma_resource_manager* PreviewRM;
+ma_resource_manager_data_source* PreviewResource;   // delete & Set nullptr
+ma_sound* PreviewSound;   // sound_handle: delete & Set nullptr
+AmStretch PreviewStretch;   // Between PreviewSound & PreviewResource
+std::atomic<bool> PreviewPlaying;   // Also read by the audio thread for profiling
+std::unordered_map<uint64_t, float> PreviewGains;   // Content key -> normalization gain, see AmPreviewKey()
+
+// The "Player" Engine (slow to load, and fast to play)
+struct AmResource {
+	AmPCM* PCM;   // Fully decoded in the device format; swapped by AmFinishRebuild()
+	AmADPCM* Compact;   // Replaces PCM for compact resources, also in the device format
+	AmBank* Bank;   // Or, for bank resources, the PCM of Entry in the mapped bank
+	const AmBankEntry* Entry;
+	void* Encoded;   // Copied from the caller or mapped from a file, and kept for re-decoding
+	size_t Size;
+	bool Mapped;
+	AmChartArena* Arena;   // Holds Encoded, if copied while a chart arena was open
+	float Gain;   // Normalization gain, applied as the unit volume
+	float Loudness, TruePeak;   // LUFS & dBTP, once measured
+	bool Measured;
+	uint32_t Units = 0;   // Units created from it & not reclaimed yet, plus offline units reading it; Lua thread only
+	bool Released = false;   // Destroyed once the last of its units gets reclaimed or settled
+};
+struct AmUnit {   // A thin voice, mixed straight from its resource's frames by PlayerBus; see "Voice Mixing"
+	AmResource* Resource;
+	AmUnit *Prev, *Next;   // In the list of voiced units; audio thread only
+	std::atomic<ma_uint64> Position;   // In the resource's frames, 32.32 fixed point; written by the audio thread
+	ma_uint64 Start;   // Bus frame to start at, or 0 for now; audio thread only
+	float Gain;
+	std::atomic<bool> Looping;
+	std::atomic<bool> Voiced;   // Linked in PlayerBus & counted in PlayerVoices; set & cleared by the audio thread
+	bool Playing;   // As requested through the API; Lua thread only
+	std::atomic<uint32_t> Pending;   // Commands enqueued but not applied yet
+};
+struct AmVoiceBus {   // A data source summing all voiced units, in the chart time; stretched as a whole by PlayerStretch
+	ma_data_source_base Base;   // Must be the first member
+	ma_uint32 Channels, SampleRate;
+	std::atomic<ma_uint64> Time;   // Frames mixed so far
+	AmUnit* Head;   // Voiced units
+	float* Blocks;   // AM_BUS_BLOCKS decoded ADPCM blocks of Widest channels, for compact resources; see AmBusBlock()
+	ma_uint32 Widest;
+	uint64_t Cached[AM_BUS_BLOCKS][2];   // Serial & index of each block, serial 0 if none
+	float* Solo;   // The analyzed unit alone
+};
+ma_engine PlayerEngine;
+AmVoiceBus PlayerBus;
+AmStretch PlayerStretch;   // Between PlayerSound & PlayerBus
+ma_sound PlayerSound;   // The only sound of the Player engine
+std::unordered_set<AmResource*> PlayerResources;   // HResource
+AmChartArena* ChartArena;   // The open one, or nullptr
+std::unordered_set<AmUnit*> PlayerUnits;   // HUnit
+std::atomic<bool> PlayerRerouted;   // Set by the device notification; checked in Update()
+std::atomic<float> PlayerRate(1.0f), PreviewRate(1.0f);   // Playback rates for the practice mode, pitch preserved
+ma_uint32 JobThreads = 1, PreviewJobThreads = 1;   // From the Config given to Init()
+ma_uint32 JobQueueCapacity = 1024;
+
+// PreviewRM's job threads are ours rather than miniaudio's, so that they can be raised: stream pages then never wait
+// for a core behind the lowered decode workers, however many keysounds are being decoded. They only fill pages.
+std::vector<std::thread> PreviewJobWorkers;
+static void AmPreviewJobWork() {
+	AmRaiseThread( std::min<int>(AudioPriority, AM_PRIORITY_HIGH) );   // Never real-time: a page may take a while to decode
+	while( ma_resource_manager_process_next_job(PreviewRM) != MA_CANCELLED ) {}   // The quit job stays queued for the others
+}
+
+// On a reroute to another rate/channel count, resources get re-decoded by a worker thread in the background,
+// and then the Player engine is rebuilt around them, so that the device's data converter becomes a passthrough again.
+struct AmRebuildSlot {
+	AmResource* R;   // nullptr once released; the worker never touches it
+	const void* Encoded;
+	size_t Size;
+	bool Compact;
+	AmPCM* PCM;   // Results, nullptr on failure
+	AmADPCM* Blocks;
+};
+struct AmRebuild {
+	ma_uint32 Channels, SampleRate;
+	std::vector<AmRebuildSlot> Slots;   // Sized once before the worker starts
+	std::unordered_map<AmResource*, size_t> Index;   // Into Slots
+	std::vector<AmResource*> Released;   // Destroyed after the worker, which may still read their encoded bytes
+	std::thread Worker;
+	std::atomic<bool> Done, Cancelled;
+};
+AmRebuild* PlayerRebuild;   // nullptr when idle
+
+inline ma_uint32 AmResourceRate(const AmResource* R) {
+	return R -> Compact ? R -> Compact -> SampleRate : R -> Bank ? R -> Entry -> SampleRate : R -> PCM -> SampleRate;
+}
+inline ma_uint64 AmResourceFrames(const AmResource* R) {
+	return R -> Compact ? R -> Compact -> Frames : R -> Bank ? R -> Entry -> Frames : R -> PCM -> Frames;
+}
+
+// Spectrum analyzer state, see "Spectrum Analyzer" below
+constexpr ma_uint32 AM_TAP_CAPACITY = 16384;   // Power of 2
+constexpr ma_uint32 AM_FFT_SIZE = 2048;
+
+struct AmTap {   // Mono frames of the analyzed unit alone, pushed by PlayerBus
+	float Ring[AM_TAP_CAPACITY];
+	std::atomic<uint32_t> Head, Tail;   // Head by the audio thread, Tail by the worker
+};
+AmTap PlayerTap;
+std::atomic<AmUnit*> TapTarget;   // Read by the audio thread; nullptr when nothing is analyzed
+struct AmAnalyzer {
+	AmUnit* Target;   // nullptr once the unit is released
+	ma_uint32 Bands, SampleRate;
+	std::thread Worker;
+	std::atomic<bool> Running;
+	std::atomic<uint32_t> Seq;   // Odd while the worker is writing Levels
+	std::atomic<float> Levels[AM_BANDS_MAX];   // dBFS
+};
+AmAnalyzer* Analyzer;   // nullptr when disabled
+
+// Unit control is applied by the Player audio thread, at the start of each callback.
+// Released units come back through AmRetired, and get freed on the Lua thread.
+enum AmCommandOp : uint8_t { AM_CMD_PLAY, AM_CMD_STOP, AM_CMD_SEEK, AM_CMD_RETIRE };
+struct AmCommand {
+	AmUnit* U;
+	uint64_t Frame;   // PLAY: Bus frame to start at (0 for now); SEEK: Target frame
+	AmCommandOp Op;
+	bool Flag;   // PLAY: IsLooping; STOP: Rewind to Start
+};
+constexpr uint32_t AM_CMD_CAPACITY = 1024;
+AmRing<AmCommand, AM_CMD_CAPACITY> AmCommands;
+AmRing<AmUnit*, AM_CMD_CAPACITY> AmRetired;   // Reclaimed before each RETIRE enqueue, so it never overflows
+
+inline bool AmEnqueue(AmUnit* U, AmCommandOp op, bool flag, uint64_t frame) {
+	if(op != AM_CMD_RETIRE)
+		U -> Pending.fetch_add(1, std::memory_order_relaxed);
+	if( AmCommands.Push({U, frame, op, flag}) )
+		return true;
+	if(op != AM_CMD_RETIRE)
+		U -> Pending.fetch_sub(1, std::memory_order_relaxed);
+	return false;
+}
+// Voice Mixing
+// Voiced units are linked into PlayerBus, and mixed from their resources' frames in place, chunk by chunk;
+// so a unit costs a few dozen bytes, and idle ones cost no mixing at all. The bus output is in the device format.
+constexpr ma_uint32 AM_BUS_CHUNK = 256;   // Frames
+
+inline void AmVoice(AmUnit* U) {   // Audio thread; or the Lua thread once the device is stopped
+	if( U -> Voiced.load(std::memory_order_relaxed) )
+		return;
+	U -> Prev = nullptr;
+	U -> Next = PlayerBus.Head;
+	if(PlayerBus.Head)
+		PlayerBus.Head -> Prev = U;
+	PlayerBus.Head = U;
+	U -> Voiced.store(true, std::memory_order_release);
+	PlayerVoices.fetch_add(1, std::memory_order_relaxed);
+}
+inline void AmUnvoice(AmUnit* U) {
+	if( !U -> Voiced.load(std::memory_order_relaxed) )
+		return;
+	(U -> Prev ? U -> Prev -> Next : PlayerBus.Head) = U -> Next;
+	if(U -> Next)
+		U -> Next -> Prev = U -> Prev;
+	U -> Voiced.store(false, std::memory_order_release);
+	PlayerVoices.fetch_sub(1, std::memory_order_relaxed);
+}
+
+static ma_uint32 AmMixSegment(float* __restrict out, ma_uint32 C, ma_uint32 n, const float* __restrict seg, ma_uint64 base, ma_uint64 end,
+							  ma_uint32 srcC, ma_uint64& pos, ma_uint64 step, float gain) {
+	/* Adds gain x frames [pos, end) of a segment starting at frame "base", until n frames are out; returns the frames mixed. */
+	constexpr ma_uint64 one = 1ull << 32;
+	if(step == one && srcC == C) {   // Same format: a plain scaled add
+		const auto f = pos >> 32;
+		const auto m = (ma_uint32)std::min<ma_uint64>(n, end - f);
+		const auto src = seg + (f - base) * C;
+		for(ma_uint32 k = 0; k < m * C; k++)
+			out[k] += gain * src[k];
+		pos += m * one;
+		return m;
+	}
+
+	// Otherwise linear interpolation, with source channels repeated over the output ones
+	ma_uint32 i = 0;
+	for(; i < n; i++, pos += step) {
+		const auto f = pos >> 32;
+		if(f >= end)
+			break;
+		const auto a = seg + (f - base) * srcC;
+		const auto b = (f + 1 < end) ? a + srcC : a;
+		const float t = (float)(pos & (one - 1)) * (1.0f / 4294967296.0f);
+		for(ma_uint32 c = 0; c < C; c++) {
+			const auto k = c % srcC;
+			out[i * C + c] += gain * ( a[k] + (b[k] - a[k]) * t );
+		}
+	}
+	return i;
+}
+static const float* AmBusBlock(AmVoiceBus* B, const AmADPCM* A, ma_uint64 block) {   // Audio thread
+	/* A voice spans 1~2 blocks per chunk, so blocks stay decoded across chunks; direct-mapped, consecutive blocks in consecutive slots. */
+	const auto slot = (ma_uint32)(A -> Serial * 0x9E3779B9u + block) & (AM_BUS_BLOCKS - 1);
+	const auto out = B -> Blocks + (size_t)slot * AM_ADPCM_BLOCK * B -> Widest;
+	auto& key = B -> Cached[slot];
+	if( key[0] != A -> Serial || key[1] != block ) {
+		AmADPCMDecode(A, block, out);
+		key[0] = A -> Serial;
+		key[1] = block;
+	}
+	return out;
+}
+static bool AmMixVoice(AmVoiceBus* B, AmUnit* U, float* out, ma_uint32 n) {   // Audio thread; false once the unit ended
+	const auto R = U -> Resource;
+	const auto A = R -> Compact;
+	const float* data = nullptr;
+	ma_uint32 srcC;
+	if(A)
+		srcC = A -> Channels;
+	else if(R -> Bank) {
+		data = (const float*)(R -> Bank -> Data + R -> Entry -> Offset);
+		srcC = R -> Entry -> Channels;
+	}
+	else {
+		data = R -> PCM -> Data;
+		srcC = R -> PCM -> Channels;
+	}
+	const auto frames = AmResourceFrames(R);
+	const auto step = ( (ma_uint64)AmResourceRate(R) << 32 ) / B -> SampleRate;
+
+	auto pos = U -> Position.load(std::memory_order_relaxed);
+	ma_uint32 done = 0;
+	while(done < n) {
+		const auto f = pos >> 32;
+		if(f >= frames) {
+			if( !U -> Looping.load(std::memory_order_relaxed) ) {
+				U -> Position.store(frames << 32, std::memory_order_relaxed);
+				return false;
+			}
+			pos %= frames << 32;
+			continue;
+		}
+		if(A) {   // Compact: one block at a time
+			const auto block = f / AM_ADPCM_BLOCK;
+			const auto seg = AmBusBlock(B, A, block);
+			const auto base = block * AM_ADPCM_BLOCK;
+			done += AmMixSegment( out + done * B -> Channels, B -> Channels, n - done, seg, base, std::min(base + AM_ADPCM_BLOCK, frames), srcC, pos, step, U -> Gain );
+		}
+		else
+			done += AmMixSegment( out + done * B -> Channels, B -> Channels, n - done, data, 0, frames, srcC, pos, step, U -> Gain );
+	}
+	U -> Position.store(pos, std::memory_order_relaxed);
+	return true;
+}
+static void AmTapPush(const float* in, ma_uint32 frames, ma_uint32 C) {   // Mono mix into the ring; whatever doesn't fit is dropped
+	auto& T = PlayerTap;
+	const auto head = T.Head.load(std::memory_order_relaxed);
+	const auto room = AM_TAP_CAPACITY - ( head - T.Tail.load(std::memory_order_acquire) );
+	const auto n = std::min(frames, room);
+	const float scale = 1.0f / C;
+	for(ma_uint32 i = 0; i < n; i++) {
+		float sum = 0.0f;
+		for(ma_uint32 c = 0; c < C; c++)
+			sum += in[i * C + c];
+		T.Ring[ (head + i) & (AM_TAP_CAPACITY - 1) ] = sum * scale;
+	}
+	T.Head.store(head + n, std::memory_order_release);
+}
+
+static ma_result AmBusRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead) {   // Audio thread
+	const auto B = (AmVoiceBus*)pDataSource;
+	const auto C = B -> Channels;
+	const auto tapped = TapTarget.load(std::memory_order_acquire);
+	const auto out = (float*)pFramesOut;
+	memset( out, 0, sizeof(float) * (size_t)frameCount * C );
+
+	for(ma_uint64 done = 0; done < frameCount; ) {
+		const auto n = (ma_uint32)std::min<ma_uint64>(AM_BUS_CHUNK, frameCount - done);
+		const auto now = B -> Time.load(std::memory_order_relaxed);
+		for(auto U = B -> Head; U; ) {
+			const auto next = U -> Next;   // U may get unvoiced below
+			ma_uint32 skip = 0;
+			if(U -> Start) {   // Scheduled by PlayUnit with a delay
+				if(U -> Start >= now + n) {
+					U = next;
+					continue;
+				}
+				skip = (U -> Start > now) ? (ma_uint32)(U -> Start - now) : 0;
+				U -> Start = 0;
+			}
+
+			bool alive;
+			if(U == tapped) {   // Mixed alone first, for the analyzer
+				memset( B -> Solo, 0, sizeof(float) * n * C );
+				alive = AmMixVoice( B, U, B -> Solo + skip * C, n - skip );
+				for(ma_uint32 k = 0; k < n * C; k++)
+					out[done * C + k] += B -> Solo[k];
+				AmTapPush(B -> Solo, n, C);
+			}
+			else
+				alive = AmMixVoice( B, U, out + (done + skip) * C, n - skip );
+			if(!alive)
+				AmUnvoice(U);
+			U = next;
+		}
+		B -> Time.store(now + n, std::memory_order_relaxed);
+		done += n;
+	}
+	if(pFramesRead)
+		*pFramesRead = frameCount;
+	return MA_SUCCESS;   // Never ends
+}
+static ma_result AmBusSeek(ma_data_source* pDataSource, ma_uint64 frameIndex) {
+	return MA_SUCCESS;   // Units seek on their own
+}
+static ma_result AmBusGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels, ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap) {
+	const auto B = (AmVoiceBus*)pDataSource;
+	*pFormat = ma_format_f32;
+	*pChannels = B -> Channels;
+	*pSampleRate = B -> SampleRate;
+	ma_channel_map_init_standard(ma_standard_channel_map_default, pChannelMap, channelMapCap, B -> Channels);
+	return MA_SUCCESS;
+}
+static ma_result AmBusGetCursor(ma_data_source* pDataSource, ma_uint64* pCursor) {
+	*pCursor = ((AmVoiceBus*)pDataSource) -> Time.load(std::memory_order_relaxed);
+	return MA_SUCCESS;
+}
+ma_data_source_vtable AmBusVTable = {
+	AmBusRead, AmBusSeek, AmBusGetDataFormat, AmBusGetCursor, nullptr, nullptr, 0
+};
+
+static void AmApplyCommands() {   // Player audio thread; or the Lua thread once the device is stopped
+	AmCommand C;
+	while( AmCommands.Pop(C) ) {
+		const auto U = C.U;
+		switch(C.Op) {
+			case AM_CMD_PLAY:
+				U -> Looping.store(C.Flag, std::memory_order_relaxed);
+				U -> Start = C.Frame;
+				if( (U -> Position.load(std::memory_order_relaxed) >> 32) >= AmResourceFrames(U -> Resource) )   // Replays once ended
+					U -> Position.store(0, std::memory_order_relaxed);
+				AmVoice(U);
+			break;
+
+			case AM_CMD_STOP:
+				AmUnvoice(U);
+				if(C.Flag)
+					U -> Position.store(0, std::memory_order_relaxed);
+			break;
+
+			case AM_CMD_SEEK:
+				U -> Position.store(C.Frame << 32, std::memory_order_relaxed);
+			break;
+
+			case AM_CMD_RETIRE:
+				AmUnvoice(U);
+				AmRetired.Push(U);
+			continue;   // No Pending count for retirements
+		}
+		U -> Pending.fetch_sub(1, std::memory_order_release);
+	}
+}
+static void AmDropResource(AmResource* R);
+static void AmReclaimUnits() {   // Lua thread
+	AmUnit* U;
+	while( AmRetired.Pop(U) ) {
+		const auto R = U -> Resource;
+		delete U;   // Remind to pair the "new" operator
+		if( --(R -> Units) == 0 && R -> Released )
+			AmDropResource(R);
+	}
+}
+
+// Player Clock
+// A seqlock over the Player callback: Seq is odd while a callback mixes, so that a reader sees the counters & the unit positions
+// of one callback end. Published by the audio thread only, and read by TakeSnapshot().
+// Each callback also adds (its start, the frames handed so far) to a least-squares line of frames over time, weighted by
+// exp(-age / AM_CLOCK_WINDOW) and kept centered on the latest pair, so an update is a handful of flops. The line gets its own
+// seqlock, odd only while 3 values get stored, for AudioTimeAt() & MonotonicAt(); its rate is 0 until 2 callbacks are in the fit.
+constexpr double AM_CLOCK_WINDOW = 10.0;   // s
+constexpr double AM_CLOCK_GAP = 0.25;   // s; a longer gap between callbacks means a stopped device, and restarts the fit
+constexpr double AM_CLOCK_MIN_WEIGHT = 16.0;   // Callbacks before the fit replaces the nominal rate
+
+struct AmClockFit {   // Weighted sums over (seconds, frames) relative to the latest pair; audio thread only
+	uint64_t LastNs, LastFrames;
+	uint32_t SampleRate, Count;   // Count: callbacks since the fit restarted
+	double W, X, Y, XX, XY;
+};
+struct AmClock {
+	std::atomic<uint32_t> Seq;
+	std::atomic<uint64_t> EngineFrames;   // Output frames of the Player device so far
+	std::atomic<uint64_t> CallbackNs;   // Monotonic start of the last callback
+
+	AmClockFit Fit;
+	std::atomic<uint32_t> LineSeq;
+	std::atomic<uint64_t> LineNs;   // The line passes through (LineNs, LineFrames)
+	std::atomic<double> LineFrames, LineRate;   // Frames, & frames per monotonic second
+};
+AmClock PlayerClock;
+
+static void AmClockPublish(AmClock& C, uint64_t ns, double frames, double rate) {
+	C.LineSeq.fetch_add(1, std::memory_order_relaxed);   // Odd
+	std::atomic_thread_fence(std::memory_order_release);
+	C.LineNs.store(ns, std::memory_order_relaxed);
+	C.LineFrames.store(frames, std::memory_order_relaxed);
+	C.LineRate.store(rate, std::memory_order_relaxed);
+	C.LineSeq.fetch_add(1, std::memory_order_release);   // Even
+}
+static void AmClockUpdate(AmClock& C, uint64_t ns, uint64_t frames, uint32_t rate) {   // Audio thread
+	auto& F = C.Fit;
+	const double dx = (double)(int64_t)(ns - F.LastNs) * 1e-9;
+	const double dy = (double)(int64_t)(frames - F.LastFrames);
+	if( !F.LastNs || rate != F.SampleRate || dx <= 0.0 || dx > AM_CLOCK_GAP ) {
+		F.W = F.X = F.Y = F.XX = F.XY = 0.0;
+		F.SampleRate = rate;
+		F.Count = 0;
+	}
+	else {   // Move the origin to the new pair, then age everything by dx
+		const double decay = exp(-dx / AM_CLOCK_WINDOW);
+		const double X = F.X - dx * F.W, Y = F.Y - dy * F.W;
+		F.XX = (F.XX - 2.0 * dx * F.X + dx * dx * F.W) * decay;
+		F.XY = (F.XY - dx * F.Y - dy * F.X + dx * dy * F.W) * decay;
+		F.X = X * decay;
+		F.Y = Y * decay;
+		F.W *= decay;
+	}
+	F.W += 1.0;   // The new pair sits at (0, 0)
+	F.LastNs = ns;
+	F.LastFrames = frames;
+	F.Count++;
+
+	double slope = (F.Count >= 2) ? rate : 0.0, offset = 0.0;   // One callback is no line yet
+	const double det = F.W * F.XX - F.X * F.X;
+	if( F.W >= AM_CLOCK_MIN_WEIGHT && det > 0.0 ) {
+		slope = (F.W * F.XY - F.X * F.Y) / det;
+		offset = (F.Y - slope * F.X) / F.W;
+	}
+
+	AmClockPublish(C, ns, (double)frames + offset, slope);
+}
+static void AmClockReset(AmClock& C) {   // Lua thread, with the device stopped; until 2 callbacks again, there is no line
+	C.Fit = AmClockFit();
+	AmClockPublish(C, 0, 0.0, 0.0);
+}
+static bool AmClockLine(uint64_t& ns, double& frames, double& rate) {   // Lua thread; false without a line
+	for(;;) {
+		const auto seq = PlayerClock.LineSeq.load(std::memory_order_acquire);
+		if( !(seq & 1) ) {
+			ns = PlayerClock.LineNs.load(std::memory_order_relaxed);
+			frames = PlayerClock.LineFrames.load(std::memory_order_relaxed);
+			rate = PlayerClock.LineRate.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if( PlayerClock.LineSeq.load(std::memory_order_relaxed) == seq )
+				break;
+		}
+	}
+	return rate > 0.0;
+}
+
+// Device Callbacks
+static void AmDataCallback(ma_device* pDevice, void* pFramesOut, const void* pFramesIn, ma_uint32 frameCount) {
+	const auto E = (ma_engine*)pDevice -> pUserData;
+	static thread_local bool scheduled = false;   // Once per device thread; a restarted device may bring a new one
+	if(!scheduled) {
+		scheduled = true;
+		auto& St = (E == &PlayerEngine) ? PlayerStats : PreviewStats;
+		St.Priority.store( AmRaiseThread(AudioPriority), std::memory_order_relaxed );
+		St.Cores.store( AmPinThread(), std::memory_order_relaxed );
+	}
+	const auto T0 = AmNowNs();
+	if(E == &PlayerEngine) {
+		PlayerClock.Seq.fetch_add(1, std::memory_order_relaxed);   // Odd
+		std::atomic_thread_fence(std::memory_order_release);
+		AmApplyCommands();
+	}
+	ma_engine_read_pcm_frames(E, pFramesOut, frameCount, nullptr);
+	if(E == &PlayerEngine) {
+		const auto handed = PlayerClock.EngineFrames.fetch_add(frameCount, std::memory_order_relaxed);
+		PlayerClock.CallbackNs.store(T0, std::memory_order_relaxed);
+		PlayerClock.Seq.fetch_add(1, std::memory_order_release);   // Even
+		AmClockUpdate(PlayerClock, T0, handed, pDevice -> sampleRate);
+	}
+	const auto T1 = AmNowNs();
+
+	if(E == &PlayerEngine)
+		AmStatsRecord(PlayerStats, T0, T1, frameCount, pDevice -> sampleRate, PlayerVoices.load(std::memory_order_relaxed));
+	else
+		AmStatsRecord(PreviewStats, T0, T1, frameCount, pDevice -> sampleRate, PreviewPlaying ? 1 : 0);
+}
+
+static void AmNotificationCallback(const ma_device_notification* pNotification) {
+	if(pNotification -> type == ma_device_notification_type_rerouted)
+		PlayerRerouted.store(true, std::memory_order_release);
+}
+
+// Loudness Normalization
+static ma_result AmMeterSource(ma_data_source* pSource, double& lufs, double& dbtp) {   // Reads the source to its end; MA_NO_DATA_AVAILABLE if silent
+	ma_format format;
+	ma_uint32 channels, rate;
+	auto result = ma_data_source_get_data_format(pSource, &format, &channels, &rate, nullptr, 0);
+	if(result != MA_SUCCESS)
+		return result;
+	if(format != ma_format_f32)
+		return MA_FORMAT_NOT_SUPPORTED;
+
+	AmLoudnessMeter M(channels, rate);
+	std::vector<float> chunk(AM_METER_CHUNK * channels);
+	for(;;) {
+		ma_uint64 read = 0;
+		result = ma_data_source_read_pcm_frames(pSource, chunk.data(), AM_METER_CHUNK, &read);
+		if(read)
+			M.Feed(chunk.data(), read);
+		if(result != MA_SUCCESS || read < AM_METER_CHUNK)
+			break;
+	}
+	dbtp = M.TruePeak();
+	return M.Integrated(lufs) ? MA_SUCCESS : MA_NO_DATA_AVAILABLE;
+}
+inline float AmNormalizeGain(double lufs, double dbtp, double target) {   // Keeps 1dB of true-peak headroom
+	return (float)pow( 10.0, std::min(target - lufs, -1.0 - dbtp) / 20.0 );
+}
+inline uint64_t AmPreviewKey(const uint8_t* data, size_t size) {   // FNV-1a over the size & both ends of the file
+	uint64_t h = 14695981039346656037ull ^ size;
+	const size_t span = std::min<size_t>(size, 4096);
+	for(size_t i = 0; i < span; i++)
+		h = (h ^ data[i]) * 1099511628211ull;
+	for(size_t i = size - span; i < size; i++)
+		h = (h ^ data[i]) * 1099511628211ull;
+	return h;
+}
+
+// Parallel Loops
+// Splits [0, count) into one contiguous slice per core, or per thread if given; fn(begin, end) runs on the calling thread too.
+template<typename F> void AmParallelFor(size_t count, const F& fn, size_t threads = 0) {
+	size_t n = threads ? threads : std::thread::hardware_concurrency();
+	n = (n < 1) ? 1 : (n > count) ? count : n;
+	if(n <= 1) {
+		fn( (size_t)0, count );
+		return;
+	}
+
+	const size_t slice = (count + n - 1) / n;
+	std::vector<std::thread> workers;
+	for(size_t i = 1; i < n; i++) {
+		const size_t begin = i * slice, end = (begin + slice < count) ? begin + slice : count;
+		if(begin < end)
+			workers.emplace_back( [&fn, begin, end]() { AmLowerThread(); fn(begin, end); } );
+	}
+	fn( (size_t)0, slice );
+	for(auto& w : workers)
+		w.join();
+}
+
+// Resource Level
+inline bool AmCopyEncoded(AmResource* R, const void* data, size_t size) {   // Into the open chart arena, if any; false if out of memory
+	R -> Encoded = ChartArena ? AmChartAlloc(ChartArena, size) : AmMemAlloc(size, (void*)AM_MEM_ENCODED);
+	if(!R -> Encoded)
+		return false;
+	R -> Arena = ChartArena;   // Referenced only once there are bytes of R in there
+	if(ChartArena)
+		ChartArena -> Refs++;
+	R -> Size = size;
+	R -> Mapped = false;
+	memcpy(R -> Encoded, data, size);
+	return true;
+}
+inline void AmFreeEncoded(AmResource* R) {
+	if(R -> Mapped)
+		AmUnmapFile(R -> Encoded, R -> Size);
+	else if(R -> Arena) {   // No per-resource frees; the whole arena goes with its last resource
+		if( --(R -> Arena -> Refs) == 0 && !R -> Arena -> Open )
+			AmChartDrop(R -> Arena);
+	}
+	else
+		AmMemFree(R -> Encoded, (void*)AM_MEM_ENCODED);
+}
+inline void AmPrepareResource(AmResource* R) {   // Once Encoded & Size are set
+	R -> PCM = nullptr;
+	R -> Compact = nullptr;
+	R -> Bank = nullptr;
+	R -> Gain = 1.0f;
+	R -> Measured = false;
+}
+static bool AmDecodeResource(AmResource* R, ma_uint32 channels, ma_uint32 rate, bool normalize, double target, bool compact) {   // Thread-safe
+	/* Decodes R -> Encoded in the given format, then meters & compacts it as asked; false if undecodable. */
+	R -> PCM = AmDecodePCM(R -> Encoded, R -> Size, channels, rate);
+	if(!R -> PCM)
+		return false;
+
+	// Optional Normalization, measured on a private cursor
+	if(normalize) {
+		ma_audio_buffer_ref cursor;
+		double lufs, dbtp;
+		if( AmPCMRefInit(R -> PCM, &cursor) == MA_SUCCESS ) {
+			if( AmMeterSource(&cursor, lufs, dbtp) == MA_SUCCESS ) {
+				R -> Loudness = (float)lufs;		R -> TruePeak = (float)dbtp;
+				R -> Gain = AmNormalizeGain(lufs, dbtp, target);
+				R -> Measured = true;
+			}
+			ma_audio_buffer_ref_uninit(&cursor);
+		}
+	}
+
+	// Optional Compaction: the decoded PCM is traded for ADPCM blocks, ~1/8 of its size
+	if(compact) {
+		ma_audio_buffer_ref cursor;
+		if( AmPCMRefInit(R -> PCM, &cursor) == MA_SUCCESS ) {
+			R -> Compact = AmADPCMEncode(&cursor);
+			ma_audio_buffer_ref_uninit(&cursor);
+		}
+		if(R -> Compact) {
+			AmPCMRelease(R -> PCM);
+			R -> PCM = nullptr;
+		}
+	}
+	return true;
+}
+static AmResource* AmLoadResource(AmResource* R, bool normalize, double target, bool compact, const char*& error) {
+	/* Decodes R -> Encoded into a new resource, for CreateResource & CreateResourceFromFile. */
+	AmPrepareResource(R);
+	if( !AmDecodeResource(R, ma_engine_get_channels(&PlayerEngine), ma_engine_get_sample_rate(&PlayerEngine), normalize, target, compact) ) {
+		error = "[!] Audio format not supported by miniaudio";
+		AmFreeEncoded(R);
+		delete R;
+		return nullptr;
+	}
+	PlayerResources.insert(R);
+	return R;
+}
+AmResource* AcAudio::CreateResource(const void* data, size_t size, bool normalize, double target, bool compact, const char*& error) {
+	const auto R = new AmResource;
+	if( !AmCopyEncoded(R, data, size) ) {
+		error = "[!] Out of memory";
+		delete R;
+		return nullptr;
+	}
+	return AmLoadResource(R, normalize, target, compact, error);
+}
+bool AcAudio::CreateResources(const std::vector<Bytes>& bufs, bool normalize, double target, bool compact, std::vector<AmResource*>& out, const char*& error) {
+	/*
+	 * Batch CreateResource: the encoded copies are made first, and then decoded, metered & compacted in parallel, on up to JobThreads threads.
+	 * Failed entries are nullptr in out, and false is returned if any failed; error tells the first failure.
+	 */
+	const auto count = bufs.size();
+
+	// Copy on this thread, since chart arenas aren't thread-safe
+	auto& Rs = out;
+	Rs.assign(count, nullptr);
+	error = nullptr;
+	for(size_t i = 0; i < count; i++) {
+		const auto R = new AmResource;
+		if( !AmCopyEncoded(R, bufs[i].Data, bufs[i].Size) ) {
+			error = "[!] Out of memory";
+			delete R;
+			continue;
+		}
+		AmPrepareResource(R);
+		Rs[i] = R;
+	}
+
+	// Fan out, then drop the failed ones
+	const auto channels = ma_engine_get_channels(&PlayerEngine);
+	const auto rate = ma_engine_get_sample_rate(&PlayerEngine);
+	std::vector<uint8_t> decoded(count);
+	AmParallelFor( Rs.size(), [&Rs, &decoded, channels, rate, normalize, target, compact](size_t begin, size_t end) {
+		for(auto i = begin; i < end; i++)
+			decoded[i] = Rs[i] && AmDecodeResource(Rs[i], channels, rate, normalize, target, compact);
+	}, JobThreads );
+
+	bool all = (error == nullptr);
+	for(size_t i = 0; i < count; i++)
+		if(decoded[i])
+			PlayerResources.insert(Rs[i]);
+		else if(Rs[i]) {
+			if(!error)
+				error = "[!] Audio format not supported by miniaudio";
+			AmFreeEncoded(Rs[i]);
+			delete Rs[i];
+			Rs[i] = nullptr;
+			all = false;
+		}
+	return all;
+}
+AmResource* AcAudio::CreateResourceFromFile(const char* path, bool normalize, double target, bool compact, const char*& error) {
+	// Map the file instead; the mapping lives as long as the resource, so that re-decoding never reopens it
+	size_t size;
+	const auto data = AmMapFile(path, size);
+	if(!data) {
+		error = "[!] Failed to open the file";
+		return nullptr;
+	}
+	const auto R = new AmResource;
+	R -> Encoded = (void*)data;
+	R -> Size = size;
+	R -> Mapped = true;
+	R -> Arena = nullptr;
+	return AmLoadResource(R, normalize, target, compact, error);
+}
+static void AmDestroyResource(AmResource* R) {
+	AmPCMRelease(R -> PCM);
+	AmADPCMFree(R -> Compact);
+	AmFreeEncoded(R);
+	if( R -> Bank && --(R -> Bank -> Refs) == 0 ) {
+		AmUnmapFile(R -> Bank -> Data, R -> Bank -> Size);
+		delete R -> Bank;
+	}
+	delete R;
+}
+static void AmDropResource(AmResource* R) {
+	if( PlayerRebuild && PlayerRebuild -> Index.count(R) ) {   // The worker may be decoding its bytes right now
+		PlayerRebuild -> Slots[ PlayerRebuild -> Index[R] ].R = nullptr;
+		PlayerRebuild -> Index.erase(R);
+		PlayerRebuild -> Released.push_back(R);
+	}
+	else
+		AmDestroyResource(R);
+}
+void AcAudio::ReleaseResource(AmResource* R) {
+	/* Units of the resource keep it alive, until the audio thread is done with the last of them. */
+	PlayerResources.erase(R);
+	if(R -> Units)
+		R -> Released = true;
+	else
+		AmDropResource(R);
+}
+bool AcAudio::GetLoudness(AmResource* R, float& lufs, float& true_peak_db, float& gain_db) {
+	/* False if the resource wasn't normalized. */
+	if( !R -> Measured )
+		return false;
+	lufs = R -> Loudness;
+	true_peak_db = R -> TruePeak;
+	gain_db = (float)( 20.0 * log10(R -> Gain) );
+	return true;
+}
+void AcAudio::EndChart() {
+	if(ChartArena) {
+		ChartArena -> Open = false;
+		if(ChartArena -> Refs == 0)
+			AmChartDrop(ChartArena);
+		ChartArena = nullptr;
+	}
+}
+void AcAudio::BeginChart() {
+	/* Encoded copies made from now on share one arena, freed at once after EndChart() & the release of its last resource. */
+	EndChart();
+	ChartArena = new AmChartArena{ {}, nullptr, 0, 0, true };
+}
+
+// Unit Level
+// PlayUnit, StopUnit, CheckPlaying, GetTime & SetTime run during gameplay: they touch the unit's own fields,
+// and push at most one command into AmCommands. No heap allocations, no locks, and no miniaudio calls; a full queue fails instead.
+AmUnit* AcAudio::CreateUnit(AmResource* R, double& length_ms) {
+	AmReclaimUnits();
+
+	// Create a Voice
+	const auto U = new AmUnit;
+	U -> Resource = R;
+	U -> Prev = U -> Next = nullptr;
+	U -> Position = 0;
+	U -> Start = 0;
+	U -> Gain = R -> Gain;
+	U -> Looping = false;
+	U -> Voiced = false;
+	U -> Playing = false;
+	U -> Pending = 0;
+	PlayerUnits.insert(U);
+	R -> Units++;
+
+	// The Audio Length in Ms
+	length_ms = (double)(uint64_t)( AmResourceFrames(R) * 1000.0 / AmResourceRate(R) );
+	return U;
+}
+bool AcAudio::ReleaseUnit(AmUnit* U) {
+	/*
+	 * The unit is stopped and detached by the audio thread,
+	 * and then freed by a later CreateUnit/ReleaseUnit call.
+	 */
+	AmReclaimUnits();
+	if( !AmEnqueue(U, AM_CMD_RETIRE, false, 0) )
+		return false;
+
+	PlayerUnits.erase(U);
+	if( Analyzer && Analyzer -> Target == U ) {
+		Analyzer -> Target = nullptr;
+		TapTarget.store(nullptr, std::memory_order_release);
+	}
+	return true;
+}
+bool AcAudio::PlayUnit(AmUnit* U, bool is_looping, double delay_ms) {
+	/* delay_ms is counted from now, in the chart time. */
+	uint64_t at = 0;   // The bus runs in the chart time already
+	if(delay_ms > 0.0)
+		at = PlayerBus.Time.load(std::memory_order_relaxed) + (uint64_t)(delay_ms * PlayerBus.SampleRate / 1000.0);
+
+	const bool ok = AmEnqueue(U, AM_CMD_PLAY, is_looping, at);
+	U -> Playing = ok || U -> Playing;
+	return ok;
+}
+bool AcAudio::StopUnit(AmUnit* U, bool rewind) {
+	if( !AmEnqueue(U, AM_CMD_STOP, rewind, 0) )
+		return false;
+	U -> Playing = false;
+	return true;
+}
+bool AcAudio::CheckPlaying(AmUnit* U) {
+	// Trust the requested state until the audio thread applies it
+	if( !U -> Pending.load(std::memory_order_acquire) )
+		U -> Playing = U -> Voiced.load(std::memory_order_acquire);
+	return U -> Playing;
+}
+double AcAudio::GetTime(AmUnit* U) {
+	const auto frames = U -> Position.load(std::memory_order_relaxed) >> 32;
+	return (double)(uint64_t)( frames * 1000.0 / AmResourceRate(U -> Resource) );
+}
+uint64_t AcAudio::GetTimeFrames(AmUnit* U) {
+	return U -> Position.load(std::memory_order_relaxed) >> 32;
+}
+bool AcAudio::SetTime(AmUnit* U, double mstime) {
+	/* Keep in mind that this is an ASYNC API. */
+	if(U -> Playing)
+		return false;
+
+	// Get the sound length
+	const auto rate = AmResourceRate(U -> Resource);
+	const double len = AmResourceFrames(U -> Resource) * 1000.0 / rate;
+
+	// Set the time
+	auto ms = (int64_t)mstime;
+	ms = (ms > 0) ? ms : 0;
+	ms = (ms < len-2.0) ? ms : len-2.0;
+	return AmEnqueue(U, AM_CMD_SEEK, false, (uint64_t)(ms * rate / 1000.0));
+}
+bool AcAudio::SetTimeFrames(AmUnit* U, uint64_t frames) {
+	/* Also ASYNC; clamped to the last frame. */
+	if(U -> Playing)
+		return false;
+	const auto len = AmResourceFrames(U -> Resource);
+	frames = (frames < len) ? frames : (len ? len - 1 : 0);
+	return AmEnqueue(U, AM_CMD_SEEK, false, frames);
+}
+
+// Preview Functions
+void AcAudio::StopPreview() {   // Should be always safe
+	if(PreviewSound) {
+		ma_sound_stop(PreviewSound);
+		ma_sound_uninit(PreviewSound);
+		AmStretchUninit(&PreviewStretch);
+		delete PreviewSound;
+
+		PreviewSound = nullptr;
+		PreviewPlaying = false;
+
+		ma_resource_manager_data_source_uninit(PreviewResource);
+		delete PreviewResource;
+		PreviewResource = nullptr;
+	}
+	AmUnregisterMemory();
+}
+static float AmPreviewGain(const uint8_t* data, size_t size, double target) {
+	/* A full decode on first use, and then cached by content. */
+	const auto key = AmPreviewKey(data, size);
+	const auto it = PreviewGains.find(key);
+	if( it != PreviewGains.end() )
+		return it -> second;
+
+	auto decoder_config			= ma_decoder_config_init(ma_format_f32, 0, 0);
+		 decoder_config.allocationCallbacks	= AmAllocator(AM_MEM_DECODER);
+		 decoder_config.ppCustomBackendVTables	= AmDecoders;
+		 decoder_config.customBackendCount		= AM_DECODERS;
+	ma_decoder decoder;
+	double lufs, dbtp;
+	float gain = 1.0f;
+	if( ma_decoder_init_memory(data, size, &decoder_config, &decoder) == MA_SUCCESS ) {
+		if( AmMeterSource(&decoder, lufs, dbtp) == MA_SUCCESS )
+			gain = PreviewGains[key] = AmNormalizeGain(lufs, dbtp, target);
+		ma_decoder_uninit(&decoder);
+	}
+	return gain;
+}
+static bool AmStartPreview(const char* name, bool is_looping, float gain) {
+	/* Streams "name" through AmMemoryVFS, for PlayPreview & PlayPreviewFromFile. */
+	// Load Resource
+	PreviewResource = new ma_resource_manager_data_source;
+	const auto N = ma_resource_manager_pipeline_notifications_init();
+	const auto res_result = ma_resource_manager_data_source_init(
+		PreviewRM, name,
+		MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_STREAM | MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_WAIT_INIT,
+		&N, PreviewResource);
+
+	// Load Unit & Play
+	if(res_result == MA_SUCCESS) {
+		PreviewSound = new ma_sound;
+		auto unit_result = AmStretchInit(&PreviewStretch, PreviewResource, &PreviewRate);
+		if(unit_result == MA_SUCCESS) {
+			AmStretchPrepare(&PreviewStretch);   // Whatever the rate: starting the sound publishes the buffers to the audio thread
+			unit_result = ma_sound_init_from_data_source(
+				&PreviewEngine, &PreviewStretch,
+				MA_SOUND_FLAG_NO_PITCH | MA_SOUND_FLAG_NO_SPATIALIZATION,
+				nullptr, PreviewSound
+			);
+			if(unit_result != MA_SUCCESS)
+				AmStretchUninit(&PreviewStretch);
+		}
+		if(unit_result == MA_SUCCESS) {
+			// Set Looping & Gain
+			ma_sound_set_looping( PreviewSound, is_looping );
+			ma_sound_set_volume( PreviewSound, gain );
+
+			// Start
+			if( ma_sound_start(PreviewSound) == MA_SUCCESS ) {
+				PreviewPlaying = true;
+				return true;
+			}
+
+			// Clean Up 1
+			ma_sound_stop(PreviewSound);
+			ma_sound_uninit(PreviewSound);
+			AmStretchUninit(&PreviewStretch);
+		}
+
+		// Clean Up 1
+		delete PreviewSound;
+		PreviewSound = nullptr;
+		PreviewPlaying = false;
+
+		// Clean Up 2
+		ma_resource_manager_data_source_uninit(PreviewResource);
+	}
+	else if( res_result != MA_BUSY && ma_resource_manager_data_source_result(PreviewResource) == res_result ) {
+		// The load job failed: it wakes this thread before it is done with the stream, so the stream gets freed by a job too
+		ma_resource_manager_data_source_uninit(PreviewResource);
+	}
+
+	// Clean Up 2
+	delete PreviewResource;
+	PreviewResource = nullptr;
+	return false;
+}
+bool AcAudio::PlayPreview(const void* data, size_t size, bool is_looping, bool normalize, double target) {
+	StopPreview();
+	const float gain = normalize ? AmPreviewGain( (const uint8_t*)data, size, target ) : 1.0f;
+	char name[32];   // The caller keeps the bytes alive until the next StopPreview or PlayPreview, so they are read in place
+	AmRegisterMemory(data, size, name, sizeof(name));
+	if( AmStartPreview(name, is_looping, gain) )
+		return true;
+	AmUnregisterMemory();   // Nothing reads them, and the caller may drop them now
+	return false;
+}
+bool AcAudio::PlayPreviewFromFile(const char* path, bool is_looping, bool normalize, double target) {
+	StopPreview();
+	if( AmIsMemoryPath(path) )   // Not a file name, and reserved for PlayPreview
+		return false;
+
+	// The stream maps the file by itself through AmMemoryVFS; metering maps it once more, briefly
+	float gain = 1.0f;
+	size_t size;
+	const uint8_t* data;
+	if( normalize && (data = AmMapFile(path, size)) ) {
+		gain = AmPreviewGain(data, size, target);
+		AmUnmapFile(data, size);
+	}
+	return AmStartPreview(path, is_looping, gain);
+}
+
+// Playback Rates
+float AcAudio::SetPlaybackRate(float rate) {
+	/* Pitch-preserving; GetTime, SetTime & PlayUnit delays stay in the chart time. */
+	rate = (rate > AM_RATE_MIN) ? rate : AM_RATE_MIN;
+	rate = (rate < AM_RATE_MAX) ? rate : AM_RATE_MAX;
+
+	if(rate != 1.0f)   // Allocate before publishing the rate
+		AmStretchPrepare(&PlayerStretch);
+	PlayerRate.store(rate, std::memory_order_release);
+	return rate;
+}
+float AcAudio::SetPreviewRate(float rate) {
+	rate = (rate > AM_RATE_MIN) ? rate : AM_RATE_MIN;
+	rate = (rate < AM_RATE_MAX) ? rate : AM_RATE_MAX;
+	PreviewRate.store(rate);
+	return rate;
+}
+
+// Player Clock
+uint64_t AcAudio::GetEngineFrames() {
+	return PlayerClock.EngineFrames.load(std::memory_order_relaxed);
+}
+AcAudio::Snapshot AcAudio::TakeSnapshot(AmUnit* U) {
+	/* Retries while a callback mixes, which is as long as the callback takes at worst. */
+	Snapshot S;
+	for(;;) {
+		const auto seq = PlayerClock.Seq.load(std::memory_order_acquire);
+		if(seq & 1) {
+			std::this_thread::yield();
+			continue;
+		}
+		S.EngineFrames = PlayerClock.EngineFrames.load(std::memory_order_relaxed);
+		S.CallbackNs = PlayerClock.CallbackNs.load(std::memory_order_relaxed);
+		S.ChartFrames = PlayerBus.Time.load(std::memory_order_relaxed);
+		S.UnitFrames = U ? ( U -> Position.load(std::memory_order_relaxed) >> 32 ) : 0;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if( PlayerClock.Seq.load(std::memory_order_relaxed) == seq )
+			break;
+	}
+	S.NowNs = AmNowNs();
+
+	uint64_t line_ns;
+	double line_frames;
+	AmClockLine(line_ns, line_frames, S.ClockRate);   // 0 without a line
+
+	// The device buffer, in engine frames; the device only changes it on a reroute
+	const auto device = ma_engine_get_device(&PlayerEngine);
+	S.SampleRate = ma_engine_get_sample_rate(&PlayerEngine);
+	S.LatencyFrames = (uint32_t)( (uint64_t)device -> playback.internalPeriodSizeInFrames * device -> playback.internalPeriods
+		* S.SampleRate / (device -> playback.internalSampleRate ? device -> playback.internalSampleRate : S.SampleRate) );
+	return S;
+}
+
+bool AcAudio::AudioTimeAt(uint64_t ns, double& engine_frames) {
+	uint64_t line_ns;
+	double frames, rate;
+	if( !AmClockLine(line_ns, frames, rate) )
+		return false;
+	engine_frames = frames + (double)(int64_t)(ns - line_ns) * 1e-9 * rate;
+	return true;
+}
+bool AcAudio::MonotonicAt(double engine_frames, uint64_t& ns) {
+	uint64_t line_ns;
+	double frames, rate;
+	if( !AmClockLine(line_ns, frames, rate) )
+		return false;
+	const double delta = (engine_frames - frames) / rate * 1e9;
+	if( !(fabs(delta) < 9e18) || (delta < 0.0 && -delta > (double)line_ns) )   // NaN & infinities, or out of the clock's range
+		return false;
+	ns = line_ns + (uint64_t)llround(delta);
+	return true;
+}
+uint64_t AcAudio::GetMonotonicNs() {
+	return AmNowNs();
+}
+
+// Profiling
+static void AmReadStats(AmEngineStats& St, AcAudio::EngineStats& out, bool reset) {
+	const auto o = std::memory_order_relaxed;
+	out.Callbacks = St.Callbacks.load(o);			out.Frames = St.Frames.load(o);
+	out.Load = St.Load.load(o);						out.PeakLoad = St.PeakLoad.load(o);
+	out.Underruns = St.Underruns.load(o);			out.LateCallbacks = St.LateCallbacks.load(o);
+	out.PeakVoices = St.PeakVoices.load(o);
+	out.Priority = St.Priority.load(o);				out.Cores = St.Cores.load(o);
+	for(int i = 0; i < AM_STATS_BUCKETS; i++)   // Histogram[i]: load in [i/8, (i+1)/8), the last one is open-ended
+		out.Histogram[i] = St.Histogram[i].load(o);
+
+	if(reset) {   // Counters are fetch_add()ed, so exchanging them here won't lose the audio thread's updates
+		St.Callbacks.exchange(0);	St.Frames.exchange(0);
+		St.Underruns.exchange(0);	St.LateCallbacks.exchange(0);
+		St.PeakLoad.store(0.0f);	St.PeakVoices.store(0);
+		for(int i = 0; i < AM_STATS_BUCKETS; i++)
+			St.Histogram[i].exchange(0);
+	}
+}
+void AcAudio::GetStats(EngineStats& player, EngineStats& preview, int& job_priority, bool reset) {
+	AmReadStats(PlayerStats, player, reset);
+	AmReadStats(PreviewStats, preview, reset);
+	job_priority = JobPriorityApplied.load(std::memory_order_relaxed);
+}
+void AcAudio::GetMemoryStats(MemoryStats& out) {
+	for(uint32_t i = 0; i < AM_MEM_TAGS; i++) {
+		out.Arenas[i].Bytes = (uint64_t)AmArenas[i].Bytes.load(std::memory_order_relaxed);
+		out.Arenas[i].Peak = (uint64_t)AmArenas[i].Peak.load(std::memory_order_relaxed);
+		out.Arenas[i].Allocations = AmArenas[i].Allocations.load(std::memory_order_relaxed);
+	}
+
+	// ADPCM blocks are also counted in the "pcm" arena; file & bank mappings aren't in any (page cache, rather than heap)
+	size_t compact = 0, mapped = 0;
+	std::unordered_set<AmBank*> banks;
+	for(auto R : PlayerResources) {
+		if(R -> Compact)
+			compact += R -> Compact -> Blocks.capacity();
+		if(R -> Mapped)
+			mapped += R -> Size;
+		if( R -> Bank && banks.insert(R -> Bank).second )
+			mapped += R -> Bank -> Size;
+	}
+	out.Compact = compact;
+	out.Mapped = mapped;
+}
+
+// Offline Rendering
+// Each context owns a device-less engine, and renders on its own worker thread.
+struct AmOffline {
+	ma_engine Engine;
+	std::vector<ma_sound*> Units;
+	std::vector<AmADPCMSource*> Compacts;   // Cursors over compact Player resources
+	std::vector<ma_audio_buffer_ref*> Refs;   // Cursors over the PCM or bank entries of the others
+	std::vector<AmPCM*> Held;   // Refs on the PCM read by Refs
+	std::vector<AmResource*> Sources;   // Resources of the units, each one counted in its Units
+	std::vector<float> Output;   // Interleaved f32
+	uint64_t Frames;
+	std::thread Worker;
+	std::atomic<uint64_t> Rendered;
+	std::atomic<bool> Started, Done, Cancelled;
+};
+std::unordered_set<AmOffline*> OfflineContexts;
+
+static void AmOfflineWork(AmOffline* O) {
+	AmLowerThread();
+	constexpr uint64_t chunk = 4096;
+	const auto channels = ma_engine_get_channels(&O -> Engine);
+	uint64_t done = 0;
+	while( (done < O -> Frames) && !O -> Cancelled.load(std::memory_order_relaxed) ) {
+		const auto n = (O -> Frames - done < chunk) ? O -> Frames - done : chunk;
+		ma_engine_read_pcm_frames(&O -> Engine, O -> Output.data() + done * channels, n, nullptr);
+		done += n;
+		O -> Rendered.store(done, std::memory_order_relaxed);
+	}
+	O -> Done.store(true, std::memory_order_release);
+}
+static void AmOfflineSettle(AmOffline* O) {   // Once done or cancelled: frees the sounds & cursors, keeping the output
+	if( O -> Worker.joinable() )
+		O -> Worker.join();
+	for(auto S : O -> Units) {
+		ma_sound_uninit(S);
+		delete S;
+	}
+	for(auto C : O -> Compacts) {
+		AmADPCMUninit(C);
+		delete C;
+	}
+	for(auto B : O -> Refs) {
+		ma_audio_buffer_ref_uninit(B);
+		delete B;
+	}
+	for(auto P : O -> Held)
+		AmPCMRelease(P);
+	for(auto R : O -> Sources)   // Released resources go with their last reader, as with units
+		if( --(R -> Units) == 0 && R -> Released )
+			AmDropResource(R);
+	O -> Units.clear();		O -> Compacts.clear();
+	O -> Refs.clear();		O -> Held.clear();
+	O -> Sources.clear();
+}
+static void AmOfflineDestroy(AmOffline* O) {
+	O -> Cancelled = true;
+	AmOfflineSettle(O);
+	ma_engine_uninit(&O -> Engine);
+	delete O;
+}
+static bool AmOfflineReading() {   // Whether any context may still read compact blocks; finished ones let go of theirs first
+	bool reading = false;
+	for(auto O : OfflineContexts) {
+		if( O -> Done.load(std::memory_order_acquire) )
+			AmOfflineSettle(O);
+		reading = reading || !O -> Compacts.empty();
+	}
+	return reading;
+}
+
+AmOffline* AcAudio::CreateOffline(double ms, const char*& error) {
+	auto engine_config			= ma_engine_config_init();
+		 engine_config.pResourceManager		= PreviewRM;   // Unused, but saves the engine its own job threads
+		 engine_config.allocationCallbacks	= AmAllocator(AM_MEM_SOUND);
+		 engine_config.noDevice				= MA_TRUE;
+		 engine_config.channels				= ma_engine_get_channels(&PlayerEngine);
+		 engine_config.sampleRate			= ma_engine_get_sample_rate(&PlayerEngine);
+
+	const auto O = new AmOffline;
+	if( (ms > 0.0) && ma_engine_init(&engine_config, &O -> Engine) == MA_SUCCESS ) {
+		O -> Frames = (uint64_t)(ms * engine_config.sampleRate / 1000.0);
+		O -> Rendered = 0;
+		O -> Started = false;	O -> Done = false;	O -> Cancelled = false;
+		OfflineContexts.insert(O);
+		return O;
+	}
+	delete O;
+	error = "[!] Failed to Initialize the Offline Context";
+	return nullptr;
+}
+bool AcAudio::OfflineAddUnit(AmOffline* O, AmResource* RH, double ms, float volume) {
+	/*
+	 * Notice:
+	 * The context counts as a unit of the resource, so that releasing the resource meanwhile waits for the context to settle.
+	 */
+	if(O -> Started)
+		return false;
+
+	// A private cursor: over the ADPCM blocks, or over the PCM or the bank entry in place
+	AmADPCMSource* C = nullptr;
+	ma_audio_buffer_ref* B = nullptr;
+	ma_result result;
+	if(RH -> Compact) {
+		C = new AmADPCMSource;
+		result = AmADPCMInit(C, RH -> Compact);
+	}
+	else {
+		B = new ma_audio_buffer_ref;
+		result = RH -> Bank ? AmBankRefInit(RH -> Bank, RH -> Entry, B) : AmPCMRefInit(RH -> PCM, B);
+	}
+	if(result != MA_SUCCESS) {
+		delete C;	delete B;
+		return false;
+	}
+
+	const auto S = new ma_sound;
+	result = ma_sound_init_from_data_source(
+		&O -> Engine, C ? (ma_data_source*)C : (ma_data_source*)B,
+		MA_SOUND_FLAG_NO_PITCH | MA_SOUND_FLAG_NO_SPATIALIZATION,
+		nullptr, S
+	);
+	if(result == MA_SUCCESS) {
+		const auto at = (ms > 0.0) ? (uint64_t)(ms * ma_engine_get_sample_rate(&O -> Engine) / 1000.0) : 0;
+		ma_sound_set_volume(S, volume * RH -> Gain);
+		ma_sound_set_start_time_in_pcm_frames(S, at);
+		ma_sound_start(S);
+		O -> Units.push_back(S);
+		if(C)
+			O -> Compacts.push_back(C);
+		else
+			O -> Refs.push_back(B);
+		if(!C && RH -> PCM)   // Kept across a rebuild's swap
+			O -> Held.push_back( AmPCMRetain(RH -> PCM) );
+		O -> Sources.push_back(RH);   // ReleaseResource then waits for the context, like for a unit
+		RH -> Units++;
+		return true;
+	}
+
+	delete S;
+	if(C) {
+		AmADPCMUninit(C);
+		delete C;
+	}
+	else {
+		ma_audio_buffer_ref_uninit(B);
+		delete B;
+	}
+	return false;
+}
+bool AcAudio::OfflineRender(AmOffline* O) {
+	if(O -> Started)
+		return false;
+	O -> Started = true;
+	O -> Output.resize( (size_t)(O -> Frames * ma_engine_get_channels(&O -> Engine)) );
+	O -> Worker = std::thread(AmOfflineWork, O);
+	return true;
+}
+AcAudio::OfflineStatus AcAudio::OfflinePoll(AmOffline* O) {
+	/* The PCM is handed out once rendered, and the progress in [0, 1] otherwise. */
+	OfflineStatus St = { false, 0.0, nullptr, 0, 0 };
+	St.Done = O -> Done.load(std::memory_order_acquire);
+	St.Progress = (double)O -> Rendered.load(std::memory_order_relaxed) / (double)O -> Frames;
+	if(St.Done) {
+		St.PCM = O -> Output.data();
+		St.Frames = O -> Frames;
+		St.Channels = ma_engine_get_channels(&O -> Engine);
+	}
+	return St;
+}
+void AcAudio::ReleaseOffline(AmOffline* O) {
+	OfflineContexts.erase(O);
+	AmOfflineDestroy(O);   // Cancels & joins an unfinished rendering
+}
+// Analysis Helpers
+struct AmPCMView {
+	const float* Data;   // Interleaved f32, in the Player device format
+	ma_uint64 Frames;
+	ma_uint32 Channels, SampleRate;
+	std::vector<float> Copy;   // Only used for compact resources, whose frames aren't f32
+};
+static bool AmViewPCM(AmResource* R, AmPCMView& V) {
+	if(R -> Compact) {   // Decoded block by block into the copy
+		const auto A = R -> Compact;
+		const auto blocks = (A -> Frames + AM_ADPCM_BLOCK - 1) / AM_ADPCM_BLOCK;
+		V.Channels = A -> Channels;
+		V.SampleRate = A -> SampleRate;
+		V.Copy.resize( (size_t)(blocks * AM_ADPCM_BLOCK * A -> Channels) );
+		AmParallelFor( (size_t)blocks, [A, &V](size_t begin, size_t end) {
+			for(auto b = begin; b < end; b++)
+				AmADPCMDecode( A, b, &V.Copy[b * AM_ADPCM_BLOCK * A -> Channels] );
+		} );
+		V.Data = V.Copy.data();
+		V.Frames = A -> Frames;
+		return true;
+	}
+	if(R -> Bank) {   // Already in place
+		V.Data = (const float*)(R -> Bank -> Data + R -> Entry -> Offset);
+		V.Frames = R -> Entry -> Frames;
+		V.Channels = R -> Entry -> Channels;
+		V.SampleRate = R -> Entry -> SampleRate;
+		return true;
+	}
+	if(!R -> PCM)
+		return false;
+	V.Data = R -> PCM -> Data;
+	V.Frames = R -> PCM -> Frames;
+	V.Channels = R -> PCM -> Channels;
+	V.SampleRate = R -> PCM -> SampleRate;
+	return true;
+}
+
+// Sound Banks
+bool AcAudio::BuildBank(const char* path, const std::vector<BankItem>& items, const char*& error) {
+	/* Writes {name_hash, resource} items into a bank file. */
+	// Gather the PCM of every entry first, so that a bad entry leaves no file behind
+	std::vector<AmBankEntry> entries;
+	std::vector<AmPCMView> views( items.size() );
+	for(size_t i = 0; i < items.size(); i++) {
+		const auto R = items[i].Resource;
+		if( !AmViewPCM(R, views[i]) || !views[i].Frames ) {
+			error = "[!] A resource has no decoded PCM to write";
+			return false;
+		}
+		const auto& V = views[i];
+		entries.push_back( { items[i].NameHash, 0, V.Frames, V.Channels, V.SampleRate, ma_format_f32, R -> Gain } );
+	}
+	if( entries.empty() ) {
+		error = "[!] No entries to write";
+		return false;
+	}
+
+	// Lay out the PCM after the index
+	uint64_t offset = sizeof(AmBankHeader) + entries.size() * sizeof(AmBankEntry);
+	for(auto& E : entries) {
+		offset = (offset + AM_BANK_ALIGN - 1) / AM_BANK_ALIGN * AM_BANK_ALIGN;
+		E.Offset = offset;
+		offset += E.Frames * E.Channels * sizeof(float);
+	}
+
+	const auto F = AmOpenWrite(path);
+	if(!F) {
+		error = "[!] Failed to create the file";
+		return false;
+	}
+	const AmBankHeader H = { AM_BANK_MAGIC, AM_BANK_VERSION, (uint32_t)entries.size(), 0 };
+	const char padding[AM_BANK_ALIGN] = {};
+	bool written = fwrite(&H, sizeof(H), 1, F) == 1 && fwrite(entries.data(), sizeof(AmBankEntry), entries.size(), F) == entries.size();
+	uint64_t at = sizeof(AmBankHeader) + entries.size() * sizeof(AmBankEntry);
+	for(size_t i = 0; written && i < entries.size(); i++) {
+		const auto& E = entries[i];
+		const auto bytes = (size_t)(E.Frames * E.Channels * sizeof(float));
+		written = fwrite(padding, 1, (size_t)(E.Offset - at), F) == E.Offset - at && fwrite(views[i].Data, 1, bytes, F) == bytes;
+		at = E.Offset + bytes;
+	}
+	written = (fclose(F) == 0) && written;
+
+	if(!written)
+		error = "[!] Failed to write the file";
+	return written;
+}
+bool AcAudio::LoadBank(const char* path, std::vector<BankItem>& out, const char*& error) {
+	/* Maps a bank file, and creates one resource per entry, keyed by the hash of its name. */
+	size_t size;
+	uint32_t count;
+	const auto data = AmMapFile(path, size);
+	const auto index = data ? AmBankIndex(data, size, count) : nullptr;
+	if(!index) {
+		if(data)
+			AmUnmapFile(data, size);
+		error = data ? "[!] Not a valid bank file" : "[!] Failed to open the file";
+		return false;
+	}
+
+	// One resource per entry, each one holding a ref on the mapping
+	const auto B = new AmBank{ data, size, count };
+	out.clear();
+	out.reserve(count);
+	for(uint32_t i = 0; i < count; i++) {
+		const auto R = new AmResource;
+		R -> PCM = nullptr;
+		R -> Compact = nullptr;
+		R -> Bank = B;
+		R -> Entry = index + i;
+		R -> Encoded = nullptr;
+		R -> Size = 0;
+		R -> Mapped = false;
+		R -> Arena = nullptr;
+		R -> Gain = index[i].Gain;
+		R -> Measured = false;
+		PlayerResources.insert(R);
+		out.push_back( { index[i].NameHash, R } );
+	}
+	return true;
+}
+
+// Waveform Pyramid
+// Level 0 holds min/max/sum-of-squares of the mono mix over AM_WAVE_BIN frames; each level above halves the bin count.
+constexpr ma_uint32 AM_WAVE_BIN = 64;
+struct AmWaveLevel {
+	std::vector<float> Min, Max, Sq;
+};
+struct AmWaveform {
+	std::vector<AmWaveLevel> Levels;
+	ma_uint64 Frames;
+	ma_uint32 SampleRate;
+};
+std::unordered_set<AmWaveform*> Waveforms;
+
+static void AmWaveBins(const AmPCMView& V, AmWaveLevel& L0, size_t begin, size_t end) {
+	const auto C = V.Channels;
+	const float scale = 1.0f / C;
+	float mono[AM_WAVE_BIN];
+	for(size_t b = begin; b < end; b++) {
+		const auto f0 = (ma_uint64)b * AM_WAVE_BIN;
+		const auto n = (ma_uint32)( (V.Frames - f0 < AM_WAVE_BIN) ? V.Frames - f0 : AM_WAVE_BIN );
+		const auto src = V.Data + f0 * C;
+
+		for(ma_uint32 i = 0; i < n; i++) {
+			float sum = 0.0f;
+			for(ma_uint32 c = 0; c < C; c++)
+				sum += src[i*C + c];
+			mono[i] = sum * scale;
+		}
+		float lo = mono[0], hi = mono[0], sq = 0.0f;
+		for(ma_uint32 i = 0; i < n; i++) {
+			lo = (mono[i] < lo) ? mono[i] : lo;
+			hi = (mono[i] > hi) ? mono[i] : hi;
+			sq += mono[i] * mono[i];
+		}
+		L0.Min[b] = lo;		L0.Max[b] = hi;		L0.Sq[b] = sq;
+	}
+}
+AmWaveform* AcAudio::BuildWaveform(AmResource* R, const char*& error) {
+	AmPCMView V;
+	if( !AmViewPCM(R, V) || !V.Frames ) {
+		error = "[!] The resource has no decoded PCM";
+		return nullptr;
+	}
+
+	const auto W = new AmWaveform;
+	W -> Frames = V.Frames;
+	W -> SampleRate = V.SampleRate;
+
+	// Level 0, from the PCM on all cores
+	size_t bins = (size_t)( (V.Frames + AM_WAVE_BIN - 1) / AM_WAVE_BIN );
+	W -> Levels.emplace_back();
+	auto& L0 = W -> Levels.back();
+	L0.Min.resize(bins);	L0.Max.resize(bins);	L0.Sq.resize(bins);
+	AmParallelFor( bins, [&V, &L0](size_t begin, size_t end) { AmWaveBins(V, L0, begin, end); } );
+
+	// Upper levels, by pairing; these are tiny compared to level 0
+	while(bins > 1) {
+		const auto& lower = W -> Levels.back();
+		AmWaveLevel upper;
+		const size_t half = bins / 2, odd = bins & 1;
+		upper.Min.resize(half + odd);	upper.Max.resize(half + odd);	upper.Sq.resize(half + odd);
+		for(size_t i = 0; i < half; i++) {
+			upper.Min[i] = (lower.Min[2*i] < lower.Min[2*i+1]) ? lower.Min[2*i] : lower.Min[2*i+1];
+			upper.Max[i] = (lower.Max[2*i] > lower.Max[2*i+1]) ? lower.Max[2*i] : lower.Max[2*i+1];
+			upper.Sq[i] = lower.Sq[2*i] + lower.Sq[2*i+1];
+		}
+		if(odd) {
+			upper.Min[half] = lower.Min[bins-1];	upper.Max[half] = lower.Max[bins-1];	upper.Sq[half] = lower.Sq[bins-1];
+		}
+		W -> Levels.push_back( std::move(upper) );
+		bins = half + odd;
+	}
+
+	Waveforms.insert(W);
+	return W;
+}
+bool AcAudio::WaveformRange(AmWaveform* W, double start_ms, double end_ms, int columns, std::vector<float>& min, std::vector<float>& max, std::vector<float>& rms) {
+	/* Fills min, max & rms with "columns" entries each, covering [start_ms, end_ms). */
+	if( columns < 1 || columns > AM_WAVE_COLUMNS_MAX || end_ms <= start_ms )
+		return false;
+
+	// Pick the coarsest level whose bins are still no wider than a column
+	const double f0 = start_ms * W -> SampleRate / 1000.0;
+	const double fpc = (end_ms - start_ms) * W -> SampleRate / 1000.0 / columns;
+	size_t level = 0;
+	while( level + 1 < W -> Levels.size() && (double)(AM_WAVE_BIN << (level + 1)) <= fpc )
+		level++;
+	const auto& LV = W -> Levels[level];
+	const double bin = (double)(AM_WAVE_BIN << level);
+	const auto bins = (int64_t)LV.Min.size();
+
+	min.resize(columns);	max.resize(columns);	rms.resize(columns);
+	for(int c = 0; c < columns; c++) {
+		auto b0 = (int64_t)( (f0 + c * fpc) / bin );
+		auto b1 = (int64_t)ceil( (f0 + (c + 1) * fpc) / bin );
+		b0 = (b0 > 0) ? b0 : 0;
+		b1 = (b1 < bins) ? b1 : bins;
+		b1 = (b1 > b0) ? b1 : b0 + 1;
+
+		float lo = 0.0f, hi = 0.0f, level = 0.0f;
+		if(b0 < bins) {
+			double sq = 0.0;
+			lo = LV.Min[b0];	hi = LV.Max[b0];
+			for(auto b = b0; b < b1; b++) {
+				lo = (LV.Min[b] < lo) ? LV.Min[b] : lo;
+				hi = (LV.Max[b] > hi) ? LV.Max[b] : hi;
+				sq += LV.Sq[b];
+			}
+			const auto covered = (double)( (b1 * bin < W -> Frames) ? b1 * bin : W -> Frames ) - b0 * bin;
+			level = (float)sqrt( sq / ((covered > 1.0) ? covered : 1.0) );
+		}
+		min[c] = lo;	max[c] = hi;	rms[c] = level;
+	}
+	return true;
+}
+void AcAudio::ReleaseWaveform(AmWaveform* W) {
+	Waveforms.erase(W);
+	delete W;
+}
+
+// Rhythm Analysis
+// Onset strength is the spectral flux of log-compressed band magnitudes at ~100 frames/s, with its local mean subtracted.
+// Tempo candidates come from its autocorrelation, and each one gets refined (with a beat phase) by a comb over the whole song.
+constexpr ma_uint32 AM_RHYTHM_BANDS = 48;
+constexpr ma_uint32 AM_RHYTHM_TEMPOS = 4;
+struct AmTempo {
+	double Bpm, Phase;   // Phase in strength frames
+	float Score;
+};
+
+inline float AmStrengthAt(const std::vector<float>& env, double f) {   // Linear interpolation, 0 outside
+	if( f < 0.0 || f >= env.size() - 1 )
+		return 0.0f;
+	const auto i = (size_t)f;
+	const auto t = (float)(f - i);
+	return env[i] + (env[i + 1] - env[i]) * t;
+}
+static void AmCombTempo(const std::vector<float>& env, double bpm, double fps, AmTempo& out) {
+	const double period = fps * 60.0 / bpm;
+	out.Bpm = bpm;		out.Phase = 0.0;	out.Score = 0.0f;
+	for(double phase = 0.0; phase < period; phase += 0.5) {
+		float sum = 0.0f;
+		size_t beats = 0;
+		for(double f = phase; f < env.size(); f += period, beats++)
+			sum += AmStrengthAt(env, f);
+		const auto score = beats ? sum / beats : 0.0f;
+		if(score > out.Score) {
+			out.Score = score;
+			out.Phase = phase;
+		}
+	}
+}
+
+bool AcAudio::AnalyzeRhythm(AmResource* R, Rhythm& out, const char*& error) {
+	/* Fills onsets, tempo candidates, the first-beat offset & the onset strength. */
+	AmPCMView V;
+	if( !AmViewPCM(R, V) ) {
+		error = "[!] The resource has no decoded PCM";
+		return false;
+	}
+
+	// Framing: ~10ms hops, ~21ms windows
+	const auto sr = V.SampleRate, C = V.Channels;
+	const ma_uint32 hop = (sr + 50) / 100;
+	ma_uint32 N = 256;
+	while(N < sr / 46)
+		N *= 2;
+	const size_t F = (V.Frames >= N) ? (size_t)( (V.Frames - N) / hop + 1 ) : 0;
+	const double fps = (double)sr / hop;
+	if( F < (size_t)(fps * 4) ) {   // Tempo needs a few seconds at least
+		error = "[!] The resource is too short to analyze";
+		return false;
+	}
+
+	// Band edges in FFT bins, log-spaced over 30Hz ~ 11kHz
+	std::vector<ma_uint32> edges(AM_RHYTHM_BANDS + 1);
+	const float lo = 30.0f, hi = std::min(11000.0f, sr * 0.5f);
+	for(ma_uint32 b = 0; b <= AM_RHYTHM_BANDS; b++) {
+		edges[b] = std::min( (ma_uint32)( lo * powf(hi / lo, (float)b / AM_RHYTHM_BANDS) * N / sr ), N/2 );
+		if( b > 0 && edges[b] <= edges[b - 1] )
+			edges[b] = edges[b - 1] + 1;
+	}
+
+	// Compressed band magnitudes per frame, on all cores
+	const AmFFT fft(N);
+	std::vector<float> window(N);
+	for(ma_uint32 i = 0; i < N; i++)   // Periodic Hann
+		window[i] = 0.5f - 0.5f * cosf(6.2831853f * i / N);
+	const float norm = 1.0f / ( (N / 4.0f) * (N / 4.0f) );
+	std::vector<float> bands(F * AM_RHYTHM_BANDS);
+	AmParallelFor( F, [&](size_t begin, size_t end) {
+		std::vector<float> mono(N), re(N), im(N), power(N/2 + 1);
+		const float scale = 1.0f / C;
+		for(size_t f = begin; f < end; f++) {
+			const auto src = V.Data + (ma_uint64)f * hop * C;
+			for(ma_uint32 i = 0; i < N; i++) {
+				float sum = 0.0f;
+				for(ma_uint32 c = 0; c < C; c++)
+					sum += src[i*C + c];
+				mono[i] = sum * scale;
+			}
+			fft.Power( mono.data(), window.data(), re.data(), im.data(), power.data() );
+			for(ma_uint32 b = 0; b < AM_RHYTHM_BANDS; b++) {
+				float e = 0.0f;
+				for(auto k = edges[b]; k < edges[b + 1] && k <= N/2; k++)
+					e += power[k];
+				bands[f * AM_RHYTHM_BANDS + b] = logf( 1.0f + 100.0f * sqrtf(e * norm) );
+			}
+		}
+	} );
+
+	// Spectral flux, minus its local mean over ~0.5s, normalized to [0, 1]
+	std::vector<float> flux(F, 0.0f), env(F);
+	for(size_t f = 1; f < F; f++) {
+		const auto cur = &bands[f * AM_RHYTHM_BANDS], prev = cur - AM_RHYTHM_BANDS;
+		float sum = 0.0f;
+		for(ma_uint32 b = 0; b < AM_RHYTHM_BANDS; b++)
+			sum += std::max(cur[b] - prev[b], 0.0f);
+		flux[f] = sum;
+	}
+	std::vector<double> prefix(F + 1, 0.0);
+	for(size_t f = 0; f < F; f++)
+		prefix[f + 1] = prefix[f] + flux[f];
+	const size_t radius = (size_t)(fps * 0.25);
+	float peak = 0.0f;
+	for(size_t f = 0; f < F; f++) {
+		const auto a = (f > radius) ? f - radius : 0, b = std::min(f + radius + 1, F);
+		env[f] = std::max( flux[f] - (float)( (prefix[b] - prefix[a]) / (b - a) ), 0.0f );
+		peak = std::max(peak, env[f]);
+	}
+	if(peak > 0.0f)
+		for(auto& e : env)
+			e /= peak;
+	const auto FrameMs = [&](double f) { return (f * hop + N * 3 / 4) * 1000.0 / sr; };   // Log flux peaks as an attack crosses into the window's later half
+
+	// Onsets: local maxima over ±30ms, above an adaptive threshold, at least 30ms apart
+	std::vector<double> onsets;
+	prefix[0] = 0.0;
+	for(size_t f = 0; f < F; f++)
+		prefix[f + 1] = prefix[f] + env[f];
+	size_t last = 0;
+	for(size_t f = 3; f + 3 < F; f++) {
+		bool top = true;
+		for(size_t g = f - 3; g <= f + 3 && top; g++)
+			top = (env[g] <= env[f]);
+		const auto a = (f > radius) ? f - radius : 0, b = std::min(f + radius + 1, F);
+		const auto threshold = 1.5 * (prefix[b] - prefix[a]) / (b - a) + 0.03;
+		if( top && env[f] > threshold && (onsets.empty() || f - last >= 3) ) {
+			onsets.push_back( FrameMs(f) );
+			last = f;
+		}
+	}
+
+	// Tempo candidates over 50 ~ 240 BPM, weighted towards ~120 BPM to settle octave errors
+	const auto lag_min = (size_t)(fps * 60.0 / 240.0), lag_max = (size_t)(fps * 60.0 / 50.0) + 1;
+	std::vector<float> ac(lag_max + 2, 0.0f);
+	AmParallelFor( lag_max + 2 - lag_min, [&](size_t begin, size_t end) {
+		for(auto l = begin + lag_min; l < end + lag_min; l++) {
+			float sum = 0.0f;
+			for(size_t f = 0; f + l < F; f++)
+				sum += env[f] * env[f + l];
+			const auto bpm = fps * 60.0 / l, octaves = log2(bpm / 120.0);
+			ac[l] = sum / (F - l) * (float)exp(-0.5 * octaves * octaves);
+		}
+	} );
+	std::vector<AmTempo> tempos;
+	for(auto l = lag_min + 1; l <= lag_max; l++)
+		if( ac[l] > ac[l - 1] && ac[l] >= ac[l + 1] ) {
+			const double d = ac[l - 1] - 2.0 * ac[l] + ac[l + 1];   // Parabolic interpolation of the peak lag
+			const double lag = l + ( (d < 0.0) ? 0.5 * (ac[l - 1] - ac[l + 1]) / d : 0.0 );
+			tempos.push_back( AmTempo{fps * 60.0 / lag, 0.0, ac[l]} );
+		}
+	std::sort( tempos.begin(), tempos.end(), [](const AmTempo& a, const AmTempo& b) { return a.Score > b.Score; } );
+	if(tempos.size() > AM_RHYTHM_TEMPOS)
+		tempos.resize(AM_RHYTHM_TEMPOS);
+
+	// Refinement: ±1% at 0.01 BPM steps, on all cores
+	float mean = 0.0f;
+	for(auto e : env)
+		mean += e;
+	mean = std::max(mean / F, 1e-6f);
+	for(auto& T : tempos) {
+		const auto start = T.Bpm * 0.99;
+		const auto steps = (size_t)(T.Bpm * 0.02 / 0.01) + 1;
+		std::vector<AmTempo> trials(steps);
+		AmParallelFor( steps, [&](size_t begin, size_t end) {
+			for(auto i = begin; i < end; i++)
+				AmCombTempo(env, start + i * 0.01, fps, trials[i]);
+		} );
+		T = trials[0];   // T.Score is an autocorrelation, not comparable to comb scores
+		for(auto& t : trials)
+			if(t.Score > T.Score)
+				T = t;
+		const auto octaves = log2(T.Bpm / 120.0);
+		T.Score *= (float)exp(-0.5 * octaves * octaves) / mean;   // Confidence: beat strength over the average, with the same prior
+	}
+	std::sort( tempos.begin(), tempos.end(), [](const AmTempo& a, const AmTempo& b) { return a.Score > b.Score; } );
+
+	// First-beat offset: the earliest beat of the best tempo's grid
+	double offset_ms = 0.0;
+	if( !tempos.empty() ) {
+		const auto beat_ms = 60000.0 / tempos[0].Bpm;
+		offset_ms = fmod( FrameMs(tempos[0].Phase), beat_ms );
+	}
+
+	// Do Returns
+	out.Onsets = std::move(onsets);
+	out.Bpms.resize( tempos.size() );
+	out.Confidences.resize( tempos.size() );
+	for(size_t i = 0; i < tempos.size(); i++) {
+		out.Bpms[i] = tempos[i].Bpm;
+		out.Confidences[i] = tempos[i].Score;
+	}
+	out.OffsetMs = offset_ms;
+	out.Strength = std::move(env);
+	out.StrengthRate = fps;
+	return true;
+}
+
+// Spectrum Analyzer
+// PlayerBus mixes the target unit alone once more, and copies its mono mix into a sample ring, dropping samples rather than blocking.
+// The worker thread runs the FFT over 2048-frame Hann windows (1024 hop), and publishes smoothed band energies in dB under a seqlock.
+static void AmAnalyzerWork(AmAnalyzer* A) {
+	const auto N = AM_FFT_SIZE, hop = N / 2;
+	const AmFFT fft(N);
+	std::vector<float> window(N), frame(N), re(N), im(N), power(N/2 + 1);
+	for(ma_uint32 i = 0; i < N; i++)   // Periodic Hann
+		window[i] = 0.5f - 0.5f * cosf(6.2831853f * i / N);
+
+	// Log-spaced band edges in FFT bins, each band at least one bin wide
+	const auto B = A -> Bands;
+	const float lo = 40.0f, hi = std::min(16000.0f, A -> SampleRate * 0.5f);
+	std::vector<ma_uint32> edges(B + 1);
+	for(ma_uint32 b = 0; b <= B; b++) {
+		const auto hz = lo * powf(hi / lo, (float)b / B);
+		edges[b] = std::min( (ma_uint32)(hz * N / A -> SampleRate), N/2 );
+		if( b > 0 && edges[b] <= edges[b - 1] )
+			edges[b] = std::min(edges[b - 1] + 1, N/2 + 1);
+	}
+	std::vector<float> levels(B, -100.0f);
+	const float norm = 1.0f / ( (N / 4.0f) * (N / 4.0f) );   // A full-scale sine peaks at N/4 under the Hann window
+
+	auto& T = PlayerTap;
+	ma_uint32 filled = 0;
+	while( A -> Running.load(std::memory_order_acquire) ) {
+		auto tail = T.Tail.load(std::memory_order_relaxed);
+		const auto head = T.Head.load(std::memory_order_acquire);
+		if(head == tail) {
+			std::this_thread::sleep_for( std::chrono::milliseconds(4) );
+			continue;
+		}
+
+		while(tail != head) {
+			const auto n = std::min(head - tail, N - filled);
+			for(ma_uint32 i = 0; i < n; i++)
+				frame[filled + i] = T.Ring[ (tail + i) & (AM_TAP_CAPACITY - 1) ];
+			tail += n;
+			filled += n;
+			T.Tail.store(tail, std::memory_order_release);
+			if(filled < N)
+				break;
+
+			// A full window: analyze it, and slide by a hop
+			fft.Power( frame.data(), window.data(), re.data(), im.data(), power.data() );
+			for(ma_uint32 b = 0; b < B; b++) {
+				float e = 0.0f;
+				for(auto k = edges[b]; k < edges[b + 1] && k <= N/2; k++)
+					e += power[k];
+				const auto db = std::max( 10.0f * log10f(e * norm + 1e-10f), -100.0f );
+				levels[b] += (db - levels[b]) * ( db > levels[b] ? 0.6f : 0.2f );   // Fast attack, slow release
+			}
+			std::copy(frame.begin() + hop, frame.end(), frame.begin());
+			filled -= hop;
+
+			A -> Seq.fetch_add(1, std::memory_order_acq_rel);
+			for(ma_uint32 b = 0; b < B; b++)
+				A -> Levels[b].store(levels[b], std::memory_order_relaxed);
+			A -> Seq.fetch_add(1, std::memory_order_release);
+		}
+	}
+}
+
+static bool AmAnalyzerStart(AmUnit* U, ma_uint32 bands) {
+	const auto A = new AmAnalyzer;
+	A -> Target = U;		A -> Bands = bands;
+	A -> SampleRate = PlayerBus.SampleRate;
+	A -> Seq = 0;
+	for(auto& level : A -> Levels)
+		level.store(-100.0f, std::memory_order_relaxed);
+
+	// Skip whatever an earlier target left in the ring, then let the bus feed it
+	PlayerTap.Tail.store( PlayerTap.Head.load(std::memory_order_acquire), std::memory_order_release );
+	TapTarget.store(U, std::memory_order_release);
+
+	A -> Running = true;
+	A -> Worker = std::thread(AmAnalyzerWork, A);
+	Analyzer = A;
+	return true;
+}
+static void AmAnalyzerStop() {
+	const auto A = Analyzer;
+	if(!A)
+		return;
+	Analyzer = nullptr;
+	TapTarget.store(nullptr, std::memory_order_release);
+	A -> Running = false;
+	A -> Worker.join();
+	delete A;
+}
+
+bool AcAudio::EnableAnalyzer(AmUnit* U, uint32_t bands) {
+	if( bands < 1 || bands > AM_BANDS_MAX )
+		return false;
+	AmAnalyzerStop();
+	return AmAnalyzerStart(U, bands);
+}
+void AcAudio::DisableAnalyzer() {
+	AmAnalyzerStop();
+}
+uint32_t AcAudio::GetSpectrum(float* levels) {
+	const auto A = Analyzer;
+	if(!A)
+		return 0;
+
+	// Retry while the worker is mid-write; it only holds the seqlock for a few dozen stores
+	const auto B = A -> Bands;
+	uint32_t seq;
+	do {
+		while( (seq = A -> Seq.load(std::memory_order_acquire)) & 1 )
+			std::this_thread::yield();
+		for(ma_uint32 b = 0; b < B; b++)
+			levels[b] = A -> Levels[b].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	} while( seq != A -> Seq.load(std::memory_order_relaxed) );
+	return B;
+}
+
+// Device Format Following
+static ma_result AmInitPlayerEngine(ma_uint32 channels, ma_uint32 rate) {
+	/* The engine plays PlayerSound only: PlayerSound <- PlayerStretch <- PlayerBus <- voiced units. */
+	auto engine_config			= ma_engine_config_init();
+		 engine_config.pResourceManager		= PreviewRM;   // Unused, since the bus mixes units itself
+		 engine_config.allocationCallbacks	= AmAllocator(AM_MEM_SOUND);
+		 engine_config.channels				= channels;
+		 engine_config.sampleRate			= rate;
+		 engine_config.dataCallback			= AmDataCallback;
+		 engine_config.notificationCallback	= AmNotificationCallback;
+	auto result = ma_engine_init(&engine_config, &PlayerEngine);
+	if(result != MA_SUCCESS)
+		return result;
+
+	// The bus keeps its units & time; the block cache fits old compact blocks too, which stay if re-encoding fails,
+	// and those of released resources that units still play, which aren't re-encoded at all
+	ma_uint32 widest = channels;
+	for(auto R : PlayerResources)
+		if(R -> Compact)
+			widest = std::max(widest, R -> Compact -> Channels);
+	for(auto U : PlayerUnits)
+		if(U -> Resource -> Compact)
+			widest = std::max(widest, U -> Resource -> Compact -> Channels);
+	auto bus_config = ma_data_source_config_init();
+		 bus_config.vtable = &AmBusVTable;
+	ma_data_source_init(&bus_config, &PlayerBus.Base);
+	PlayerBus.Channels = channels;
+	PlayerBus.SampleRate = rate;
+	PlayerBus.Blocks = AmMemFloats(AM_BUS_BLOCKS * AM_ADPCM_BLOCK * widest, AM_MEM_SOUND);
+	PlayerBus.Widest = widest;
+	memset( PlayerBus.Cached, 0, sizeof(PlayerBus.Cached) );
+	PlayerBus.Solo = AmMemFloats(AM_BUS_CHUNK * channels, AM_MEM_SOUND);
+
+	result = AmStretchInit(&PlayerStretch, &PlayerBus, &PlayerRate);
+	if(result != MA_SUCCESS)
+		return result;
+	if( PlayerRate.load() != 1.0f )   // Before the sound is started, which publishes the buffers to the audio thread
+		AmStretchPrepare(&PlayerStretch);
+	result = ma_sound_init_from_data_source(
+		&PlayerEngine, &PlayerStretch,
+		MA_SOUND_FLAG_NO_PITCH | MA_SOUND_FLAG_NO_SPATIALIZATION,
+		nullptr, &PlayerSound
+	);
+	if(result != MA_SUCCESS)
+		return result;
+	return ma_sound_start(&PlayerSound);
+}
+static void AmUninitPlayerEngine() {   // Once the device is stopped, or before the engine is
+	ma_sound_uninit(&PlayerSound);
+	AmStretchUninit(&PlayerStretch);
+	ma_data_source_uninit(&PlayerBus.Base);
+	AmMemFree(PlayerBus.Blocks, (void*)AM_MEM_SOUND);	AmMemFree(PlayerBus.Solo, (void*)AM_MEM_SOUND);
+	PlayerBus.Blocks = PlayerBus.Solo = nullptr;
+	ma_engine_uninit(&PlayerEngine);
+}
+
+static void AmRebuildWork(AmRebuild* B) {
+	AmLowerThread();
+	// Slots are split among up to JobThreads threads; a cancellation skips whatever is left
+	AmParallelFor( B -> Slots.size(), [B](size_t begin, size_t end) {
+		for(auto i = begin; i < end && !B -> Cancelled.load(std::memory_order_relaxed); i++) {
+			auto& S = B -> Slots[i];
+			S.PCM = AmDecodePCM(S.Encoded, S.Size, B -> Channels, B -> SampleRate);
+			if(S.PCM && S.Compact) {   // Re-encoded in the new format; the old blocks stay if that fails
+				ma_audio_buffer_ref cursor;
+				if( AmPCMRefInit(S.PCM, &cursor) == MA_SUCCESS ) {
+					S.Blocks = AmADPCMEncode(&cursor);
+					ma_audio_buffer_ref_uninit(&cursor);
+				}
+				AmPCMRelease(S.PCM);
+				S.PCM = nullptr;
+			}
+		}
+	}, JobThreads );
+	B -> Done.store(true, std::memory_order_release);
+}
+static AmRebuild* AmJoinRebuild() {   // Takes PlayerRebuild over once its worker is gone
+	const auto B = PlayerRebuild;
+	PlayerRebuild = nullptr;
+	if( B -> Worker.joinable() )
+		B -> Worker.join();
+	for(auto R : B -> Released)
+		AmDestroyResource(R);
+	return B;
+}
+static void AmCancelRebuild() {
+	if(!PlayerRebuild)
+		return;
+	PlayerRebuild -> Cancelled = true;
+	const auto B = AmJoinRebuild();
+	for(auto& S : B -> Slots) {
+		AmPCMRelease(S.PCM);
+		AmADPCMFree(S.Blocks);
+	}
+	delete B;
+}
+static void AmStartRebuild(ma_uint32 channels, ma_uint32 rate) {
+	const auto B = PlayerRebuild = new AmRebuild;
+	B -> Channels = channels;
+	B -> SampleRate = rate;
+	B -> Done = false;
+	B -> Cancelled = false;
+
+	// Snapshot the encoded bytes; resources created after this point get decoded in AmFinishRebuild()
+	B -> Slots.reserve( PlayerResources.size() );
+	for(auto R : PlayerResources) {
+		if(R -> Bank)   // Played in place; the engine resamples bank entries itself
+			continue;
+		B -> Index[R] = B -> Slots.size();
+		B -> Slots.push_back( { R, R -> Encoded, R -> Size, R -> Compact != nullptr, nullptr, nullptr } );
+	}
+	B -> Worker = std::thread(AmRebuildWork, B);
+}
+static bool AmRebuildReady() {
+	return PlayerRebuild -> Done.load(std::memory_order_acquire);
+}
+static bool AmFinishRebuild() {   // False if the Player engine failed to re-init
+	const auto B = AmJoinRebuild();
+
+	// Quiesce the audio thread; units stay voiced, and only get their positions rescaled
+	AmUnit* tapped = Analyzer ? Analyzer -> Target : nullptr;
+	const ma_uint32 bands = Analyzer ? Analyzer -> Bands : 0;
+	AmAnalyzerStop();   // Its bands were laid out for the old rate
+	ma_engine_stop(&PlayerEngine);
+	AmApplyCommands();
+
+	std::vector<ma_uint32> rates;
+	rates.reserve( PlayerUnits.size() );
+	for(auto U : PlayerUnits)
+		rates.push_back( AmResourceRate(U -> Resource) );
+	const double ratio = (double)B -> SampleRate / (double)PlayerBus.SampleRate;
+
+	// Swap the engine & the resources; a failed decoding keeps the old PCM, which the bus then resamples
+	AmUninitPlayerEngine();
+	for(auto& S : B -> Slots) {
+		if(!S.R) {   // Released meanwhile
+			AmPCMRelease(S.PCM);
+			AmADPCMFree(S.Blocks);
+			continue;
+		}
+		if(S.PCM) {
+			AmPCMRelease(S.R -> PCM);
+			S.R -> PCM = S.PCM;
+		}
+		if(S.Blocks) {
+			AmADPCMFree(S.R -> Compact);
+			S.R -> Compact = S.Blocks;
+		}
+	}
+	for(auto R : PlayerResources) {   // Created after the rebuild started
+		if( R -> Bank || B -> Index.count(R) )
+			continue;
+		const auto P = AmDecodePCM(R -> Encoded, R -> Size, B -> Channels, B -> SampleRate);
+		if(P && R -> Compact) {
+			ma_audio_buffer_ref cursor;
+			if( AmPCMRefInit(P, &cursor) == MA_SUCCESS ) {
+				const auto A = AmADPCMEncode(&cursor);
+				if(A) {
+					AmADPCMFree(R -> Compact);
+					R -> Compact = A;
+				}
+				ma_audio_buffer_ref_uninit(&cursor);
+			}
+			AmPCMRelease(P);
+		}
+		else if(P) {
+			AmPCMRelease(R -> PCM);
+			R -> PCM = P;
+		}
+	}
+
+	AmReclaimUnits();   // Only now, as it may destroy released resources still in the slots above
+
+	// Rescale the positions to the new rates of their resources, and the schedule to the new bus rate
+	size_t i = 0;
+	for(auto U : PlayerUnits) {
+		U -> Position = (ma_uint64)( (double)U -> Position.load() * AmResourceRate(U -> Resource) / rates[i++] );
+		U -> Start = (ma_uint64)(U -> Start * ratio);
+	}
+	PlayerBus.Time = (ma_uint64)(PlayerBus.Time.load() * ratio);
+	AmClockReset(PlayerClock);   // Fitted at the old rate
+	const bool ok = AmInitPlayerEngine(B -> Channels, B -> SampleRate) == MA_SUCCESS;
+	delete B;
+
+	if(tapped)
+		AmAnalyzerStart(tapped, bands);
+	return ok;
+}
+
+
+// Lifecycle
+uint32_t AmGeneration;   // Bumped by Init & Final, so that handles never outlive the engines they were made with
+
+uint32_t AcAudio::Generation() {
+	return AmGeneration;
+}
+bool AcAudio::Init(const Config& config, const char*& error) {
+	AmGeneration++;
+
+	// Job Threads: 0 means one per core, but the calling thread's
+	const auto cores = std::max(1u, std::thread::hardware_concurrency());
+	JobThreads = (config.JobThreads > 0) ? config.JobThreads : std::max(1u, cores - 1);
+	JobThreads = std::min(JobThreads, (ma_uint32)MA_RESOURCE_MANAGER_MAX_JOB_THREAD_COUNT);
+	PreviewJobThreads = std::max(1u, std::min(config.PreviewJobThreads, (ma_uint32)MA_RESOURCE_MANAGER_MAX_JOB_THREAD_COUNT));
+	JobQueueCapacity = std::max(16u, config.JobQueueCapacity);
+
+	// Thread Scheduling
+	AudioPriority = std::max<int>( AM_PRIORITY_DEFAULT, std::min<int>(AM_PRIORITY_REALTIME, config.AudioPriority) );
+	JobPriority = std::max<int>( AM_PRIORITY_LOW, std::min<int>(AM_PRIORITY_DEFAULT, config.JobPriority) );
+	if(config.AudioBigCores)
+		AmFindBigCores();
+
+	// Init PreviewRM, owned here so that its job threads are configurable; streams decode at their native format, and the sound converts
+	auto preview_rm_config		= ma_resource_manager_config_init();
+		 preview_rm_config.decodedFormat		= ma_format_f32;
+		 preview_rm_config.pVFS					= &AmMemoryVFS;   // Streams open files through the VFS, never through registered data
+		 preview_rm_config.allocationCallbacks	= AmAllocator(AM_MEM_STREAM);
+		 preview_rm_config.jobThreadCount		= 0;   // Blocking queue, served by PreviewJobWorkers
+		 preview_rm_config.jobQueueCapacity		= JobQueueCapacity;
+		 preview_rm_config.ppCustomDecodingBackendVTables	= AmDecoders;
+		 preview_rm_config.customDecodingBackendCount		= AM_DECODERS;
+	PreviewRM = new ma_resource_manager;
+	if( ma_resource_manager_init(&preview_rm_config, PreviewRM) != MA_SUCCESS ) {
+		error = "Failed to Init the miniaudio Resource Manager \"PreviewRM\".";
+		return false;
+	}
+
+	// Init the Preview Engine, with Default Behaviors except the profiled callback
+	auto preview_config			= ma_engine_config_init();
+		 preview_config.pResourceManager	= PreviewRM;
+		 preview_config.allocationCallbacks	= AmAllocator(AM_MEM_SOUND);
+		 preview_config.dataCallback		= AmDataCallback;
+	if( ma_engine_init(&preview_config, &PreviewEngine) != MA_SUCCESS ) {
+		error = "Failed to Init the miniaudio Engine \"Preview\".";
+		return false;
+	}
+
+	// Init the Player Engine: a custom engine config, in the default device format
+	const auto device = ma_engine_get_device(&PreviewEngine);   // The default device info
+	if( AmInitPlayerEngine(device -> playback.channels, device -> sampleRate) != MA_SUCCESS ) {
+		error = "Failed to Init the miniaudio Engine \"Player\".";
+		return false;
+	}
+
+	// PreviewRM's job threads, last so that a failed Init leaves none running
+	for(ma_uint32 i = 0; i < PreviewJobThreads; i++)
+		PreviewJobWorkers.emplace_back(AmPreviewJobWork);
+	return true;
+}
+
+void AcAudio::Resume() {   // PreviewSound won't be nullptr when playing
+	if( (PreviewPlaying) && !ma_sound_is_playing(PreviewSound) )
+		ma_sound_start(PreviewSound);
+	for(auto U : PlayerUnits)
+		if( (U -> Playing) && !U -> Voiced.load() )
+			AmEnqueue(U, AM_CMD_PLAY, U -> Looping.load(), 0);
+}
+void AcAudio::Suspend() {   // Sounds won't rewind when "stopping"
+	if(PreviewPlaying) {
+		if( ma_sound_is_playing(PreviewSound) )
+			ma_sound_stop(PreviewSound);
+		else
+			PreviewPlaying = false;
+	}
+	for(auto U : PlayerUnits)
+		if(U -> Playing) {
+			if( U -> Voiced.load() )
+				AmEnqueue(U, AM_CMD_STOP, false, 0);
+			else
+				U -> Playing = false;
+		}
+}
+
+bool AcAudio::Update() {
+	// Follow the native format after a reroute; the sample format is left alone since only resampling is costly
+	if( PlayerRerouted.exchange(false, std::memory_order_acquire) ) {
+		const auto device = ma_engine_get_device(&PlayerEngine);
+		const auto channels = device -> playback.internalChannels;
+		const auto rate = device -> playback.internalSampleRate;
+
+		const bool changed = (rate != ma_engine_get_sample_rate(&PlayerEngine)) || (channels != ma_engine_get_channels(&PlayerEngine));
+		const bool pending = PlayerRebuild && (PlayerRebuild -> SampleRate == rate) && (PlayerRebuild -> Channels == channels);
+		if(!pending) {
+			AmCancelRebuild();
+			if(changed)
+				AmStartRebuild(channels, rate);
+		}
+	}
+
+	// Units retired since the last call, & the released resources they held
+	AmReclaimUnits();
+
+	// Offline contexts may read compact blocks that the swap replaces, so it waits for those still rendering or yet to render
+	if( PlayerRebuild && AmRebuildReady() && !AmOfflineReading() )
+		return AmFinishRebuild();
+	return true;
+}
+
+void AcAudio::Final() {
+	AmGeneration++;
+
+	// Stop the Player device, so that this thread can flush the command queue itself
+	AmCancelRebuild();
+	AmAnalyzerStop();
+	ma_engine_stop(&PlayerEngine);
+	AmApplyCommands();
+	AmReclaimUnits();
+
+	// Offline contexts hold copies of Player resources
+	for(auto O : OfflineContexts)
+		AmOfflineDestroy(O);
+	OfflineContexts.clear();
+	for(auto W : Waveforms)
+		delete W;
+	Waveforms.clear();
+
+	// Close the Preview sound & resource
+	StopPreview();
+
+	// Free Player units, then resources, including released ones that were waiting for their units;
+	// a later Init() starts from an empty bus, as after the first one
+	for(auto U : PlayerUnits) {
+		AmUnvoice(U);
+		const auto R = U -> Resource;
+		delete U;
+		if( --(R -> Units) == 0 && R -> Released )
+			AmDestroyResource(R);
+	}
+	PlayerUnits.clear();
+	for(auto R : PlayerResources)
+		AmDestroyResource(R);
+	PlayerResources.clear();
+	EndChart();
+	PlayerBus.Head = nullptr;
+	PlayerBus.Time = 0;
+	AmClockReset(PlayerClock);
+	PlayerClock.EngineFrames = 0;
+	PlayerClock.CallbackNs = 0;
+
+	// Uninit (miniaudio)Engines, and then the resource manager, which isn't owned by the engines.
+	ma_engine_uninit(&PreviewEngine);
+	AmUninitPlayerEngine();
+	ma_resource_manager_post_job_quit(PreviewRM);
+	for(auto& W : PreviewJobWorkers)
+		W.join();
+	PreviewJobWorkers.clear();
+	ma_resource_manager_uninit(PreviewRM);
+	delete PreviewRM;
+	PreviewRM = nullptr;
+}
@@ -0,0 +1,175 @@
+/* Aerials Audio Core */
+#pragma once
+
+// Engines, resources, units, preview & analysis, free of dmsdk & Lua: src/ext.cpp binds this to Lua,
+// and the same calls can be driven natively (e.g. on x86_64-linux, with the null backend) for tests & profiling.
+// All of it is meant to be called from one thread, which the comments in core.cpp call the "Lua thread".
+
+/* Includes */
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+
+/* Handles */
+// Opaque, and trusted: calls take live handles only, i.e. created & not released yet, under the current Generation().
+// The Lua glue keeps them so through typed userdata, so that no call pays for a lookup.
+struct AmResource;
+struct AmUnit;
+struct AmOffline;
+struct AmWaveform;
+
+
+/* Constants */
+constexpr int AM_STATS_BUCKETS = 16;   // Each bucket covers 1/8 of the period budget; the last one is open-ended
+constexpr uint32_t AM_BANDS_MAX = 128;   // Spectrum analyzer bands
+constexpr int AM_WAVE_COLUMNS_MAX = 65536;   // Per WaveformRange call
+
+enum AmMemoryTag : uint32_t {
+	AM_MEM_PCM,   // Decoded Player resources, ADPCM blocks included
+	AM_MEM_STREAM,   // PreviewRM: stream pages & their decoders
+	AM_MEM_SOUND,   // Engines: node graphs, sounds & converters; also the buffers of our sources & the bus
+	AM_MEM_DECODER,   // Standalone decoders, e.g. for preview metering
+	AM_MEM_ENCODED,   // Encoded copies of resources
+	AM_MEM_TAGS
+};
+extern const char* const AmMemoryTagNames[AM_MEM_TAGS];
+
+enum AmPriority : int { AM_PRIORITY_LOW = -1, AM_PRIORITY_DEFAULT = 0, AM_PRIORITY_HIGH = 1, AM_PRIORITY_REALTIME = 2 };
+
+
+namespace AcAudio {
+
+/* Lifecycle */
+struct Config {
+	uint32_t JobThreads = 0;   // Decoding threads of the Player; 0 means one per core, but the calling thread's
+	uint32_t PreviewJobThreads = 1;   // Streaming threads of the Preview, raised like the device threads (up to High)
+	uint32_t JobQueueCapacity = 1024;   // Job queue of the Preview streams
+	int AudioPriority = AM_PRIORITY_REALTIME;   // Device threads, see AmPriority
+	int JobPriority = AM_PRIORITY_LOW;   // Decoding & rendering workers
+	bool AudioBigCores = true;   // Pins the device threads to the performance cores of big.LITTLE SoCs
+};
+bool Init(const Config& config, const char*& error);   // Starts both engines on the default device
+bool Update();   // Once per frame: follows device reroutes & frees retired units; false if the Player engine failed to re-init
+void Suspend();   // Pauses the preview & the playing units, e.g. when the app goes to the background
+void Resume();
+void Final();
+uint32_t Generation();   // Bumped by Init & Final
+
+/* Preview */
+// The Preview streams one song at a time, decoded on its own job threads. PlayPreview reads data in place: it must stay alive
+// until the next StopPreview, PlayPreview(FromFile) or Final if it returned true (ext.cpp pins the Lua buffer for that long).
+bool PlayPreview(const void* data, size_t size, bool looping, bool normalize, double target_lufs);
+bool PlayPreviewFromFile(const char* path, bool looping, bool normalize, double target_lufs);   // "am://" paths are refused
+void StopPreview();
+float SetPreviewRate(float rate);   // Returns the applied rate
+
+/* Resources */
+struct Bytes {
+	const void* Data;
+	size_t Size;
+};
+AmResource* CreateResource(const void* data, size_t size, bool normalize, double target_lufs, bool compact, const char*& error);   // Copies data
+AmResource* CreateResourceFromFile(const char* path, bool normalize, double target_lufs, bool compact, const char*& error);
+bool CreateResources(const std::vector<Bytes>& bufs, bool normalize, double target_lufs, bool compact, std::vector<AmResource*>& out, const char*& error);   // nullptr for failed entries
+void ReleaseResource(AmResource* R);   // Deferred until its units are gone
+bool GetLoudness(AmResource* R, float& lufs, float& true_peak_db, float& gain_db);   // false unless measured
+void BeginChart();
+void EndChart();
+
+/* Sound Banks */
+struct BankItem {
+	uint64_t NameHash;
+	AmResource* Resource;
+};
+bool BuildBank(const char* path, const std::vector<BankItem>& items, const char*& error);
+bool LoadBank(const char* path, std::vector<BankItem>& out, const char*& error);
+
+/* Units */
+AmUnit* CreateUnit(AmResource* R, double& length_ms);
+bool ReleaseUnit(AmUnit* U);   // false if the command queue is full
+bool PlayUnit(AmUnit* U, bool looping, double delay_ms);   // Gameplay calls: no allocations & no locks
+bool StopUnit(AmUnit* U, bool rewind);
+bool CheckPlaying(AmUnit* U);
+double GetTime(AmUnit* U);
+uint64_t GetTimeFrames(AmUnit* U);   // In the resource's frames
+bool SetTime(AmUnit* U, double ms);
+bool SetTimeFrames(AmUnit* U, uint64_t frames);
+float SetPlaybackRate(float rate);   // Returns the applied rate
+
+/* Player Clock */
+// Everything of a Snapshot comes from the end of one Player callback, but NowNs & the device format.
+// Monotonic times are std::chrono::steady_clock nanoseconds.
+struct Snapshot {
+	uint64_t EngineFrames;   // Output frames played so far, see GetEngineFrames()
+	uint64_t ChartFrames;   // Mixed so far, in the chart time, at SampleRate
+	uint64_t UnitFrames;   // The unit's position in its resource's frames; 0 without a unit
+	uint64_t CallbackNs;   // Monotonic start of that callback
+	uint64_t NowNs;   // Monotonic time of the snapshot
+	uint32_t LatencyFrames;   // Device buffering between a callback & the speaker, at SampleRate
+	uint32_t SampleRate;
+	double ClockRate;   // Engine frames per monotonic second, as measured; drifts off SampleRate by the device clock's error. 0 if unknown yet
+};
+uint64_t GetEngineFrames();   // Frames handed to the Player device so far, as of its last callback
+Snapshot TakeSnapshot(AmUnit* U);   // U may be nullptr
+
+// Engine frames <-> monotonic time, along a line fitted to the callbacks of the last ~10s; both are O(1) & lock-free.
+// Frames are counted when handed to the device; add LatencyFrames for when they get heard.
+// Both fail until 2 callbacks are fitted, i.e. right after Init & after a reroute; MonotonicAt also fails out of range.
+bool AudioTimeAt(uint64_t monotonic_ns, double& engine_frames);   // Fractional
+bool MonotonicAt(double engine_frames, uint64_t& monotonic_ns);
+uint64_t GetMonotonicNs();
+
+/* Profiling */
+struct EngineStats {
+	uint64_t Callbacks, Frames;
+	float Load, PeakLoad;
+	uint32_t Underruns, LateCallbacks, PeakVoices;
+	int Priority;   // Applied to the device thread
+	uint32_t Cores;
+	uint32_t Histogram[AM_STATS_BUCKETS];
+};
+struct ArenaStats {
+	uint64_t Bytes, Peak, Allocations;
+};
+struct MemoryStats {
+	ArenaStats Arenas[AM_MEM_TAGS];
+	uint64_t Compact, Mapped;   // ADPCM bytes (within "pcm"), and bytes of mapped files & banks (in no arena)
+};
+void GetStats(EngineStats& player, EngineStats& preview, int& job_priority, bool reset);
+void GetMemoryStats(MemoryStats& out);
+
+/* Offline Rendering */
+struct OfflineStatus {
+	bool Done;
+	double Progress;
+	const float* PCM;   // Interleaved f32, once done; owned by the context
+	uint64_t Frames;
+	uint32_t Channels;
+};
+AmOffline* CreateOffline(double length_ms, const char*& error);
+void ReleaseOffline(AmOffline* O);
+bool OfflineAddUnit(AmOffline* O, AmResource* R, double start_ms, float volume);
+bool OfflineRender(AmOffline* O);
+OfflineStatus OfflinePoll(AmOffline* O);
+
+/* Analysis */
+AmWaveform* BuildWaveform(AmResource* R, const char*& error);
+void ReleaseWaveform(AmWaveform* W);
+bool WaveformRange(AmWaveform* W, double start_ms, double end_ms, int columns, std::vector<float>& min, std::vector<float>& max, std::vector<float>& rms);
+
+struct Rhythm {
+	std::vector<double> Onsets;   // ms
+	std::vector<double> Bpms;   // Best first
+	std::vector<float> Confidences;
+	double OffsetMs;
+	std::vector<float> Strength;   // Onset strength, at StrengthRate per second
+	double StrengthRate;
+};
+bool AnalyzeRhythm(AmResource* R, Rhythm& out, const char*& error);
+
+bool EnableAnalyzer(AmUnit* U, uint32_t bands);
+void DisableAnalyzer();
+uint32_t GetSpectrum(float* levels);   // Fills up to AM_BANDS_MAX levels in dB; 0 when disabled
+
+}
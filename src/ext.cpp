@@ -2,421 +2,816 @@
 #pragma once
 
 /* Includes */
-#include <miniaudio.h>   // Trimmings are moved to ext.manifest now
+#include "core.h"   // Everything but the Lua glue lives in core.cpp
+#include "ffi.h"   // AmHandle, & the FFI exports
 #include <dmsdk/sdk.h>
 #include <dmsdk/dlib/buffer.h>
 #include <dmsdk/script/script.h>
 #include <dmsdk/dlib/log.h>
-#include <unordered_map>
+#include <dmsdk/dlib/configfile.h>
+#include <atomic>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+
+/* Handles */
+// Full userdata over an AmHandle (see ffi.h), one per native object. A check is a metatable compare plus a generation compare, so stale handles fail
+// the way wrong ones do. Releasing clears Ptr for every copy in Lua, and collected handles get released by AmUpdate().
+int AmMetatables[AM_HANDLE_TYPES];   // Registry refs
+std::vector<void*> AmGarbage[AM_HANDLE_TYPES];   // Collected but not released yet; Lua thread only
+
+static AmHandle* AmToHandle(lua_State* L, int i, AmHandleType type) {
+	/* The live handle of "type" at i, or nullptr. */
+	const auto H = (AmHandle*)lua_touserdata(L, i);
+	if( !H || !lua_getmetatable(L, i) )
+		return nullptr;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, AmMetatables[type]);
+	const bool typed = lua_rawequal(L, -1, -2);
+	lua_pop(L, 2);
+	return ( typed && H -> Ptr && H -> Generation == AcAudio::Generation() ) ? H : nullptr;
+}
+template<typename T>
+inline T* AmTo(lua_State* L, int i, AmHandleType type) {
+	const auto H = AmToHandle(L, i, type);
+	return H ? (T*)H -> Ptr : nullptr;
+}
+static void AmPushHandle(lua_State* L, void* P, AmHandleType type) {
+	const auto H = (AmHandle*)lua_newuserdata( L, sizeof(AmHandle) );
+	H -> Ptr = P;
+	H -> Generation = AcAudio::Generation();
+	H -> Type = type;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, AmMetatables[type]);
+	lua_setmetatable(L, -2);
+}
+static void AmHoldValue(lua_State* L, int holder, int held) {
+	/* Keeps the value at "held" alive as long as the handle at "holder", through the handle's environment table. */
+	lua_getfenv(L, holder);
+	lua_pushvalue(L, held);
+	lua_rawseti( L, -2, (int)lua_objlen(L, -2) + 1 );
+	lua_pop(L, 1);
+}
+template<AmHandleType T>
+static int AmCollect(lua_State* L) {
+	const auto H = (AmHandle*)lua_touserdata(L, 1);
+	if( H -> Ptr && H -> Generation == AcAudio::Generation() )
+		AmGarbage[T].push_back(H -> Ptr);
+	return 0;
+}
+static void AmReleaseGarbage() {
+	/*
+	 * Out of the collector, so that joining a rendering or a full command queue never stalls or fails a collection.
+	 * Resources go last: their units & offline contexts hold them in Lua, so they are collected in the same cycle at the earliest.
+	 */
+	for(auto W : AmGarbage[AM_HANDLE_WAVEFORM])
+		AcAudio::ReleaseWaveform( (AmWaveform*)W );
+	AmGarbage[AM_HANDLE_WAVEFORM].clear();
+	for(auto O : AmGarbage[AM_HANDLE_OFFLINE])
+		AcAudio::ReleaseOffline( (AmOffline*)O );
+	AmGarbage[AM_HANDLE_OFFLINE].clear();
+
+	auto& units = AmGarbage[AM_HANDLE_UNIT];   // Kept for the next frame if the command queue is full
+	units.erase( std::remove_if( units.begin(), units.end(), [](void* U) { return AcAudio::ReleaseUnit( (AmUnit*)U ); } ), units.end() );
+	for(auto R : AmGarbage[AM_HANDLE_RESOURCE])
+		AcAudio::ReleaseResource( (AmResource*)R );   // Deferred by the core until its units are gone
+	AmGarbage[AM_HANDLE_RESOURCE].clear();
+}
 
 
 /* Lua API Implementations */
-// "Am": Aerials miniaudio binding module
-
-// The "Preview" Engine (fast to load, and slow to play)
-ma_engine PreviewEngine;
-ma_resource_manager* PreviewRM;
-ma_resource_manager_data_source* PreviewResource;   // delete & Set nullptr
-ma_sound* PreviewSound;   // sound_handle: delete & Set nullptr
-bool PreviewPlaying;
-
-// The "Player" Engine (slow to load, and fast to play)
-ma_engine PlayerEngine;
-ma_resource_manager player_rm, *PlayerRM;
-std::unordered_map<ma_resource_manager_data_source*, void*> PlayerResources;   // HResource -> CopiedBuffer
-std::unordered_map<ma_sound*, bool> PlayerUnits;   // HSound -> IsPlaying
+// "Am": Aerials miniaudio binding module; each function checks its Lua arguments, calls AcAudio::, and pushes the results.
+// Functions taking a handle first are also the methods of that handle, e.g. unit:play() for PlayUnit(unit).
 
 // Resource Level
+static int AmPushResource(lua_State* L, AmResource* R, const char* error) {
+	lua_pushboolean(L, R != nullptr);   // OK
+	if(R)
+		AmPushHandle(L, R, AM_HANDLE_RESOURCE);   // Resource Handle or Msg
+	else
+		lua_pushstring(L, error);   // Resource Handle or Msg
+	return 2;
+}
 static int AmCreateResource(lua_State* L) {
 	const auto LB = dmScript::CheckBuffer(L, 1);   // Buf
 
-	// Copy the ByteArray from Defold Lua
+	// The ByteArray from Defold Lua gets copied by the core
 	void *OB;
 	uint32_t BSize;
 	dmBuffer::GetBytes(LB -> m_Buffer, &OB, &BSize);
 
-	void *B = malloc(BSize);
-	memcpy(B, OB, BSize);
+	const char* error = nullptr;
+	const auto R = AcAudio::CreateResource(OB, BSize, lua_isnumber(L, 2), lua_tonumber(L, 2), lua_toboolean(L, 3), error);   // TargetLufs, Compact
+	return AmPushResource(L, R, error);
+}
+static int AmCreateResources(lua_State* L) {
+	/* Batch CreateResource; returns (OK, handles, msg), where failed entries are false, OK tells whether none failed, and msg the first failure. */
+	luaL_checktype(L, 1, LUA_TTABLE);   // Bufs
+	const auto count = (int)lua_objlen(L, 1);
+
+	// Check every buffer before copying any
+	std::vector<AcAudio::Bytes> bufs(count);
+	for(int i = 0; i < count; i++) {
+		lua_rawgeti(L, 1, i + 1);
+		const auto LB = dmScript::CheckBuffer(L, -1);   // Kept alive by the table
+		uint32_t BSize;
+		dmBuffer::GetBytes(LB -> m_Buffer, (void**)&bufs[i].Data, &BSize);
+		bufs[i].Size = BSize;
+		lua_pop(L, 1);
+	}
 
-	// Decoding
-	auto R = new ma_resource_manager_data_source;
-	const auto N = ma_resource_manager_pipeline_notifications_init();
-	ma_resource_manager_register_encoded_data(PlayerRM, "B", B, (size_t)BSize);
-	const auto result = ma_resource_manager_data_source_init(
-		PlayerRM, "B",
-		// For "flags", using bor for the combination is recommended here
-		MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_DECODE | MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_WAIT_INIT,
-		&N, R);
-	ma_resource_manager_unregister_data(PlayerRM, "B");
+	std::vector<AmResource*> Rs;
+	const char* error = nullptr;
+	const bool all = AcAudio::CreateResources(bufs, lua_isnumber(L, 2), lua_tonumber(L, 2), lua_toboolean(L, 3), Rs, error);   // TargetLufs, Compact
 
 	// Do Returns
-	if(result == MA_SUCCESS) {
-		lua_pushboolean(L, true);   // OK
-		lua_pushlightuserdata(L, R);   // Resource Handle or Msg
-		PlayerResources.emplace(R, B);
-	}
-	else {
-		lua_pushboolean(L, false);   // OK
-		lua_pushstring(L, "[!] Audio format not supported by miniaudio");   // Resource Handle or Msg
-		delete R;
-		free(B);
+	lua_pushboolean(L, all);   // OK
+	lua_createtable(L, count, 0);   // Handles
+	for(int i = 0; i < count; i++) {
+		if(Rs[i])
+			AmPushHandle(L, Rs[i], AM_HANDLE_RESOURCE);
+		else
+			lua_pushboolean(L, false);
+		lua_rawseti(L, -2, i + 1);
 	}
-	return 2;
+	if(all)
+		lua_pushnil(L);
+	else
+		lua_pushstring(L, error);   // Msg
+	return 3;
+}
+static int AmCreateResourceFromFile(lua_State* L) {
+	const auto path = luaL_checkstring(L, 1);   // Path
+	const char* error = nullptr;
+	const auto R = AcAudio::CreateResourceFromFile(path, lua_isnumber(L, 2), lua_tonumber(L, 2), lua_toboolean(L, 3), error);   // TargetLufs, Compact
+	return AmPushResource(L, R, error);
 }
 static int AmReleaseResource(lua_State* L) {
-	/*
-	 * Notice:
-	 * You CANNOT release a resource refed by some unit(s).
-	 */
-	const auto RH = (ma_resource_manager_data_source*)lua_touserdata(L, 1);   // Resource Handle
-	if( PlayerResources.count(RH) ) {
-		ma_resource_manager_data_source_uninit(RH);
-		free(PlayerResources[RH]);			PlayerResources.erase(RH);
-		lua_pushboolean(L, true);   // OK
-		delete RH;
+	/* The native resource stays until its units are released too. */
+	const auto H = AmToHandle(L, 1, AM_HANDLE_RESOURCE);   // Resource Handle
+	if(H) {
+		AcAudio::ReleaseResource( (AmResource*)H -> Ptr );
+		H -> Ptr = nullptr;
 	}
-	else
-		lua_pushboolean(L, false);   // OK
+	lua_pushboolean(L, H != nullptr);   // OK
 	return 1;
 }
+static int AmGetLoudness(lua_State* L) {
+	/* Returns (lufs, true_peak_db, gain_db), or nil if the resource wasn't normalized. */
+	const auto R = AmTo<AmResource>(L, 1, AM_HANDLE_RESOURCE);   // Resource Handle
+	float lufs, dbtp, gain_db;
+	if( !R || !AcAudio::GetLoudness(R, lufs, dbtp, gain_db) ) {
+		lua_pushnil(L);
+		return 1;
+	}
+	lua_pushnumber(L, lufs);
+	lua_pushnumber(L, dbtp);
+	lua_pushnumber(L, gain_db);
+	return 3;
+}
+static int AmEndChart(lua_State* L) {
+	AcAudio::EndChart();
+	return 0;
+}
+static int AmBeginChart(lua_State* L) {
+	/* Encoded copies made from now on share one arena, freed at once after EndChart() & the release of its last resource. */
+	AcAudio::BeginChart();
+	return 0;
+}
 
 // Unit Level
+// PlayUnit, StopUnit, CheckPlaying, GetTime & SetTime run during gameplay; the core side allocates nothing and takes no locks.
 static int AmCreateUnit(lua_State* L) {
-	// Create a Sound
-	const auto S = new ma_sound;
-	const auto RH = (ma_resource_manager_data_source*)lua_touserdata(L, 1);   // Resource Handle
-	const auto result = ma_sound_init_from_data_source(
-		&PlayerEngine, RH,
-		// Notice that some "sound" flags same as "resource manager data source" flags are omitted here
-		MA_SOUND_FLAG_NO_PITCH | MA_SOUND_FLAG_NO_SPATIALIZATION,
-		nullptr, S   // Set Group to nullptr is allowed here
-		);
-
-	// Do Returns
-	if(result == MA_SUCCESS) {
-		lua_pushboolean(L, true);   // OK
-		lua_pushlightuserdata(L, S);   // Unit Handle or Msg
-
-		// Audio Length in Ms
-		float len = 0;   // The length getter needs to return a ma_result value
-		ma_sound_get_length_in_seconds(S, &len);
-		lua_pushnumber( L, (uint64_t)(len * 1000.0) );
-
-		// Unit Emplacing
-		PlayerUnits[S] = false;
-		return 3;
-	}
-	else {
+	const auto R = AmTo<AmResource>(L, 1, AM_HANDLE_RESOURCE);   // Resource Handle
+	if(!R) {
 		lua_pushboolean(L, false);   // OK
-		lua_pushstring(L, "[!] Failed to Initialize the Unit");   // Unit Handle or Msg
-		delete S;
+		lua_pushstring(L, "[!] Invalid Resource Handle");   // Unit Handle or Msg
 		return 2;
 	}
+	double length_ms;
+	const auto U = AcAudio::CreateUnit(R, length_ms);
+
+	// Do Returns, with the Audio Length in Ms; the unit holds its resource in Lua
+	lua_pushboolean(L, true);   // OK
+	AmPushHandle(L, U, AM_HANDLE_UNIT);   // Unit Handle or Msg
+	lua_createtable(L, 1, 0);
+	lua_pushvalue(L, 1);
+	lua_rawseti(L, -2, 1);
+	lua_setfenv(L, -2);
+	lua_pushnumber(L, length_ms);
+	return 3;
 }
 static int AmReleaseUnit(lua_State* L) {
-	const auto S = (ma_sound*)lua_touserdata(L, 1);   // Unit Handle
-
-	if( PlayerUnits.count(S) ) {
-		// Stop & Uninitialize
-		if( PlayerUnits[S] )
-			ma_sound_stop(S);
-		ma_sound_uninit(S);
-
-		// Clean Up & Return
-		lua_pushboolean(L, true);   // OK
-		PlayerUnits.erase(S);
-		delete S;   // Remind to pair the "new" operator
-	}
-	else
-		lua_pushboolean(L, false);   // OK
-
+	/*
+	 * The unit is stopped and detached by the audio thread,
+	 * and then freed by a later CreateUnit/ReleaseUnit call.
+	 */
+	const auto H = AmToHandle(L, 1, AM_HANDLE_UNIT);   // Unit Handle
+	const bool ok = H && AcAudio::ReleaseUnit( (AmUnit*)H -> Ptr );
+	if(ok)
+		H -> Ptr = nullptr;
+	lua_pushboolean(L, ok);   // OK
 	return 1;
 }
 static int AmPlayUnit(lua_State* L) {
-	const auto UH = (ma_sound*)lua_touserdata(L, 1);   // Unit Handle
+	const auto U = AmTo<AmUnit>(L, 1, AM_HANDLE_UNIT);   // Unit Handle
 	const bool is_looping = lua_toboolean(L, 2);   // IsLooping
-
-	if( PlayerUnits.count(UH) ) {
-		// Set Looping
-		ma_sound_set_looping(UH, is_looping);
-
-		// Start
-		if( ma_sound_start(UH) == MA_SUCCESS ) {
-			PlayerUnits[UH] = true;
-			lua_pushboolean(L, true);   // OK
-		}
-		else {
-			PlayerUnits[UH] = false;
-			lua_pushboolean(L, false);   // OK
-		}
-	}
-	else
-		lua_pushboolean(L, false);   // OK
-
+	const auto delay_ms = luaL_optnumber(L, 3, 0.0);   // DelayMs, counted from now in the chart time
+	lua_pushboolean( L, U && AcAudio::PlayUnit(U, is_looping, delay_ms) );   // OK
 	return 1;
 }
 static int AmStopUnit(lua_State* L) {
-	const auto UH = (ma_sound*)lua_touserdata(L, 1);   // Unit Handle
-
-	if( PlayerUnits.count(UH) ) {
-		if( ma_sound_stop(UH) == MA_SUCCESS) {
-			if( lua_toboolean(L, 2) )   // Rewind to Start
-				ma_sound_seek_to_pcm_frame(UH, 0);
-			PlayerUnits[UH] = false;
-			lua_pushboolean(L, true);   // OK
-		}
-		else
-			lua_pushboolean(L, false);   // OK
-	}
-	else
-		lua_pushboolean(L, false);   // OK
-
+	const auto U = AmTo<AmUnit>(L, 1, AM_HANDLE_UNIT);   // Unit Handle
+	lua_pushboolean( L, U && AcAudio::StopUnit(U, lua_toboolean(L, 2)) );   // OK; Rewind to Start
 	return 1;
 }
 static int AmCheckPlaying(lua_State* L) {
-	const auto UH = (ma_sound*)lua_touserdata(L, 1);   // Unit Handle
-
-	if( PlayerUnits.count(UH) ) {
-		const bool p = ma_sound_is_playing(UH);
-		PlayerUnits[UH] = p;
-		lua_pushboolean(L, p);   // Status
-	}
+	const auto U = AmTo<AmUnit>(L, 1, AM_HANDLE_UNIT);   // Unit Handle
+	if(U)
+		lua_pushboolean( L, AcAudio::CheckPlaying(U) );   // Status
 	else
 		lua_pushnil(L);   // Status
-
 	return 1;
 }
 static int AmGetTime(lua_State* L) {
-	const auto UH = (ma_sound*)lua_touserdata(L, 1);   // Unit Handle
-
-	if( PlayerUnits.count(UH) )
-		lua_pushnumber( L, ma_sound_get_time_in_milliseconds(UH) );   // Actual ms or nil
+	const auto U = AmTo<AmUnit>(L, 1, AM_HANDLE_UNIT);   // Unit Handle
+	if(U)
+		lua_pushnumber( L, AcAudio::GetTime(U) );   // Actual ms or nil
 	else
 		lua_pushnil(L);   // Actual ms or nil
-
+	return 1;
+}
+static int AmGetTimeFrames(lua_State* L) {
+	const auto U = AmTo<AmUnit>(L, 1, AM_HANDLE_UNIT);   // Unit Handle
+	if(U)
+		lua_pushnumber( L, (lua_Number)AcAudio::GetTimeFrames(U) );   // Frames of the resource or nil
+	else
+		lua_pushnil(L);   // Frames of the resource or nil
 	return 1;
 }
 static int AmSetTime(lua_State* L) {
 	/* Keep in mind that this is an ASYNC API. */
-	const auto U = (ma_sound*)lua_touserdata(L, 1);   // Unit Handle
-	auto ms = (int64_t)luaL_checknumber(L, 2);   // mstime
-
-	if( PlayerUnits.count(U) && (!PlayerUnits[U]) ) {
-		// Get the sound length
-		float len = 0;
-		ma_sound_get_length_in_seconds(U, &len);		len *= 1000.0f;
-
-		// Set the time
-		ms = (ms > 0) ? ms : 0;
-		ms = (ms < len-2.0) ? ms : len-2.0;
-		const auto result = ma_sound_seek_to_pcm_frame(U,
-			(uint64_t)(ms * ma_engine_get_sample_rate(&PlayerEngine) / 1000.0)
-		);
-		lua_pushboolean(L, result == MA_SUCCESS);   // OK
+	const auto U = AmTo<AmUnit>(L, 1, AM_HANDLE_UNIT);   // Unit Handle
+	const auto ms = luaL_checknumber(L, 2);   // mstime
+	lua_pushboolean( L, U && AcAudio::SetTime(U, ms) );   // OK
+	return 1;
+}
+
+static int AmSetTimeFrames(lua_State* L) {
+	/* Keep in mind that this is an ASYNC API too. */
+	const auto U = AmTo<AmUnit>(L, 1, AM_HANDLE_UNIT);   // Unit Handle
+	const auto frames = luaL_checknumber(L, 2);   // Frames of the resource
+	lua_pushboolean( L, U && AcAudio::SetTimeFrames(U, (frames > 0.0) ? (uint64_t)frames : 0) );   // OK
+	return 1;
+}
+
+// Player Clock
+static int AmGetEngineFrames(lua_State* L) {
+	lua_pushnumber( L, (lua_Number)AcAudio::GetEngineFrames() );
+	return 1;
+}
+static int AmSnapshot(lua_State* L) {
+	/* Returns {engine_frames, chart_frames, unit_frames, callback_ns, now_ns, latency_frames, sample_rate, clock_rate}, filling "into" if given. */
+	AmUnit* U = nullptr;
+	if( !lua_isnoneornil(L, 1) ) {
+		U = AmTo<AmUnit>(L, 1, AM_HANDLE_UNIT);   // Unit Handle, optional
+		if(!U) {
+			lua_pushnil(L);
+			return 1;
+		}
 	}
-	else
-		lua_pushboolean(L, false);   // OK
+	const auto S = AcAudio::TakeSnapshot(U);
 
+	if( lua_istable(L, 2) )   // Into, optional; saves a table per frame
+		lua_pushvalue(L, 2);
+	else
+		lua_createtable(L, 0, 8);
+	lua_pushnumber(L, (lua_Number)S.EngineFrames);		lua_setfield(L, -2, "engine_frames");
+	lua_pushnumber(L, (lua_Number)S.ChartFrames);		lua_setfield(L, -2, "chart_frames");
+	if(U)
+		lua_pushnumber(L, (lua_Number)S.UnitFrames);
+	else
+		lua_pushnil(L);
+	lua_setfield(L, -2, "unit_frames");
+	lua_pushnumber(L, (lua_Number)S.CallbackNs);		lua_setfield(L, -2, "callback_ns");
+	lua_pushnumber(L, (lua_Number)S.NowNs);				lua_setfield(L, -2, "now_ns");
+	lua_pushnumber(L, S.LatencyFrames);					lua_setfield(L, -2, "latency_frames");
+	lua_pushnumber(L, S.SampleRate);					lua_setfield(L, -2, "sample_rate");
+	lua_pushnumber(L, S.ClockRate);						lua_setfield(L, -2, "clock_rate");
+	return 1;
+}
+static int AmAudioTimeAt(lua_State* L) {
+	/* Engine frames at a monotonic time in ns, now by default; e.g. to judge an input in the audio clock. nil until the clock is fitted. */
+	uint64_t ns = AcAudio::GetMonotonicNs();
+	if( lua_isnumber(L, 1) ) {   // MonotonicNs
+		const auto t = lua_tonumber(L, 1);
+		luaL_argcheck(L, t >= 0.0 && t < 1.8e19, 1, "out of range");
+		ns = (uint64_t)t;
+	}
+	double frames;
+	if( AcAudio::AudioTimeAt(ns, frames) )
+		lua_pushnumber(L, frames);
+	else
+		lua_pushnil(L);
+	return 1;
+}
+static int AmMonotonicAt(lua_State* L) {
+	/* nil until the clock is fitted, or out of range. */
+	uint64_t ns;
+	if( AcAudio::MonotonicAt(luaL_checknumber(L, 1), ns) )   // EngineFrames
+		lua_pushnumber(L, (lua_Number)ns);
+	else
+		lua_pushnil(L);
+	return 1;
+}
+static int AmGetMonotonicNs(lua_State* L) {
+	lua_pushnumber( L, (lua_Number)AcAudio::GetMonotonicNs() );
 	return 1;
 }
 
 // Preview Functions
-static int AmStopPreview(lua_State* L) {   // Should be always safe
-	if(PreviewSound) {
-		ma_sound_stop(PreviewSound);
-		ma_sound_uninit(PreviewSound);
-		delete PreviewSound;
-
-		PreviewSound = nullptr;
-		PreviewPlaying = false;
+// PlayPreview streams the Lua buffer in place, so the buffer is pinned by a registry ref until the stream is gone.
+int AmPreviewBuffer = LUA_NOREF;   // Registry ref
 
-		ma_resource_manager_data_source_uninit(PreviewResource);
-		delete PreviewResource;
-		PreviewResource = nullptr;
-	}
+static void AmUnpinPreview(lua_State* L) {   // Once the stream reading the buffer is stopped
+	luaL_unref(L, LUA_REGISTRYINDEX, AmPreviewBuffer);
+	AmPreviewBuffer = LUA_NOREF;
+}
+static int AmStopPreview(lua_State* L) {   // Should be always safe
+	AcAudio::StopPreview();
+	AmUnpinPreview(L);
 	return 0;
 }
 static int AmPlayPreview(lua_State* L) {
 	const auto LB = dmScript::CheckBuffer(L, 1);   // Buf
 	const bool is_looping = lua_toboolean(L, 2);   // IsLooping
 
-	// Get the ByteArray & Pre-Cleaning
-	uint32_t BSize, *B;
-	dmBuffer::GetBytes(LB -> m_Buffer, (void**)&B, &BSize);
-	AmStopPreview(L);
-
-	// Load Resource
-	PreviewResource = new ma_resource_manager_data_source;
-	const auto N = ma_resource_manager_pipeline_notifications_init();
-	ma_resource_manager_register_encoded_data(PreviewRM, "PD", B, (size_t)BSize);
-	const auto res_result = ma_resource_manager_data_source_init(
-		PreviewRM, "PD",
-		MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_STREAM | MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_WAIT_INIT,
-		&N, PreviewResource);
-	ma_resource_manager_unregister_data(PreviewRM, "PD");
-
-	// Load Unit & Play
-	if(res_result == MA_SUCCESS) {
-		PreviewSound = new ma_sound;
-		const auto unit_result = ma_sound_init_from_data_source(
-			&PreviewEngine, PreviewResource,
-			MA_SOUND_FLAG_NO_PITCH | MA_SOUND_FLAG_NO_SPATIALIZATION,
-			nullptr, PreviewSound
-		);
-		if(unit_result == MA_SUCCESS) {
-			// Set Looping
-			ma_sound_set_looping( PreviewSound, is_looping );
-
-			// Start
-			if( ma_sound_start(PreviewSound) == MA_SUCCESS ) {
-				lua_pushboolean(L, true);   // OK
-				PreviewPlaying = true;
-			}
-			else {
-				// Clean Up 1
-				ma_sound_stop(PreviewSound);
-				ma_sound_uninit(PreviewSound);
-
-				delete PreviewSound;
-				PreviewSound = nullptr;
-				PreviewPlaying = false;
-
-				// Clean Up 2
-				lua_pushboolean(L, false);   // OK
-				ma_resource_manager_data_source_uninit(PreviewResource);
-				delete PreviewResource;		PreviewResource = nullptr;
-			}
-		}
-		else {
-			// Clean Up 1
-			delete PreviewSound;
-			PreviewSound = nullptr;
-			PreviewPlaying = false;
+	// Read in place; the last stream is stopped by now, so its buffer gets unpinned, and this one pinned instead
+	uint32_t BSize;
+	void* B;
+	dmBuffer::GetBytes(LB -> m_Buffer, &B, &BSize);
+	const bool ok = AcAudio::PlayPreview(B, BSize, is_looping, lua_isnumber(L, 3), lua_tonumber(L, 3));   // TargetLufs
+	AmUnpinPreview(L);
+	if(ok) {
+		lua_pushvalue(L, 1);
+		AmPreviewBuffer = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+	lua_pushboolean(L, ok);   // OK
+	return 1;
+}
+static int AmPlayPreviewFromFile(lua_State* L) {
+	const auto path = luaL_checkstring(L, 1);   // Path
+	const bool is_looping = lua_toboolean(L, 2);   // IsLooping
+	lua_pushboolean( L, AcAudio::PlayPreviewFromFile(path, is_looping, lua_isnumber(L, 3), lua_tonumber(L, 3)) );   // OK; TargetLufs
+	AmUnpinPreview(L);   // The last stream is stopped by now
+	return 1;
+}
+
+// Playback Rates
+static int AmSetPlaybackRate(lua_State* L) {
+	/* Pitch-preserving; GetTime, SetTime & PlayUnit delays stay in the chart time. */
+	lua_pushnumber( L, AcAudio::SetPlaybackRate((float)luaL_checknumber(L, 1)) );   // Applied Rate
+	return 1;
+}
+static int AmSetPreviewRate(lua_State* L) {
+	lua_pushnumber( L, AcAudio::SetPreviewRate((float)luaL_checknumber(L, 1)) );   // Applied Rate
+	return 1;
+}
+
+// Profiling
+static void AmPushStats(lua_State* L, const AcAudio::EngineStats& St) {
+	lua_createtable(L, 0, 11);
+	lua_pushnumber(L, (lua_Number)St.Callbacks);		lua_setfield(L, -2, "callbacks");
+	lua_pushnumber(L, (lua_Number)St.Frames);			lua_setfield(L, -2, "frames");
+	lua_pushnumber(L, St.Load);							lua_setfield(L, -2, "load");
+	lua_pushnumber(L, St.PeakLoad);						lua_setfield(L, -2, "peak_load");
+	lua_pushnumber(L, St.Underruns);					lua_setfield(L, -2, "underruns");
+	lua_pushnumber(L, St.LateCallbacks);				lua_setfield(L, -2, "late_callbacks");
+	lua_pushnumber(L, St.PeakVoices);					lua_setfield(L, -2, "peak_voices");
+	lua_pushnumber(L, St.Priority);						lua_setfield(L, -2, "thread_priority");
+	lua_pushnumber(L, St.Cores);						lua_setfield(L, -2, "thread_cores");
+
+	lua_createtable(L, AM_STATS_BUCKETS, 0);   // histogram[i]: load in [(i-1)/8, i/8), the last one is open-ended
+	for(int i = 0; i < AM_STATS_BUCKETS; i++) {
+		lua_pushnumber(L, St.Histogram[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	lua_setfield(L, -2, "histogram");
+}
+static int AmGetStats(lua_State* L) {
+	const bool reset = lua_toboolean(L, 1);   // ResetAfterReading
+	AcAudio::EngineStats player, preview;
+	int job_priority;
+	AcAudio::GetStats(player, preview, job_priority, reset);
+
+	lua_createtable(L, 0, 3);
+	AmPushStats(L, player);		lua_setfield(L, -2, "player");
+	AmPushStats(L, preview);	lua_setfield(L, -2, "preview");
+	lua_pushnumber(L, job_priority);	lua_setfield(L, -2, "job_priority");
+	return 1;
+}
+static int AmGetMemoryStats(lua_State* L) {
+	/* Returns {pcm = arena, stream = arena, sound = arena, decoder = arena, encoded = arena, compact = bytes, mapped = bytes}. */
+	AcAudio::MemoryStats M;
+	AcAudio::GetMemoryStats(M);
+
+	lua_createtable(L, 0, AM_MEM_TAGS + 2);
+	for(uint32_t i = 0; i < AM_MEM_TAGS; i++) {
+		lua_createtable(L, 0, 3);
+		lua_pushnumber( L, (lua_Number)M.Arenas[i].Bytes );			lua_setfield(L, -2, "bytes");
+		lua_pushnumber( L, (lua_Number)M.Arenas[i].Peak );			lua_setfield(L, -2, "peak");
+		lua_pushnumber( L, (lua_Number)M.Arenas[i].Allocations );	lua_setfield(L, -2, "allocations");
+		lua_setfield(L, -2, AmMemoryTagNames[i]);
+	}
+	lua_pushnumber(L, (lua_Number)M.Compact);		lua_setfield(L, -2, "compact");
+	lua_pushnumber(L, (lua_Number)M.Mapped);		lua_setfield(L, -2, "mapped");
+	return 1;
+}
 
-			// Clean Up 2
+// Offline Rendering
+static int AmCreateOffline(lua_State* L) {
+	const auto ms = luaL_checknumber(L, 1);   // LengthMs
+	const char* error = nullptr;
+	const auto O = AcAudio::CreateOffline(ms, error);
+	lua_pushboolean(L, O != nullptr);   // OK
+	if(O) {
+		AmPushHandle(L, O, AM_HANDLE_OFFLINE);   // Offline Handle or Msg
+		lua_newtable(L);   // Resources added, see AmOfflineAddUnit()
+		lua_setfenv(L, -2);
+	}
+	else
+		lua_pushstring(L, error);   // Offline Handle or Msg
+	return 2;
+}
+static int AmOfflineAddUnit(lua_State* L) {
+	/* The offline context holds the resource in Lua, so that it can't be collected first. */
+	const auto O = AmTo<AmOffline>(L, 1, AM_HANDLE_OFFLINE);   // Offline Handle
+	const auto R = AmTo<AmResource>(L, 2, AM_HANDLE_RESOURCE);   // Resource Handle
+	const auto ms = luaL_optnumber(L, 3, 0.0);   // StartMs
+	const auto volume = (float)luaL_optnumber(L, 4, 1.0);   // Volume
+
+	const bool ok = O && R && AcAudio::OfflineAddUnit(O, R, ms, volume);
+	if(ok)
+		AmHoldValue(L, 1, 2);
+	lua_pushboolean(L, ok);   // OK
+	return 1;
+}
+static int AmOfflineRender(lua_State* L) {
+	const auto O = AmTo<AmOffline>(L, 1, AM_HANDLE_OFFLINE);   // Offline Handle
+	lua_pushboolean( L, O && AcAudio::OfflineRender(O) );   // OK
+	return 1;
+}
+static int AmOfflinePoll(lua_State* L) {
+	/* Returns (true, buffer) once rendered, or (false, progress) otherwise. */
+	const auto O = AmTo<AmOffline>(L, 1, AM_HANDLE_OFFLINE);   // Offline Handle
+	if(!O) {
+		lua_pushboolean(L, false);   // Done
+		lua_pushnil(L);   // Buffer or Progress
+		return 2;
+	}
+
+	const auto St = AcAudio::OfflinePoll(O);
+	if(!St.Done) {
+		lua_pushboolean(L, false);   // Done
+		lua_pushnumber(L, St.Progress);   // Buffer or Progress
+		return 2;
+	}
+
+	// Copy the PCM into a Defold Buffer, with a "pcm" stream of f32 * channels
+	const dmBuffer::StreamDeclaration decl[] = {
+		{dmHashString64("pcm"), dmBuffer::VALUE_TYPE_FLOAT32, (uint8_t)St.Channels}
+	};
+	dmBuffer::HBuffer B = 0;
+	void* data;
+	uint32_t count, components, stride;
+	if( dmBuffer::Create((uint32_t)St.Frames, decl, 1, &B) != dmBuffer::RESULT_OK ||
+		dmBuffer::GetStream(B, dmHashString64("pcm"), &data, &count, &components, &stride) != dmBuffer::RESULT_OK ) {
+		if(B)
+			dmBuffer::Destroy(B);
+		lua_pushboolean(L, false);   // Done
+		lua_pushnil(L);   // Buffer or Progress
+		return 2;
+	}
+	memcpy( data, St.PCM, (size_t)(St.Frames * St.Channels * sizeof(float)) );
+
+	lua_pushboolean(L, true);   // Done
+	dmScript::PushBuffer( L, dmScript::LuaHBuffer(B, dmScript::OWNER_LUA) );   // Buffer or Progress
+	return 2;
+}
+static int AmReleaseOffline(lua_State* L) {
+	const auto H = AmToHandle(L, 1, AM_HANDLE_OFFLINE);   // Offline Handle
+	if(H) {
+		AcAudio::ReleaseOffline( (AmOffline*)H -> Ptr );   // Cancels & joins an unfinished rendering
+		H -> Ptr = nullptr;
+	}
+	lua_pushboolean(L, H != nullptr);   // OK
+	return 1;
+}
+
+// Sound Banks
+static int AmBuildBank(lua_State* L) {
+	/* Writes {name = resource_handle, ...} into a bank file; returns (OK, msg_or_nil). */
+	const auto path = luaL_checkstring(L, 1);   // Path
+	luaL_checktype(L, 2, LUA_TTABLE);   // Entries
+
+	std::vector<AcAudio::BankItem> items;
+	const char* error = nullptr;
+	lua_pushnil(L);
+	while( lua_next(L, 2) ) {
+		const auto R = AmTo<AmResource>(L, -1, AM_HANDLE_RESOURCE);
+		if( lua_type(L, -2) != LUA_TSTRING || !R ) {
 			lua_pushboolean(L, false);   // OK
-			ma_resource_manager_data_source_uninit(PreviewResource);
-			delete PreviewResource;		PreviewResource = nullptr;
+			lua_pushstring(L, "[!] Bank entries must map names to resource handles");   // Msg
+			return 2;
 		}
+		items.push_back( { dmHashString64( lua_tostring(L, -2) ), R } );
+		lua_pop(L, 1);
 	}
-	else {   // Clean Up 2
+
+	const bool written = AcAudio::BuildBank(path, items, error);
+	lua_pushboolean(L, written);   // OK
+	if(written)
+		lua_pushnil(L);   // Msg
+	else
+		lua_pushstring(L, error);   // Msg
+	return 2;
+}
+static int AmLoadBank(lua_State* L) {
+	/* Maps a bank file, and returns (OK, {name_hash = resource_handle, ...} or msg); keys are Defold hashes. */
+	const auto path = luaL_checkstring(L, 1);   // Path
+	std::vector<AcAudio::BankItem> items;
+	const char* error = nullptr;
+	if( !AcAudio::LoadBank(path, items, error) ) {
 		lua_pushboolean(L, false);   // OK
-		delete PreviewResource;
-		PreviewResource = nullptr;
+		lua_pushstring(L, error);   // Resources or Msg
+		return 2;
 	}
 
+	lua_pushboolean(L, true);   // OK
+	lua_createtable(L, 0, (int)items.size());   // Resources or Msg
+	for(const auto& I : items) {
+		dmScript::PushHash(L, I.NameHash);
+		AmPushHandle(L, I.Resource, AM_HANDLE_RESOURCE);
+		lua_settable(L, -3);
+	}
+	return 2;
+}
+
+// Waveform Pyramid
+static int AmBuildWaveform(lua_State* L) {
+	const auto R = AmTo<AmResource>(L, 1, AM_HANDLE_RESOURCE);   // Resource Handle
+	const char* error = "[!] Invalid Resource Handle";
+	const auto W = R ? AcAudio::BuildWaveform(R, error) : nullptr;
+	lua_pushboolean(L, W != nullptr);   // OK
+	if(W)
+		AmPushHandle(L, W, AM_HANDLE_WAVEFORM);   // Waveform Handle or Msg
+	else
+		lua_pushstring(L, error);   // Waveform Handle or Msg
+	return 2;
+}
+static int AmWaveformRange(lua_State* L) {
+	/* Returns min, max & rms tables of "columns" entries, covering [start_ms, end_ms). */
+	const auto W = AmTo<AmWaveform>(L, 1, AM_HANDLE_WAVEFORM);   // Waveform Handle
+	const auto start_ms = luaL_checknumber(L, 2);   // StartMs
+	const auto end_ms = luaL_checknumber(L, 3);   // EndMs
+	const auto n = luaL_checknumber(L, 4);   // Columns
+	luaL_argcheck(L, n >= 1.0 && n <= AM_WAVE_COLUMNS_MAX, 4, "out of range");   // Checked before the cast, so that no value can wrap it
+	const auto columns = (int)n;
+
+	std::vector<float> lo, hi, rms;
+	if( !W || !AcAudio::WaveformRange(W, start_ms, end_ms, columns, lo, hi, rms) ) {
+		lua_pushnil(L);		lua_pushnil(L);		lua_pushnil(L);
+		return 3;
+	}
+	lua_createtable(L, columns, 0);		lua_createtable(L, columns, 0);		lua_createtable(L, columns, 0);
+	for(int c = 0; c < columns; c++) {
+		lua_pushnumber(L, lo[c]);		lua_rawseti(L, -4, c + 1);
+		lua_pushnumber(L, hi[c]);		lua_rawseti(L, -3, c + 1);
+		lua_pushnumber(L, rms[c]);		lua_rawseti(L, -2, c + 1);
+	}
+	return 3;
+}
+static int AmReleaseWaveform(lua_State* L) {
+	const auto H = AmToHandle(L, 1, AM_HANDLE_WAVEFORM);   // Waveform Handle
+	if(H) {
+		AcAudio::ReleaseWaveform( (AmWaveform*)H -> Ptr );
+		H -> Ptr = nullptr;
+	}
+	lua_pushboolean(L, H != nullptr);   // OK
 	return 1;
 }
 
+// Rhythm Analysis
+static int AmAnalyzeRhythm(lua_State* L) {
+	/* Returns (true, {onsets, bpms, confidences, offset_ms, strength, strength_rate}) or (false, msg). */
+	const auto R = AmTo<AmResource>(L, 1, AM_HANDLE_RESOURCE);   // Resource Handle
+	AcAudio::Rhythm Rh;
+	const char* error = "[!] Invalid Resource Handle";
+	if( !R || !AcAudio::AnalyzeRhythm(R, Rh, error) ) {
+		lua_pushboolean(L, false);   // OK
+		lua_pushstring(L, error);   // Result or Msg
+		return 2;
+	}
+
+	// The onset strength goes out as a Defold Buffer, with a "strength" stream of f32
+	const dmBuffer::StreamDeclaration decl[] = {
+		{dmHashString64("strength"), dmBuffer::VALUE_TYPE_FLOAT32, 1}
+	};
+	dmBuffer::HBuffer B = 0;
+	void* data;
+	uint32_t count, components, stride;
+	if( dmBuffer::Create((uint32_t)Rh.Strength.size(), decl, 1, &B) != dmBuffer::RESULT_OK ||
+		dmBuffer::GetStream(B, dmHashString64("strength"), &data, &count, &components, &stride) != dmBuffer::RESULT_OK ) {
+		if(B)
+			dmBuffer::Destroy(B);
+		lua_pushboolean(L, false);   // OK
+		lua_pushstring(L, "[!] Failed to Create the Strength Buffer");   // Result or Msg
+		return 2;
+	}
+	memcpy( data, Rh.Strength.data(), Rh.Strength.size() * sizeof(float) );
+
+	// Do Returns
+	lua_pushboolean(L, true);   // OK
+	lua_createtable(L, 0, 6);   // Result or Msg
+	lua_createtable(L, (int)Rh.Onsets.size(), 0);
+	for(size_t i = 0; i < Rh.Onsets.size(); i++) {
+		lua_pushnumber(L, Rh.Onsets[i]);
+		lua_rawseti(L, -2, (int)i + 1);
+	}
+	lua_setfield(L, -2, "onsets");
+	lua_createtable(L, (int)Rh.Bpms.size(), 0);
+	for(size_t i = 0; i < Rh.Bpms.size(); i++) {
+		lua_pushnumber(L, Rh.Bpms[i]);
+		lua_rawseti(L, -2, (int)i + 1);
+	}
+	lua_setfield(L, -2, "bpms");
+	lua_createtable(L, (int)Rh.Confidences.size(), 0);
+	for(size_t i = 0; i < Rh.Confidences.size(); i++) {
+		lua_pushnumber(L, Rh.Confidences[i]);
+		lua_rawseti(L, -2, (int)i + 1);
+	}
+	lua_setfield(L, -2, "confidences");
+	lua_pushnumber(L, Rh.OffsetMs);					lua_setfield(L, -2, "offset_ms");
+	dmScript::PushBuffer( L, dmScript::LuaHBuffer(B, dmScript::OWNER_LUA) );		lua_setfield(L, -2, "strength");
+	lua_pushnumber(L, Rh.StrengthRate);				lua_setfield(L, -2, "strength_rate");
+	return 2;
+}
+
+// Spectrum Analyzer
+static int AmEnableAnalyzer(lua_State* L) {
+	const auto U = AmTo<AmUnit>(L, 1, AM_HANDLE_UNIT);   // Unit Handle
+	const auto bands = (uint32_t)luaL_optinteger(L, 2, 32);
+	lua_pushboolean( L, U && AcAudio::EnableAnalyzer(U, bands) );   // OK
+	return 1;
+}
+static int AmDisableAnalyzer(lua_State* L) {
+	AcAudio::DisableAnalyzer();
+	return 0;
+}
+static int AmGetSpectrum(lua_State* L) {
+	float levels[AM_BANDS_MAX];
+	const auto B = AcAudio::GetSpectrum(levels);
+	if(!B) {
+		lua_pushnil(L);
+		return 1;
+	}
+	lua_createtable(L, B, 0);
+	for(uint32_t b = 0; b < B; b++) {
+		lua_pushnumber(L, levels[b]);
+		lua_rawseti(L, -2, b + 1);
+	}
+	return 1;
+}
 
 /* Binding Stuff */
 constexpr luaL_reg AmFuncs[] = {
 	{"PlayPreview", AmPlayPreview}, {"StopPreview", AmStopPreview},
+	{"PlayPreviewFromFile", AmPlayPreviewFromFile},
 	{"CreateResource", AmCreateResource}, {"ReleaseResource", AmReleaseResource},
+	{"CreateResourceFromFile", AmCreateResourceFromFile}, {"CreateResources", AmCreateResources},
+	{"BeginChart", AmBeginChart}, {"EndChart", AmEndChart},
+	{"GetLoudness", AmGetLoudness},
+	{"BuildBank", AmBuildBank}, {"LoadBank", AmLoadBank},
 	{"CreateUnit", AmCreateUnit}, {"ReleaseUnit", AmReleaseUnit},
 	{"PlayUnit", AmPlayUnit}, {"StopUnit", AmStopUnit},
 	{"GetTime", AmGetTime}, {"SetTime", AmSetTime},
+	{"GetTimeFrames", AmGetTimeFrames}, {"SetTimeFrames", AmSetTimeFrames},
 	{"CheckPlaying", AmCheckPlaying},
+	{"GetEngineFrames", AmGetEngineFrames}, {"Snapshot", AmSnapshot},
+	{"AudioTimeAt", AmAudioTimeAt}, {"MonotonicAt", AmMonotonicAt},
+	{"GetMonotonicNs", AmGetMonotonicNs},
+	{"SetPlaybackRate", AmSetPlaybackRate}, {"SetPreviewRate", AmSetPreviewRate},
+	{"GetStats", AmGetStats}, {"GetMemoryStats", AmGetMemoryStats},
+	{"CreateOffline", AmCreateOffline}, {"ReleaseOffline", AmReleaseOffline},
+	{"OfflineAddUnit", AmOfflineAddUnit}, {"OfflineRender", AmOfflineRender},
+	{"OfflinePoll", AmOfflinePoll},
+	{"BuildWaveform", AmBuildWaveform}, {"ReleaseWaveform", AmReleaseWaveform},
+	{"WaveformRange", AmWaveformRange},
+	{"EnableAnalyzer", AmEnableAnalyzer}, {"DisableAnalyzer", AmDisableAnalyzer},
+	{"GetSpectrum", AmGetSpectrum},
+	{"AnalyzeRhythm", AmAnalyzeRhythm},
+	{0, 0}
+};
+constexpr luaL_reg AmResourceMethods[] = {
+	{"release", AmReleaseResource}, {"loudness", AmGetLoudness},
+	{"unit", AmCreateUnit}, {"waveform", AmBuildWaveform},
+	{"rhythm", AmAnalyzeRhythm},
+	{0, 0}
+};
+constexpr luaL_reg AmUnitMethods[] = {
+	{"release", AmReleaseUnit},
+	{"play", AmPlayUnit}, {"stop", AmStopUnit},
+	{"time", AmGetTime}, {"set_time", AmSetTime},
+	{"frames", AmGetTimeFrames}, {"set_frames", AmSetTimeFrames},
+	{"snapshot", AmSnapshot},
+	{"playing", AmCheckPlaying},
+	{"analyze", AmEnableAnalyzer},
+	{0, 0}
+};
+constexpr luaL_reg AmOfflineMethods[] = {
+	{"release", AmReleaseOffline},
+	{"add", AmOfflineAddUnit}, {"render", AmOfflineRender},
+	{"poll", AmOfflinePoll},
+	{0, 0}
+};
+constexpr luaL_reg AmWaveformMethods[] = {
+	{"release", AmReleaseWaveform}, {"range", AmWaveformRange},
 	{0, 0}
 };
 
-inline dmExtension::Result AmInit(dmExtension::Params* p) {
-	// Init the Preview Engine, with Default Behaviors
-	if( ma_engine_init(nullptr, &PreviewEngine) != MA_SUCCESS ) {
-		dmLogFatal("Failed to Init the miniaudio Engine \"Preview\".");
-		return dmExtension::RESULT_INIT_ERROR;
-	}
-	PreviewRM = ma_engine_get_resource_manager(&PreviewEngine);
-
-	// Init the Player Engine: a custom resource manager
-	const auto device = ma_engine_get_device(&PreviewEngine);   // The default device info
-	auto rm_config		= ma_resource_manager_config_init();
-		 rm_config.decodedFormat			= device -> playback.format;
-		 rm_config.decodedChannels			= device -> playback.channels;
-		 rm_config.decodedSampleRate		= device -> sampleRate;
-	if( ma_resource_manager_init(&rm_config, &player_rm) != MA_SUCCESS) {
-		dmLogFatal("Failed to Init the miniaudio Resource Manager \"PlayerRM\".");
-		return dmExtension::RESULT_INIT_ERROR;
-	}
-	PlayerRM = &player_rm;
+static void AmRegisterHandle(lua_State* L, AmHandleType type, const char* name, const luaL_reg* methods, lua_CFunction collect) {
+	luaL_newmetatable(L, name);
+	lua_newtable(L);
+	luaL_register(L, nullptr, methods);
+	lua_setfield(L, -2, "__index");
+	lua_pushcfunction(L, collect);
+	lua_setfield(L, -2, "__gc");
+	AmMetatables[type] = luaL_ref(L, LUA_REGISTRYINDEX);
+}
 
-	// Init the Player Engine: a custom engine config
-	auto engine_config			= ma_engine_config_init();
-		 engine_config.pResourceManager		= PlayerRM;
-	if( ma_engine_init(&engine_config, &PlayerEngine) != MA_SUCCESS ) {
-		dmLogFatal("Failed to Init the miniaudio Engine \"Player\".");
+inline dmExtension::Result AmInit(dmExtension::Params* p) {
+	// Optional [acaudio] entries of game.project, see README
+	AcAudio::Config config;
+	const auto threads = dmConfigFile::GetInt(p->m_ConfigFile, "acaudio.job_threads", 0);
+	const auto preview_threads = dmConfigFile::GetInt(p->m_ConfigFile, "acaudio.preview_job_threads", 1);
+	const auto capacity = dmConfigFile::GetInt(p->m_ConfigFile, "acaudio.job_queue_capacity", 1024);
+	config.JobThreads = (threads > 0) ? (uint32_t)threads : 0;
+	config.PreviewJobThreads = (uint32_t)std::max(1, preview_threads);
+	config.JobQueueCapacity = (uint32_t)std::max(16, capacity);
+
+	// Thread Scheduling: audio_priority 0/1/2 = OS default/high/real-time, job_priority -1/0 = lower/normal
+	config.AudioPriority = dmConfigFile::GetInt(p->m_ConfigFile, "acaudio.audio_priority", AM_PRIORITY_REALTIME);
+	config.JobPriority = dmConfigFile::GetInt(p->m_ConfigFile, "acaudio.job_priority", AM_PRIORITY_LOW);
+	config.AudioBigCores = dmConfigFile::GetInt(p->m_ConfigFile, "acaudio.audio_big_cores", 1) != 0;
+
+	const char* error = nullptr;
+	if( !AcAudio::Init(config, error) ) {
+		dmLogFatal("%s", error);
 		return dmExtension::RESULT_INIT_ERROR;
 	}
+	if( !std::atomic<uint64_t>().is_lock_free() )   // Unit positions & the bus clock, shared with the audio thread by the gameplay calls
+		dmLogWarning("64-bit atomics are not lock-free here; GetTime & PlayUnit may contend with the audio thread.");
 
 	// Lua Registration
+	AmRegisterHandle(p->m_L, AM_HANDLE_RESOURCE, "AcAudio.Resource", AmResourceMethods, AmCollect<AM_HANDLE_RESOURCE>);
+	AmRegisterHandle(p->m_L, AM_HANDLE_UNIT, "AcAudio.Unit", AmUnitMethods, AmCollect<AM_HANDLE_UNIT>);
+	AmRegisterHandle(p->m_L, AM_HANDLE_OFFLINE, "AcAudio.Offline", AmOfflineMethods, AmCollect<AM_HANDLE_OFFLINE>);
+	AmRegisterHandle(p->m_L, AM_HANDLE_WAVEFORM, "AcAudio.Waveform", AmWaveformMethods, AmCollect<AM_HANDLE_WAVEFORM>);
 	luaL_register(p->m_L, "AcAudio", AmFuncs);
+	lua_rawgeti(p->m_L, LUA_REGISTRYINDEX, AmMetatables[AM_HANDLE_UNIT]);   // For lua/acaudio_fast.lua, to tell unit handles apart
+	lua_setfield(p->m_L, -2, "UnitMetatable");
 	lua_pop(p->m_L, 1);
 	return dmExtension::RESULT_OK;
 }
 
 inline void AmOnEvent(dmExtension::Params* p, const dmExtension::Event* e) {
-	switch(e->m_Event) {   // PreviewSound won't be nullptr when playing
+	switch(e->m_Event) {
 		case dmExtension::EVENT_ID_ICONIFYAPP:
-		case dmExtension::EVENT_ID_ACTIVATEAPP: {
-			if( (PreviewPlaying) && !ma_sound_is_playing(PreviewSound) )
-				ma_sound_start(PreviewSound);
-			if( !PlayerUnits.empty() )
-				for(auto it = PlayerUnits.cbegin(); it != PlayerUnits.cend(); ++it) {
-					auto& UH = it->first;
-					if( (it->second) && !ma_sound_is_playing(UH) )
-						ma_sound_start(UH);
-				}
-		}
+		case dmExtension::EVENT_ID_ACTIVATEAPP:
+			AcAudio::Resume();
 		break;
 
 		case dmExtension::EVENT_ID_DEICONIFYAPP:
-		case dmExtension::EVENT_ID_DEACTIVATEAPP: {   // Sounds won't rewind when "stopping"
-			if(PreviewPlaying)
-				if( ma_sound_is_playing(PreviewSound) )
-					ma_sound_stop(PreviewSound);
-				else
-					PreviewPlaying = false;
-			if( !PlayerUnits.empty() )
-				for(auto it = PlayerUnits.begin(); it != PlayerUnits.end(); ++it) {
-					auto& UH = it->first;   // Abandoned the const iterator
-					if(it->second)
-						if( ma_sound_is_playing(UH) )
-							ma_sound_stop(UH);
-						else
-							it->second = false;
-				}
-		}
+		case dmExtension::EVENT_ID_DEACTIVATEAPP:
+			AcAudio::Suspend();
 
 		default:;   // break omitted
 	}
 }
 
-inline dmExtension::Result AmFinal(dmExtension::Params* p) {
-	// Close Exisiting Units(miniaudio sounds)
-	if(PreviewSound) {
-		ma_sound_stop(PreviewSound);
-		ma_sound_uninit(PreviewSound);
-	}
-	if( !PlayerUnits.empty() )   // No free() calls since it's the finalizer
-		for(auto it = PlayerUnits.cbegin(); it != PlayerUnits.cend(); ++it) {
-			ma_sound_stop(it->first);
-			ma_sound_uninit(it->first);
-		}
-
-	// Close Existing Resources(miniaudio data sources)
-	if(PreviewResource)
-		ma_resource_manager_data_source_uninit(PreviewResource);
-	if( !PlayerResources.empty() )
-		for(auto it = PlayerResources.cbegin(); it != PlayerResources.cend(); ++it)
-			ma_resource_manager_data_source_uninit(it->first);
-
-	// Uninit (miniaudio)Engines; resource managers will be uninitialized automatically here.
-	ma_engine_uninit(&PreviewEngine);
-	ma_engine_uninit(&PlayerEngine);
+inline dmExtension::Result AmUpdate(dmExtension::Params* p) {
+	AmReleaseGarbage();
+	if( !AcAudio::Update() )
+		dmLogFatal("Failed to Re-init the miniaudio Engine \"Player\".");
+	return dmExtension::RESULT_OK;
+}
 
-	// No further cleranup since it's the finalizer
+inline dmExtension::Result AmFinal(dmExtension::Params* p) {
+	AcAudio::Final();   // Outdates every handle, so later collections are no-ops
+	for(auto& G : AmGarbage)
+		G.clear();
+	AmUnpinPreview(p->m_L);
 	return dmExtension::RESULT_OK;
 }
 
 inline dmExtension::Result AmAPPOK(dmExtension::AppParams* params) { return dmExtension::RESULT_OK; }
-DM_DECLARE_EXTENSION(AcAudio, "AcAudio", AmAPPOK, AmAPPOK, AmInit, nullptr, AmOnEvent, AmFinal)
+DM_DECLARE_EXTENSION(AcAudio, "AcAudio", AmAPPOK, AmAPPOK, AmInit, AmUpdate, AmOnEvent, AmFinal)
@@ -0,0 +1,52 @@
+/* Aerials Audio Handles */
+#pragma once
+
+// The block behind every Lua handle, and the FFI exports over it, with no dmsdk & Lua dependency:
+// included by ext.cpp, and by bench/bench_ffi.cpp, which times the exports natively. Include it once per program.
+
+/* Includes */
+#include "core.h"
+
+
+/* Handles */
+enum AmHandleType { AM_HANDLE_RESOURCE, AM_HANDLE_UNIT, AM_HANDLE_OFFLINE, AM_HANDLE_WAVEFORM, AM_HANDLE_TYPES };
+struct AmHandle {
+	void* Ptr;   // nullptr once released
+	uint32_t Generation;   // AcAudio::Generation() when created
+	uint32_t Type;   // AmHandleType, for the FFI functions, which can't see metatables
+};
+
+
+/* FFI Fast Path */
+// Plain C functions over unit handles, for ffi.C on LuaJIT (see lua/acaudio_fast.lua), so that hot loops stay in JIT traces.
+// LuaJIT passes a userdata as the address of its block, so H can't be checked here: the shim only passes values whose
+// metatable is AcAudio.UnitMetatable, i.e. blocks allocated as AmHandles by ext.cpp. Type & Generation catch the rest.
+#if defined(_WIN32)
+	#define AM_FFI extern "C" __declspec(dllexport)
+#else
+	#define AM_FFI extern "C" __attribute__((visibility("default"), used))
+#endif
+
+static inline AmUnit* AmFfiUnit(const AmHandle* H) {
+	return ( H && H -> Type == AM_HANDLE_UNIT && H -> Ptr && H -> Generation == AcAudio::Generation() ) ? (AmUnit*)H -> Ptr : nullptr;
+}
+AM_FFI int AcAudioFfiPlayUnit(const AmHandle* H, int is_looping, double delay_ms) {   // 1 if OK
+	const auto U = AmFfiUnit(H);
+	return U && AcAudio::PlayUnit(U, is_looping != 0, delay_ms);
+}
+AM_FFI int AcAudioFfiStopUnit(const AmHandle* H, int rewind) {   // 1 if OK
+	const auto U = AmFfiUnit(H);
+	return U && AcAudio::StopUnit(U, rewind != 0);
+}
+AM_FFI int AcAudioFfiCheckPlaying(const AmHandle* H) {   // -1 for an invalid handle
+	const auto U = AmFfiUnit(H);
+	return U ? AcAudio::CheckPlaying(U) : -1;
+}
+AM_FFI double AcAudioFfiGetTime(const AmHandle* H) {   // -1 for an invalid handle
+	const auto U = AmFfiUnit(H);
+	return U ? AcAudio::GetTime(U) : -1.0;
+}
+AM_FFI int64_t AcAudioFfiGetTimeFrames(const AmHandle* H) {   // -1 for an invalid handle
+	const auto U = AmFfiUnit(H);
+	return U ? (int64_t)AcAudio::GetTimeFrames(U) : -1;
+}
@@ -0,0 +1,56 @@
+/* Aerials Audio Core Tests */
+#pragma once
+
+// Shared by the tests under tests/, each of which includes core.cpp first and runs on the null backend.
+// A failed check prints itself and exits with 1; 77 tells ctest that a test got skipped.
+
+/* Includes */
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+
+/* Checks */
+#define AM_CHECK(x) do { \
+	if( !(x) ) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+		exit(1); \
+	} \
+} while(0)
+constexpr int AM_TEST_SKIP = 77;
+
+inline void AmTestSleep(int ms) {
+	std::this_thread::sleep_for( std::chrono::milliseconds(ms) );
+}
+
+
+/* Test Audio */
+// 16-bit PCM WAV files in memory; fn(frame, channel) returns samples in [-1, 1]
+template<typename F>
+std::vector<uint8_t> AmTestWav(uint32_t frames, uint32_t channels, uint32_t rate, const F& fn) {
+	const uint32_t bytes = frames * channels * 2;
+	std::vector<uint8_t> wav(44 + bytes);
+	const auto put = [&wav](size_t at, uint32_t v, int n) {
+		for(int i = 0; i < n; i++)
+			wav[at + i] = (uint8_t)( v >> (8 * i) );
+	};
+	memcpy(&wav[0], "RIFF", 4);		put(4, 36 + bytes, 4);		memcpy(&wav[8], "WAVE", 4);
+	memcpy(&wav[12], "fmt ", 4);	put(16, 16, 4);		put(20, 1, 2);		put(22, channels, 2);
+	put(24, rate, 4);				put(28, rate * channels * 2, 4);		put(32, channels * 2, 2);		put(34, 16, 2);
+	memcpy(&wav[36], "data", 4);	put(40, bytes, 4);
+	for(uint32_t f = 0; f < frames; f++)
+		for(uint32_t c = 0; c < channels; c++) {
+			auto x = fn(f, c);
+			x = (x < -1.0f) ? -1.0f : (x > 1.0f) ? 1.0f : x;
+			put( 44 + (f * channels + c) * 2, (uint32_t)(uint16_t)(int16_t)lrintf(x * 32767.0f), 2 );
+		}
+	return wav;
+}
+inline std::vector<uint8_t> AmTestSine(uint32_t frames, uint32_t channels, uint32_t rate, float hz, float amplitude = 0.5f) {
+	return AmTestWav( frames, channels, rate, [=](uint32_t f, uint32_t) { return amplitude * sinf(6.2831853f * hz * f / rate); } );
+}
@@ -0,0 +1,105 @@
+/* IMA-ADPCM Tests */
+// Encode/decode round trips within an error bound, and compact voices mixed through the bus's block cache.
+#include "core.cpp"
+#include "test.h"
+
+static AmADPCM* Encode(const std::vector<float>& pcm, ma_uint32 C, ma_uint32 rate) {
+	ma_audio_buffer_ref ref;
+	AM_CHECK( ma_audio_buffer_ref_init(ma_format_f32, C, pcm.data(), pcm.size() / C, &ref) == MA_SUCCESS );
+	ref.sampleRate = rate;
+	const auto A = AmADPCMEncode(&ref);
+	ma_audio_buffer_ref_uninit(&ref);
+	AM_CHECK(A);
+	return A;
+}
+static std::vector<float> Decode(const AmADPCM* A) {
+	const auto C = A -> Channels;
+	const auto blocks = (A -> Frames + AM_ADPCM_BLOCK - 1) / AM_ADPCM_BLOCK;
+	std::vector<float> out(blocks * AM_ADPCM_BLOCK * C);
+	for(ma_uint64 b = 0; b < blocks; b++)
+		AmADPCMDecode(A, b, &out[b * AM_ADPCM_BLOCK * C]);
+	out.resize(A -> Frames * C);
+	return out;
+}
+
+template<typename F>
+static void CheckRoundTrip(const char* name, ma_uint32 frames, ma_uint32 C, double min_snr_db, const F& fn) {
+	const ma_uint32 rate = 48000;
+	std::vector<float> pcm(frames * C);
+	for(ma_uint32 f = 0; f < frames; f++)
+		for(ma_uint32 c = 0; c < C; c++)
+			pcm[f * C + c] = fn(f, c);
+	const auto A = Encode(pcm, C, rate);
+	AM_CHECK(A -> Frames == frames && A -> Channels == C && A -> SampleRate == rate);
+	AM_CHECK( A -> Blocks.size() == (frames + AM_ADPCM_BLOCK - 1) / AM_ADPCM_BLOCK * AmADPCMStride(C) );
+
+	const auto out = Decode(A);
+	double signal = 0.0, noise = 0.0, worst = 0.0;
+	for(size_t i = 0; i < pcm.size(); i++) {
+		const double e = out[i] - pcm[i];
+		signal += pcm[i] * (double)pcm[i];
+		noise += e * e;
+		worst = std::max(worst, fabs(e));
+	}
+	const auto snr = 10.0 * log10( std::max(signal, 1e-30) / std::max(noise, 1e-30) );
+	printf("%s: %.1f dB SNR, %.4f worst error\n", name, snr, worst);
+	AM_CHECK(noise == 0.0 || snr >= min_snr_db);
+	AM_CHECK(worst <= 0.25);
+	AmADPCMFree(A);
+}
+
+int main() {
+	// Round trips; partial last blocks included
+	CheckRoundTrip("sine", 48000 + 100, 2, 40.0, [](ma_uint32 f, ma_uint32 c) {
+		return 0.5f * sinf(6.2831853f * (c ? 220.0f : 440.0f) * f / 48000.0f);
+	});
+	CheckRoundTrip("chirp", 48000, 1, 20.0, [](ma_uint32 f, ma_uint32) {
+		const float t = f / 48000.0f;
+		return 0.7f * sinf(6.2831853f * (100.0f + 4000.0f * t) * t);
+	});
+	CheckRoundTrip("attacks", AM_ADPCM_BLOCK * 40 + 7, 2, 20.0, [](ma_uint32 f, ma_uint32 c) {   // A loud burst every other block, from its header
+		const auto i = f % (2 * AM_ADPCM_BLOCK);
+		return (i >= AM_ADPCM_BLOCK) ? 0.0f : 0.9f * expf(-(float)i / 40.0f) * sinf(0.3f * i + 1.0f + c);
+	});
+	CheckRoundTrip("silence", 1000, 1, 0.0, [](ma_uint32, ma_uint32) { return 0.0f; });   // Exact
+
+	// Two compact voices on the bus, each mixing exactly its own decoded frames
+	AcAudio::Config config;
+	const char* error = nullptr;
+	AM_CHECK( AcAudio::Init(config, error) );
+	const auto rate = ma_engine_get_sample_rate(&PlayerEngine);
+	const auto C = ma_engine_get_channels(&PlayerEngine);
+	AmResource* R[2];
+	AmUnit* U[2];
+	for(int i = 0; i < 2; i++) {
+		const auto wav = AmTestSine(rate / 2 + 77, 2, rate, i ? 330.0f : 550.0f, 0.4f);
+		R[i] = AcAudio::CreateResource(wav.data(), wav.size(), false, 0.0, true, error);
+		AM_CHECK(R[i] && R[i] -> Compact);
+		AM_CHECK(R[i] -> Compact -> Channels == C);
+		double length_ms;
+		U[i] = AcAudio::CreateUnit(R[i], length_ms);
+	}
+	AM_CHECK(R[0] -> Compact -> Serial != R[1] -> Compact -> Serial);
+	ma_engine_stop(&PlayerEngine);
+	AmApplyCommands();
+	AM_CHECK( AcAudio::SetTimeFrames(U[1], 1000) );   // Off the block grid
+	for(auto u : U)
+		AM_CHECK( AcAudio::PlayUnit(u, false, 0.0) );
+	AmApplyCommands();
+
+	const auto a = Decode(R[0] -> Compact), b = Decode(R[1] -> Compact);
+	const ma_uint32 n = 1000;   // Not a multiple of the chunk or the block
+	std::vector<float> out(n * C);
+	for(ma_uint64 at = 0; at + n <= R[0] -> Compact -> Frames; at += n) {
+		ma_uint64 read;
+		AM_CHECK( ma_data_source_read_pcm_frames(&PlayerBus, out.data(), n, &read) == MA_SUCCESS && read == n );
+		for(ma_uint32 k = 0; k < n * C; k++) {
+			const auto i = at * C + k, j = (at + 1000) * C + k;
+			const float expected = R[0] -> Gain * a[i] + ( (j < b.size()) ? R[1] -> Gain * b[j] : 0.0f );
+			AM_CHECK( fabsf(out[k] - expected) <= 1e-6f );
+		}
+	}
+	AcAudio::Final();
+	puts("adpcm: OK");
+	return 0;
+}
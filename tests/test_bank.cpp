@@ -0,0 +1,106 @@
+/* Sound Bank Tests */
+// A bank written by BuildBank loads back, & truncated or corrupt copies of it are refused by LoadBank instead of mapped.
+#include "core.cpp"
+#include "test.h"
+
+static const char* AM_TEST_BANK = "test_bank.amb";   // In the working directory, i.e. the build tree under ctest
+
+static std::vector<uint8_t> AmTestRead(const char* path) {
+	std::vector<uint8_t> out;
+	const auto f = fopen(path, "rb");
+	AM_CHECK(f);
+	uint8_t buf[4096];
+	size_t n;
+	while( (n = fread(buf, 1, sizeof(buf), f)) > 0 )
+		out.insert(out.end(), buf, buf + n);
+	fclose(f);
+	return out;
+}
+static void AmTestWrite(const char* path, const std::vector<uint8_t>& data) {
+	const auto f = fopen(path, "wb");
+	AM_CHECK(f);
+	AM_CHECK( fwrite(data.data(), 1, data.size(), f) == data.size() );
+	fclose(f);
+}
+
+// Writes data as the bank, & checks that LoadBank refuses it without creating anything
+static void AmTestRefused(const std::vector<uint8_t>& data) {
+	AmTestWrite(AM_TEST_BANK, data);
+	std::vector<AcAudio::BankItem> items;
+	const char* error = nullptr;
+	const auto before = PlayerResources.size();
+	AM_CHECK( !AcAudio::LoadBank(AM_TEST_BANK, items, error) );
+	AM_CHECK( error && strcmp(error, "[!] Not a valid bank file") == 0 );
+	AM_CHECK( items.empty() && PlayerResources.size() == before );
+}
+
+// Entry i of a bank image, patched in place
+template<typename F>
+std::vector<uint8_t> AmTestPatch(std::vector<uint8_t> data, uint32_t i, const F& fn) {
+	AmBankEntry E;
+	const auto at = sizeof(AmBankHeader) + i * sizeof(AmBankEntry);
+	memcpy(&E, &data[at], sizeof(E));
+	fn(E);
+	memcpy(&data[at], &E, sizeof(E));
+	return data;
+}
+
+int main() {
+	AcAudio::Config config;
+	const char* error = nullptr;
+	AM_CHECK( AcAudio::Init(config, error) );
+	const auto rate = ma_engine_get_sample_rate(&PlayerEngine);
+
+	// Two entries, built & loaded back
+	const auto a = AmTestSine(rate / 4, 2, rate, 440.0f);
+	const auto b = AmTestSine(rate / 8, 2, rate, 880.0f);
+	const auto Ra = AcAudio::CreateResource(a.data(), a.size(), false, 0.0, false, error);
+	const auto Rb = AcAudio::CreateResource(b.data(), b.size(), false, 0.0, false, error);
+	AM_CHECK(Ra && Rb);
+	AM_CHECK( AcAudio::BuildBank(AM_TEST_BANK, { {1, Ra}, {2, Rb} }, error) );
+	std::vector<AcAudio::BankItem> items;
+	AM_CHECK( AcAudio::LoadBank(AM_TEST_BANK, items, error) );
+	AM_CHECK( items.size() == 2 && items[0].NameHash == 1 && items[1].NameHash == 2 );
+	double length_ms = 0.0;
+	const auto U = AcAudio::CreateUnit(items[1].Resource, length_ms);
+	AM_CHECK( U && fabs(length_ms - 125.0) <= 1.0 );
+	AM_CHECK( AcAudio::ReleaseUnit(U) );
+	for(const auto& item : items)
+		AcAudio::ReleaseResource(item.Resource);
+	AM_CHECK( AcAudio::Update() );
+	const auto bank = AmTestRead(AM_TEST_BANK);
+
+	// Truncated: within the header, within the index, & short of the last entry's PCM by one sample
+	AmTestRefused( std::vector<uint8_t>(bank.begin(), bank.begin() + 8) );
+	AmTestRefused( std::vector<uint8_t>(bank.begin(), bank.begin() + sizeof(AmBankHeader) + sizeof(AmBankEntry)) );
+	AmTestRefused( std::vector<uint8_t>(bank.begin(), bank.end() - sizeof(float)) );
+
+	// Corrupt entries
+	AmTestRefused( AmTestPatch(bank, 0, [](AmBankEntry& E) { E.Channels = 0; }) );
+	AmTestRefused( AmTestPatch(bank, 0, [](AmBankEntry& E) { E.Channels = MA_MAX_CHANNELS + 1;	E.Frames = 1; }) );   // Would fit the file
+	AmTestRefused( AmTestPatch(bank, 0, [](AmBankEntry& E) { E.Channels = 0x40000000; }) );   // Channels * 4 wraps in 32 bits
+	AmTestRefused( AmTestPatch(bank, 1, [](AmBankEntry& E) { E.Frames = ~0ull / 4; }) );   // Frames * Channels * 4 wraps in 64 bits
+	AmTestRefused( AmTestPatch(bank, 1, [](AmBankEntry& E) { E.Frames = 0; }) );
+	AmTestRefused( AmTestPatch(bank, 1, [](AmBankEntry& E) { E.Offset = 0; }) );   // Over the header & index
+	AmTestRefused( AmTestPatch(bank, 1, [](AmBankEntry& E) { E.Offset = ~0ull - AM_BANK_ALIGN + 1; }) );
+	AmTestRefused( AmTestPatch(bank, 1, [](AmBankEntry& E) { E.Format = ma_format_s16; }) );
+
+	// Corrupt header: a count past the index
+	auto count = bank;
+	count[8] = 0xFF;
+	AmTestRefused(count);
+
+	// The intact copy still loads
+	AmTestWrite(AM_TEST_BANK, bank);
+	AM_CHECK( AcAudio::LoadBank(AM_TEST_BANK, items, error) );
+	for(const auto& item : items)
+		AcAudio::ReleaseResource(item.Resource);
+	remove(AM_TEST_BANK);
+
+	AcAudio::ReleaseResource(Ra);
+	AcAudio::ReleaseResource(Rb);
+	AM_CHECK( AcAudio::Update() );
+	AcAudio::Final();
+	puts("bank: OK");
+	return 0;
+}
@@ -0,0 +1,82 @@
+/* Player Clock Tests */
+// The fitted line over synthetic callbacks, with no device: nothing until 2 callbacks, the nominal rate until the fit
+// takes over, a drifting device clock followed, out-of-range & non-finite values refused, and resets.
+#include "core.cpp"
+#include "test.h"
+
+constexpr uint32_t RATE = 48000, PERIOD = 480;
+
+static void Feed(uint32_t callbacks, double actual_rate, uint64_t& ns, uint64_t& frames) {   // Periods handed at actual_rate
+	for(uint32_t i = 0; i < callbacks; i++) {
+		AmClockUpdate(PlayerClock, ns, frames, RATE);
+		frames += PERIOD;
+		ns += (uint64_t)llround(PERIOD / actual_rate * 1e9);
+	}
+}
+
+static double LineRate() {   // As Snapshot's ClockRate
+	uint64_t ns;
+	double frames, rate;
+	AmClockLine(ns, frames, rate);
+	return rate;
+}
+
+int main() {
+	uint64_t ns = 5000000000ull, frames = 0, back;
+	double at;
+
+	// Nothing before 2 callbacks, & no division by a zero rate
+	AM_CHECK( !AcAudio::AudioTimeAt(ns, at) );
+	AM_CHECK( !AcAudio::MonotonicAt(0.0, back) );
+	AM_CHECK( LineRate() == 0.0 );
+	Feed(1, RATE, ns, frames);
+	AM_CHECK( !AcAudio::AudioTimeAt(ns, at) );
+	AM_CHECK( !AcAudio::MonotonicAt(0.0, back) );
+
+	// The nominal rate from 2 callbacks on
+	Feed(1, RATE, ns, frames);
+	AM_CHECK( AcAudio::AudioTimeAt(ns, at) );
+	AM_CHECK( fabs(at - frames) <= 1.0 );
+	AM_CHECK( LineRate() == RATE );
+
+	// A device clock running 200ppm fast, followed once fitted
+	const double actual = RATE * 1.0002;
+	Feed(1000, actual, ns, frames);
+	const auto rate = LineRate();
+	AM_CHECK( fabs(rate - actual) <= 0.5 );
+	AM_CHECK( AcAudio::AudioTimeAt(ns + 1000000000ull, at) );
+	AM_CHECK( fabs(at - (frames + actual)) <= 1.0 );
+	AM_CHECK( AcAudio::MonotonicAt(at, back) );
+	AM_CHECK( llabs((long long)(back - (ns + 1000000000ull))) <= 1000 );
+
+	// Out of range & non-finite values
+	AM_CHECK( !AcAudio::MonotonicAt(NAN, back) );
+	AM_CHECK( !AcAudio::MonotonicAt(INFINITY, back) );
+	AM_CHECK( !AcAudio::MonotonicAt(-1e18, back) );   // Before the clock's epoch
+	AM_CHECK( !AcAudio::MonotonicAt(1e30, back) );
+	AM_CHECK( AcAudio::MonotonicAt(0.0, back) && back < ns );
+
+	// A gap restarts the fit, & a reset drops the line
+	ns += 1000000000ull;
+	Feed(1, RATE, ns, frames);
+	AM_CHECK( !AcAudio::AudioTimeAt(ns, at) );
+	Feed(1, RATE, ns, frames);
+	AM_CHECK( AcAudio::AudioTimeAt(ns, at) );
+	AmClockReset(PlayerClock);
+	AM_CHECK( !AcAudio::AudioTimeAt(ns, at) );
+	AM_CHECK( LineRate() == 0.0 );
+
+	// Through a real device: a line after Init, none after Final
+	AcAudio::Config config;
+	const char* error = nullptr;
+	AM_CHECK( AcAudio::Init(config, error) );
+	for(int i = 0; i < 200 && !AcAudio::AudioTimeAt(AcAudio::GetMonotonicNs(), at); i++)
+		AmTestSleep(10);
+	AM_CHECK( AcAudio::AudioTimeAt(AcAudio::GetMonotonicNs(), at) );
+	AM_CHECK( AcAudio::TakeSnapshot(nullptr).ClockRate > 0.0 );
+	AcAudio::Final();
+	AM_CHECK( !AcAudio::AudioTimeAt(AcAudio::GetMonotonicNs(), at) );
+	AM_CHECK( AcAudio::GetEngineFrames() == 0 );
+	puts("clock: OK");
+	return 0;
+}
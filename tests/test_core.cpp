@@ -0,0 +1,82 @@
+/* Smoke Tests */
+// Init/Update/Final, a unit through create/play/stop, waveform ranges, and GetStats, as the Lua API drives them.
+#include "core.cpp"
+#include "test.h"
+
+int main() {
+	// Init
+	AcAudio::Config config;
+	const char* error = nullptr;
+	AM_CHECK( AcAudio::Init(config, error) );
+	AM_CHECK( AcAudio::Update() );
+	const auto rate = ma_engine_get_sample_rate(&PlayerEngine);
+	AM_CHECK(rate > 0);
+
+	// A half-second resource, & a unit of it
+	const auto wav = AmTestSine(rate / 2, 2, rate, 440.0f);
+	const auto R = AcAudio::CreateResource(wav.data(), wav.size(), false, 0.0, false, error);
+	AM_CHECK(R);
+	double length_ms = 0.0;
+	const auto U = AcAudio::CreateUnit(R, length_ms);
+	AM_CHECK(U);
+	AM_CHECK( fabs(length_ms - 500.0) <= 1.0 );
+	AM_CHECK( !AcAudio::CheckPlaying(U) );
+
+	// Play: the audio thread voices it & moves it on
+	AM_CHECK( AcAudio::PlayUnit(U, true, 0.0) );
+	AM_CHECK( AcAudio::CheckPlaying(U) );
+	for(int i = 0; i < 100 && AcAudio::GetTimeFrames(U) == 0; i++)
+		AmTestSleep(10);
+	AM_CHECK( AcAudio::GetTimeFrames(U) > 0 );
+	AM_CHECK( AcAudio::CheckPlaying(U) );
+	AM_CHECK( AcAudio::Update() );
+
+	// Stop & rewind
+	AM_CHECK( AcAudio::StopUnit(U, true) );
+	AM_CHECK( !AcAudio::CheckPlaying(U) );
+	for(int i = 0; i < 100 && U -> Voiced.load(); i++)
+		AmTestSleep(10);
+	AM_CHECK( !U -> Voiced.load() );
+	AM_CHECK( AcAudio::GetTimeFrames(U) == 0 );
+	AM_CHECK( AcAudio::SetTime(U, 1e9) );   // Clamped
+	AM_CHECK( AcAudio::SetTimeFrames(U, 1000) );
+
+	// Stats of the callbacks so far
+	AcAudio::EngineStats player, preview;
+	int job_priority;
+	AcAudio::GetStats(player, preview, job_priority, true);
+	AM_CHECK(player.Callbacks > 0);
+	AM_CHECK(player.Frames > 0);
+	AM_CHECK(player.PeakVoices >= 1);
+	AM_CHECK(preview.Callbacks > 0);
+	AcAudio::GetStats(player, preview, job_priority, false);
+	AM_CHECK(player.PeakVoices == 0);
+
+	AcAudio::MemoryStats memory;
+	AcAudio::GetMemoryStats(memory);
+	AM_CHECK(memory.Arenas[AM_MEM_PCM].Bytes >= (uint64_t)(rate / 2) * 2 * sizeof(float));
+
+	// Waveform columns, bounded
+	const auto W = AcAudio::BuildWaveform(R, error);
+	AM_CHECK(W);
+	std::vector<float> lo, hi, rms;
+	AM_CHECK( AcAudio::WaveformRange(W, 0.0, 500.0, 100, lo, hi, rms) && lo.size() == 100 && hi[50] > 0.4f );
+	AM_CHECK( !AcAudio::WaveformRange(W, 0.0, 500.0, 0, lo, hi, rms) );
+	AM_CHECK( !AcAudio::WaveformRange(W, 0.0, 500.0, AM_WAVE_COLUMNS_MAX + 1, lo, hi, rms) );
+	AcAudio::ReleaseWaveform(W);
+
+	// Release & Final: the resource outlives its unit until the audio thread retires it, and Update() frees both
+	AM_CHECK( AcAudio::ReleaseUnit(U) );
+	AcAudio::ReleaseResource(R);
+	for(int i = 0; i < 100; i++) {
+		AM_CHECK( AcAudio::Update() );
+		AcAudio::GetMemoryStats(memory);
+		if(memory.Arenas[AM_MEM_PCM].Bytes == 0)
+			break;
+		AmTestSleep(10);
+	}
+	AM_CHECK(memory.Arenas[AM_MEM_PCM].Bytes == 0);
+	AcAudio::Final();
+	puts("core: OK");
+	return 0;
+}
@@ -0,0 +1,70 @@
+/* Lifecycle Tests */
+// Init -> CreateUnit -> Final -> Init -> Update: Final frees units, resources & the bus, so that nothing stale gets mixed after a re-Init.
+#include "core.cpp"
+#include "test.h"
+
+static AmUnit* PlayOne(AmResource*& R) {
+	const char* error = nullptr;
+	const auto rate = ma_engine_get_sample_rate(&PlayerEngine);
+	const auto wav = AmTestSine(rate, 2, rate, 440.0f);
+	R = AcAudio::CreateResource(wav.data(), wav.size(), false, 0.0, false, error);
+	AM_CHECK(R);
+	double length_ms;
+	const auto U = AcAudio::CreateUnit(R, length_ms);
+	AM_CHECK(U);
+	AM_CHECK( AcAudio::PlayUnit(U, true, 0.0) );
+	for(int i = 0; i < 100 && !U -> Voiced.load(); i++)
+		AmTestSleep(10);
+	AM_CHECK( U -> Voiced.load() );
+	return U;
+}
+
+int main() {
+	AcAudio::Config config;
+	const char* error = nullptr;
+	AcAudio::MemoryStats memory;
+
+	// A voiced unit, a released resource still held by its unit, & an open chart at Final
+	AM_CHECK( AcAudio::Init(config, error) );
+	AcAudio::BeginChart();
+	AmResource *R, *R2;
+	PlayOne(R);
+	PlayOne(R2);
+	AcAudio::ReleaseResource(R2);
+
+	// A copy that can't be allocated fails alone, taking no ref on the open arena
+	const auto refs = ChartArena -> Refs;
+	const auto chunks = ChartArena -> Chunks.size();
+	AM_CHECK( !AcAudio::CreateResource(&refs, SIZE_MAX / 4, false, 0.0, false, error) );   // Never read
+	AM_CHECK( strcmp(error, "[!] Out of memory") == 0 );
+	std::vector<AmResource*> Rs;
+	AM_CHECK( !AcAudio::CreateResources({ {&refs, SIZE_MAX / 4} }, false, 0.0, false, Rs, error) );
+	AM_CHECK( Rs.size() == 1 && !Rs[0] && strcmp(error, "[!] Out of memory") == 0 );
+	AM_CHECK( ChartArena -> Refs == refs && ChartArena -> Chunks.size() == chunks );
+	AcAudio::Final();
+
+	AM_CHECK( PlayerUnits.empty() );
+	AM_CHECK( PlayerResources.empty() );
+	AM_CHECK( !PlayerBus.Head );
+	AM_CHECK( PlayerBus.Time.load() == 0 );
+	AM_CHECK( PlayerVoices.load() == 0 );
+	AM_CHECK( !ChartArena && !PreviewSound && !PreviewResource );
+	AcAudio::GetMemoryStats(memory);
+	AM_CHECK( memory.Arenas[AM_MEM_PCM].Bytes == 0 );
+	AM_CHECK( memory.Arenas[AM_MEM_ENCODED].Bytes == 0 );
+
+	// Again, from scratch: only the new unit gets mixed
+	AM_CHECK( AcAudio::Init(config, error) );
+	AM_CHECK( AcAudio::Update() );
+	AM_CHECK( !PlayerBus.Head );
+	AmResource* R3;
+	const auto U3 = PlayOne(R3);
+	AM_CHECK( AcAudio::Update() );
+	AM_CHECK( PlayerBus.Head == U3 && !U3 -> Next );
+	AM_CHECK( PlayerVoices.load() == 1 );
+	AM_CHECK( PlayerUnits.size() == 1 && PlayerResources.size() == 1 );
+
+	AcAudio::Final();
+	puts("lifecycle: OK");
+	return 0;
+}
@@ -0,0 +1,62 @@
+/* Preview Streams */
+// In-memory buffers stream in place through AmMemoryVFS, and no path from the API can make it read memory.
+#include "core.cpp"
+#include "test.h"
+
+int main() {
+	AcAudio::Config config;
+	const char* error = nullptr;
+	AM_CHECK( AcAudio::Init(config, error) );
+	const auto wav = AmTestSine(48000, 2, 48000, 440.0f);
+
+	// From memory: the VFS opens the registered buffer under its token
+	AM_CHECK( AcAudio::PlayPreview(wav.data(), wav.size(), true, false, 0.0) );
+	AM_CHECK(PreviewPlaying);
+	const auto token = AmMemory.Token.load();
+	AM_CHECK(token != 0);
+	AcAudio::StopPreview();
+	AM_CHECK(AmMemory.Token.load() == 0);
+
+	// Undecodable: nothing streams it, so it is unregistered at once, & the caller may free it.
+	// Repeated, since the failed stream used to be freed while its load job was still finishing with it
+	const std::vector<uint8_t> junk(4096, 0x5A);
+	for(int i = 0; i < 50; i++) {
+		AM_CHECK( !AcAudio::PlayPreview(junk.data(), junk.size(), false, false, 0.0) );
+		AM_CHECK( AmMemory.Token.load() == 0 && !PreviewPlaying );
+	}
+
+	// Forged memory paths: the old address syntax, a stale token, and anything else under "am://"
+	char path[64];
+	snprintf( path, sizeof(path), "am://%llx/%llx", (unsigned long long)(uintptr_t)wav.data(), (unsigned long long)wav.size() );
+	AM_CHECK( !AcAudio::PlayPreviewFromFile(path, false, false, 0.0) );
+	snprintf( path, sizeof(path), "am://%llu", (unsigned long long)token );
+	AM_CHECK( !AcAudio::PlayPreviewFromFile(path, false, false, 0.0) );
+	AM_CHECK( !AcAudio::PlayPreviewFromFile("am://41414141/ffff", false, false, 0.0) );
+	AM_CHECK( !PreviewPlaying );
+
+	// The VFS itself refuses unregistered tokens, even while a buffer is registered
+	AM_CHECK( AcAudio::PlayPreview(wav.data(), wav.size(), true, false, 0.0) );
+	ma_vfs_file file;
+	snprintf( path, sizeof(path), "am://%llu", (unsigned long long)token );
+	AM_CHECK( AmVFSOpen(nullptr, path, MA_OPEN_MODE_READ, &file) == MA_DOES_NOT_EXIST );
+	snprintf( path, sizeof(path), "am://%llux", (unsigned long long)AmMemory.Token.load() );
+	AM_CHECK( AmVFSOpen(nullptr, path, MA_OPEN_MODE_READ, &file) == MA_DOES_NOT_EXIST );
+	AM_CHECK( AmVFSOpen(nullptr, "am://0", MA_OPEN_MODE_READ, &file) == MA_DOES_NOT_EXIST );
+	AcAudio::StopPreview();
+
+	// From a file
+	const char* file_path = "acaudio_test_preview.wav";
+	const auto F = fopen(file_path, "wb");
+	AM_CHECK(F);
+	AM_CHECK( fwrite(wav.data(), 1, wav.size(), F) == wav.size() );
+	fclose(F);
+	AM_CHECK( AcAudio::PlayPreviewFromFile(file_path, false, true, -14.0) );
+	AM_CHECK(PreviewPlaying);
+	AcAudio::StopPreview();
+	AM_CHECK( !AcAudio::PlayPreviewFromFile("acaudio_test_missing.wav", false, false, 0.0) );
+	remove(file_path);
+
+	AcAudio::Final();
+	puts("preview: OK");
+	return 0;
+}
@@ -0,0 +1,166 @@
+/* Real-time Path Tests */
+// The Player callback (command application, AmBusRead over PCM & compact voices, the stretch) and the unit gameplay calls,
+// with malloc & friends and pthread_mutex_lock interposed: neither may allocate, free or lock once warmed up.
+#include "core.cpp"
+#include "test.h"
+#include <mutex>
+#if defined(__GLIBC__)
+	#include <dlfcn.h>
+	#include <pthread.h>
+#endif
+
+#if defined(__GLIBC__)
+// Interposers: counted on the thread that sets Counting only, & forwarded to glibc
+static thread_local bool Counting;
+static std::atomic<uint64_t> Allocs, Frees, Locks;
+typedef int (*AmLockFn)(pthread_mutex_t*);
+static AmLockFn NextLock, NextTryLock;   // Resolved on first use; the dynamic linker locks through glibc internals, not these
+
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* __libc_memalign(size_t, size_t);
+void __libc_free(void*);
+
+void* malloc(size_t n) {
+	if(Counting) Allocs++;
+	return __libc_malloc(n);
+}
+void* calloc(size_t n, size_t sz) {
+	if(Counting) Allocs++;
+	return __libc_calloc(n, sz);
+}
+void* realloc(void* p, size_t n) {
+	if(Counting) Allocs++;
+	return __libc_realloc(p, n);
+}
+void* memalign(size_t align, size_t n) {
+	if(Counting) Allocs++;
+	return __libc_memalign(align, n);
+}
+void* aligned_alloc(size_t align, size_t n) {
+	if(Counting) Allocs++;
+	return __libc_memalign(align, n);
+}
+int posix_memalign(void** p, size_t align, size_t n) {
+	if(Counting) Allocs++;
+	*p = __libc_memalign(align, n);
+	return *p ? 0 : ENOMEM;
+}
+void free(void* p) {
+	if(Counting && p) Frees++;
+	__libc_free(p);
+}
+int pthread_mutex_lock(pthread_mutex_t* m) {
+	if(!NextLock)
+		NextLock = (AmLockFn)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+	if(Counting) Locks++;
+	return NextLock(m);
+}
+int pthread_mutex_trylock(pthread_mutex_t* m) {
+	if(!NextTryLock)
+		NextTryLock = (AmLockFn)dlsym(RTLD_NEXT, "pthread_mutex_trylock");
+	if(Counting) Locks++;
+	return NextTryLock(m);
+}
+}
+
+static uint64_t TaggedAllocations() {   // Through the tagged miniaudio callbacks
+	uint64_t n = 0;
+	for(auto& A : AmArenas)
+		n += A.Allocations.load();
+	return n;
+}
+
+int main() {
+	// The interposers see this thread's calls
+	{
+		std::mutex m;
+		Counting = true;
+		void* volatile p = malloc(16);
+		free(p);
+		m.lock();
+		m.unlock();
+		Counting = false;
+		AM_CHECK(Allocs.load() == 1 && Frees.load() == 1 && Locks.load() == 1);
+		Allocs = Frees = Locks = 0;
+	}
+
+	AcAudio::Config config;
+	const char* error = nullptr;
+	AM_CHECK( AcAudio::Init(config, error) );
+	const auto rate = ma_engine_get_sample_rate(&PlayerEngine);
+	const auto channels = ma_engine_get_channels(&PlayerEngine);
+
+	// A PCM & a compact resource, with a unit each, looping
+	const auto wav = AmTestSine(rate, 2, rate, 440.0f);
+	AmResource* R[2];
+	AmUnit* U[2];
+	for(int i = 0; i < 2; i++) {
+		R[i] = AcAudio::CreateResource(wav.data(), wav.size(), false, 0.0, i == 1, error);
+		AM_CHECK(R[i]);
+		double length_ms;
+		U[i] = AcAudio::CreateUnit(R[i], length_ms);
+		AM_CHECK(U[i]);
+	}
+	AM_CHECK(R[1] -> Compact);
+
+	// This thread plays the device from now on
+	ma_engine_stop(&PlayerEngine);
+	const auto device = ma_engine_get_device(&PlayerEngine);
+	const ma_uint32 frames = 480;
+	std::vector<float> out(frames * channels);
+	const auto callback = [&]() { AmDataCallback(device, out.data(), nullptr, frames); };
+
+	for(float speed : {1.0f, 1.25f}) {
+		AcAudio::SetPlaybackRate(speed);
+		for(auto u : U)
+			AM_CHECK( AcAudio::PlayUnit(u, true, 0.0) );
+		for(int i = 0; i < 8; i++)   // Warm up: thread scheduling, the stretch, the first voices
+			callback();
+		AM_CHECK( PlayerVoices.load() == 2 );
+
+		const auto tagged = TaggedAllocations();
+		Counting = true;
+		for(int i = 0; i < 200; i++) {
+			const auto u = U[i & 1];
+			double ms = AcAudio::GetTime(u);
+			(void)ms;
+			(void)AcAudio::GetTimeFrames(u);
+			(void)AcAudio::CheckPlaying(u);
+			if(i % 10 == 0) {
+				AcAudio::StopUnit(u, i % 20 == 0);
+				AcAudio::SetTime(u, 100.0);
+				AcAudio::PlayUnit(u, true, (i % 30 == 0) ? 5.0 : 0.0);
+			}
+			callback();
+		}
+		Counting = false;
+		fprintf(stderr, "rate %.2f: %llu allocations, %llu frees, %llu locks, %llu tagged\n", speed,
+			(unsigned long long)Allocs.load(), (unsigned long long)Frees.load(), (unsigned long long)Locks.load(),
+			(unsigned long long)(TaggedAllocations() - tagged));
+		AM_CHECK(Allocs.load() == 0);
+		AM_CHECK(Frees.load() == 0);
+		AM_CHECK(Locks.load() == 0);
+		AM_CHECK(TaggedAllocations() == tagged);
+		float peak = 0.0f;
+		for(auto x : out)
+			peak = std::max(peak, fabsf(x));
+		AM_CHECK(peak > 0.1f);   // The voices did get mixed
+
+		for(auto u : U)
+			AcAudio::StopUnit(u, true);
+		callback();
+	}
+
+	AcAudio::Final();
+	puts("realtime: OK");
+	return 0;
+}
+#else
+int main() {
+	puts("realtime: skipped, the interposers need glibc");
+	return AM_TEST_SKIP;
+}
+#endif
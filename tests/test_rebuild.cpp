@@ -0,0 +1,107 @@
+/* Rebuild Tests */
+// A device format change re-decodes resources in the background, and swaps them in on Update() once no offline context
+// can still read the compact blocks being replaced: a finished but unreleased context must not hold the swap back.
+// Offline contexts also keep released resources alive until they are done with them, and the bus fits the blocks of those still played.
+#include "core.cpp"
+#include "test.h"
+
+// Runs Update() until the rebuild is swapped in, or gives up after about a second
+static bool AmTestFinish() {
+	for(int i = 0; i < 100 && PlayerRebuild; i++) {
+		AM_CHECK( AcAudio::Update() );
+		AmTestSleep(10);
+	}
+	return !PlayerRebuild;
+}
+
+int main() {
+	AcAudio::Config config;
+	const char* error = nullptr;
+	AM_CHECK( AcAudio::Init(config, error) );
+	const auto channels = ma_engine_get_channels(&PlayerEngine);
+	const auto rate = ma_engine_get_sample_rate(&PlayerEngine);
+	const auto other = (rate == 44100) ? 48000u : 44100u;
+
+	// A compact resource, read by an offline context that is rendered but kept
+	const auto wav = AmTestSine(rate / 2, 2, rate, 440.0f);
+	const auto R = AcAudio::CreateResource(wav.data(), wav.size(), false, 0.0, true, error);
+	AM_CHECK(R && R -> Compact);
+	const auto O = AcAudio::CreateOffline(500.0, error);
+	AM_CHECK(O);
+	AM_CHECK( AcAudio::OfflineAddUnit(O, R, 0.0, 1.0f) );
+
+	// Not rendered yet: the swap waits
+	AmStartRebuild(channels, other);
+	for(int i = 0; i < 100 && !AmRebuildReady(); i++)
+		AmTestSleep(10);
+	AM_CHECK( AmRebuildReady() );
+	AM_CHECK( AcAudio::Update() );
+	AM_CHECK(PlayerRebuild);
+
+	// Rendered: the context lets go of its cursors, keeps its output, & the swap goes through
+	AM_CHECK( AcAudio::OfflineRender(O) );
+	for(int i = 0; i < 100 && !AcAudio::OfflinePoll(O).Done; i++)
+		AmTestSleep(10);
+	const auto St = AcAudio::OfflinePoll(O);
+	AM_CHECK( St.Done && St.PCM && St.Frames == rate / 2 );
+	AM_CHECK( AmTestFinish() );
+	AM_CHECK( ma_engine_get_sample_rate(&PlayerEngine) == other );
+	AM_CHECK( O -> Compacts.empty() && O -> Units.empty() );
+	AM_CHECK( AcAudio::OfflinePoll(O).PCM == St.PCM );
+	float peak = 0.0f;
+	for(uint64_t i = 0; i < St.Frames * St.Channels; i++)
+		peak = std::max( peak, fabsf(St.PCM[i]) );
+	AM_CHECK(peak > 0.4f);
+
+	// Back, with the context released
+	AcAudio::ReleaseOffline(O);
+	AmStartRebuild(channels, rate);
+	AM_CHECK( AmTestFinish() );
+	AM_CHECK( ma_engine_get_sample_rate(&PlayerEngine) == rate );
+
+	// A resource released while an offline context reads it stays until the context is done with it
+	const auto R2 = AcAudio::CreateResource(wav.data(), wav.size(), false, 0.0, true, error);
+	AM_CHECK(R2 && R2 -> Compact);
+	const auto O2 = AcAudio::CreateOffline(500.0, error);
+	AM_CHECK( O2 && AcAudio::OfflineAddUnit(O2, R2, 0.0, 1.0f) );
+	AcAudio::MemoryStats before, after;
+	AcAudio::GetMemoryStats(before);
+	AcAudio::ReleaseResource(R2);
+	AM_CHECK( R2 -> Released && R2 -> Units == 1 );
+	AM_CHECK( AcAudio::OfflineRender(O2) );
+	for(int i = 0; i < 100 && !AcAudio::OfflinePoll(O2).Done; i++)
+		AmTestSleep(10);
+	const auto St2 = AcAudio::OfflinePoll(O2);
+	AM_CHECK(St2.Done);
+	peak = 0.0f;
+	for(uint64_t i = 0; i < St2.Frames * St2.Channels; i++)
+		peak = std::max( peak, fabsf(St2.PCM[i]) );
+	AM_CHECK(peak > 0.4f);
+	AcAudio::ReleaseOffline(O2);
+	AcAudio::GetMemoryStats(after);
+	AM_CHECK( after.Arenas[AM_MEM_ENCODED].Bytes + wav.size() <= before.Arenas[AM_MEM_ENCODED].Bytes );
+
+	// A released stereo compact resource still playing keeps its blocks through a switch to mono, so the bus cache must fit them
+	const auto R3 = AcAudio::CreateResource(wav.data(), wav.size(), false, 0.0, true, error);
+	AM_CHECK( R3 && R3 -> Compact && R3 -> Compact -> Channels == 2 );
+	double length_ms;
+	const auto U3 = AcAudio::CreateUnit(R3, length_ms);
+	AM_CHECK( U3 && AcAudio::PlayUnit(U3, true, 0.0) );
+	AcAudio::ReleaseResource(R3);
+	AmStartRebuild(1, rate);
+	AM_CHECK( AmTestFinish() );
+	AM_CHECK( ma_engine_get_channels(&PlayerEngine) == 1 && PlayerBus.Widest >= 2 );
+	const auto at = AcAudio::GetTimeFrames(U3);
+	for(int i = 0; i < 100 && AcAudio::GetTimeFrames(U3) == at; i++)
+		AmTestSleep(10);
+	AM_CHECK( AcAudio::GetTimeFrames(U3) != at );
+	AM_CHECK( AcAudio::ReleaseUnit(U3) );
+	AmStartRebuild(channels, rate);
+	AM_CHECK( AmTestFinish() );
+
+	AcAudio::ReleaseResource(R);
+	AM_CHECK( AcAudio::Update() );
+	AcAudio::Final();
+	puts("rebuild: OK");
+	return 0;
+}
@@ -0,0 +1,94 @@
+/* Time Stretching Tests */
+// AmStretch over a plain buffer: bypassing at 1x, stretching, and back to a bit-exact bypass once the rate returns to 1x,
+// with no jump in the output or the chart position on the way.
+#include "core.cpp"
+#include "test.h"
+
+constexpr ma_uint32 C = 2, RATE = 48000, FRAMES = RATE * 20, CHUNK = 480;
+
+static std::vector<float> Signal;
+static ma_audio_buffer_ref Inner;
+static AmStretch T;
+static std::atomic<float> Rate(1.0f);
+static float Last[C];   // Last output frame
+
+static void Read(ma_uint32 n) {
+	std::vector<float> out(n * C);
+	ma_uint64 read = 0, before = 0, after = 0;
+	AM_CHECK( ma_data_source_get_cursor_in_pcm_frames(&T, &before) == MA_SUCCESS );
+	AM_CHECK( ma_data_source_read_pcm_frames(&T, out.data(), n, &read) == MA_SUCCESS && read == n );
+	AM_CHECK( ma_data_source_get_cursor_in_pcm_frames(&T, &after) == MA_SUCCESS );
+	AM_CHECK( after >= before && after <= before + n * AM_RATE_MAX + 1 );   // The chart position moves on, & never jumps
+	for(ma_uint32 i = 0; i < n; i++)
+		for(ma_uint32 c = 0; c < C; c++) {
+			const auto x = out[i * C + c];
+			AM_CHECK( std::isfinite(x) );
+			AM_CHECK( fabsf(x - Last[c]) <= 0.08f );   // The sines move by 0.03 at most per frame
+			Last[c] = x;
+		}
+}
+static void ReadUntilBypass() {
+	// Frame by frame, so that the last read stops right where the bypass starts
+	for(ma_uint32 i = 0; i < RATE && T.Active; i++)
+		Read(1);
+	AM_CHECK(!T.Active);
+
+	// The inner source is where the chart position was, & the output is the inner source itself from there
+	ma_uint64 cursor = 0;
+	AM_CHECK( ma_data_source_get_cursor_in_pcm_frames(&T, &cursor) == MA_SUCCESS );
+	AM_CHECK( fabs(cursor - T.Cursor) <= 1.0 );
+	std::vector<float> out(CHUNK * C);
+	ma_uint64 read = 0;
+	AM_CHECK( ma_data_source_read_pcm_frames(&T, out.data(), CHUNK, &read) == MA_SUCCESS && read == CHUNK );
+	AM_CHECK( fabsf(out[0] - Last[0]) <= 0.08f );
+	AM_CHECK( memcmp(out.data(), &Signal[cursor * C], sizeof(float) * CHUNK * C) == 0 );
+	memcpy( Last, &out[(CHUNK - 1) * C], sizeof(Last) );
+}
+
+int main() {
+	Signal.resize(FRAMES * C);
+	for(ma_uint32 f = 0; f < FRAMES; f++)
+		for(ma_uint32 c = 0; c < C; c++)
+			Signal[f * C + c] = 0.3f * sinf(6.2831853f * (c ? 330.0f : 440.0f) * f / RATE) + 0.2f * sinf(6.2831853f * 1234.5f * f / RATE);
+	AM_CHECK( ma_audio_buffer_ref_init(ma_format_f32, C, Signal.data(), FRAMES, &Inner) == MA_SUCCESS );
+	Inner.sampleRate = RATE;
+	AM_CHECK( AmStretchInit(&T, &Inner, &Rate) == MA_SUCCESS );
+	AmStretchPrepare(&T);
+
+	// 1x from the start: a bypass
+	Read(CHUNK);
+	AM_CHECK( !T.Active );
+	AM_CHECK( memcmp(Last, &Signal[(CHUNK - 1) * C], sizeof(Last)) == 0 );
+
+	// Stretching, then back to 1x
+	Rate = 1.25f;
+	for(int i = 0; i < 20; i++)
+		Read(CHUNK);
+	AM_CHECK( T.Active );
+	Rate = 1.0f;
+	ReadUntilBypass();
+
+	// Again, slower, with the rate changing while the buffered input is going out as is
+	Rate = 0.8f;
+	for(int i = 0; i < 20; i++)
+		Read(CHUNK);
+	Rate = 1.0f;
+	for(int i = 0; i < 4; i++)
+		Read(100);
+	Rate = 1.5f;
+	for(int i = 0; i < 20; i++)
+		Read(CHUNK);
+	Rate = 1.0f;
+	ReadUntilBypass();
+
+	// A seek resets the session
+	Rate = 0.5f;
+	Read(CHUNK);
+	AM_CHECK( ma_data_source_seek_to_pcm_frame(&T, 1000) == MA_SUCCESS );
+	AM_CHECK( !T.Active );
+
+	AmStretchUninit(&T);
+	ma_audio_buffer_ref_uninit(&Inner);
+	puts("stretch: OK");
+	return 0;
+}
@@ -0,0 +1,141 @@
+/* Ogg Vorbis Tests */
+// Files from the test encoder through the custom backend: decoded within its quantization error, with exact lengths,
+// seeks that land on the same frames as a sequential decode, streams read through callbacks, and bad data refused.
+#include "core.cpp"
+#include "test.h"
+#include "vorbis.h"
+
+constexpr ma_uint32 RATE = 48000;
+
+static void Init(ma_decoder& decoder, const std::vector<uint8_t>& ogg) {
+	auto config = ma_decoder_config_init(ma_format_f32, 0, 0);
+		 config.ppCustomBackendVTables	= AmDecoders;
+		 config.customBackendCount		= AM_DECODERS;
+	AM_CHECK( ma_decoder_init_memory(ogg.data(), ogg.size(), &config, &decoder) == MA_SUCCESS );
+}
+static std::vector<float> ReadAll(ma_decoder& decoder, ma_uint32 C) {
+	std::vector<float> out;
+	float chunk[1000 * 8];
+	for(;;) {
+		ma_uint64 read = 0;
+		ma_decoder_read_pcm_frames(&decoder, chunk, 1000, &read);
+		out.insert(out.end(), chunk, chunk + read * C);
+		if(read < 1000)
+			return out;
+	}
+}
+
+template<typename F>
+static std::vector<float> CheckDecode(const char* name, ma_uint32 frames, ma_uint32 C, const F& fn) {
+	const auto ogg = AmTestVorbis(frames, C, RATE, fn);
+	AM_CHECK( !ogg.empty() );
+	const auto P = AmDecodePCM(ogg.data(), ogg.size(), C, RATE);
+	AM_CHECK(P);
+	AM_CHECK(P -> Frames == frames && P -> Channels == C && P -> SampleRate == RATE);
+	double signal = 0.0, noise = 0.0, worst = 0.0;
+	for(ma_uint32 f = 0; f < frames; f++)
+		for(ma_uint32 c = 0; c < C; c++) {
+			const double x = fn(f, c), e = P -> Data[f * C + c] - x;
+			signal += x * x;
+			noise += e * e;
+			worst = std::max(worst, fabs(e));
+		}
+	const auto snr = 10.0 * log10( std::max(signal, 1e-30) / std::max(noise, 1e-30) );
+	printf("%s: %zu bytes, %.1f dB SNR, %.4f worst error\n", name, ogg.size(), snr, worst);
+	AM_CHECK(snr >= 40.0);
+	AM_CHECK(worst <= 0.02);
+	std::vector<float> pcm(P -> Data, P -> Data + frames * C);
+	AmPCMRelease(P);
+	return pcm;
+}
+
+struct Stream {   // A file behind read & seek callbacks, as the VFS hands them over
+	const std::vector<uint8_t>* File;
+	size_t At;
+};
+static ma_result StreamRead(ma_decoder* pDecoder, void* pBufferOut, size_t bytesToRead, size_t* pBytesRead) {
+	const auto S = (Stream*)pDecoder -> pUserData;
+	const auto n = std::min(bytesToRead, S -> File -> size() - S -> At);
+	memcpy(pBufferOut, S -> File -> data() + S -> At, n);
+	S -> At += n;
+	*pBytesRead = n;
+	return n ? MA_SUCCESS : MA_AT_END;
+}
+static ma_result StreamSeek(ma_decoder* pDecoder, ma_int64 byteOffset, ma_seek_origin origin) {
+	const auto S = (Stream*)pDecoder -> pUserData;
+	const auto base = (origin == ma_seek_origin_start) ? 0 : (origin == ma_seek_origin_current) ? (ma_int64)S -> At : (ma_int64)S -> File -> size();
+	S -> At = (size_t)std::max<ma_int64>( 0, std::min<ma_int64>(base + byteOffset, S -> File -> size()) );
+	return MA_SUCCESS;
+}
+
+int main() {
+	// Stereo (coupled, long & short blocks) & mono with silence (unused floors), partial last blocks included
+	const ma_uint32 frames = RATE * 2 + 321;
+	const auto stereo = [](ma_uint32 f, ma_uint32 c) {
+		const float t = (float)f / RATE;
+		return c ? 0.3f * sinf(6.2831853f * 1000.0f * t) + 0.2f * sinf(6.2831853f * 150.0f * t) : 0.5f * sinf(6.2831853f * 440.0f * t);
+	};
+	const auto pcm = CheckDecode("stereo", frames, 2, stereo);
+	CheckDecode("mono, silence", RATE + 77, 1, [](ma_uint32 f, ma_uint32) {
+		return (f > RATE / 4 && f < RATE / 2) ? 0.0f : 0.6f * sinf(0.05f * f);
+	});
+
+	// Seeks land on the sequential frames: within a packet, ahead, far back, & near the end
+	const auto ogg = AmTestVorbis(frames, 2, RATE, stereo);
+	ma_decoder decoder;
+	Init(decoder, ogg);
+	ma_uint64 length = 0;
+	AM_CHECK( ma_decoder_get_length_in_pcm_frames(&decoder, &length) == MA_SUCCESS && length == frames );
+	AM_CHECK( ReadAll(decoder, 2) == pcm );
+	for(const ma_uint64 at : { (ma_uint64)frames / 2, (ma_uint64)frames / 2 + 100, (ma_uint64)frames / 2 + 20000, (ma_uint64)777,
+							   (ma_uint64)frames - 50, (ma_uint64)0, (ma_uint64)frames / 3 }) {
+		AM_CHECK( ma_decoder_seek_to_pcm_frame(&decoder, at) == MA_SUCCESS );
+		float out[500 * 2];
+		ma_uint64 read = 0, cursor = 0;
+		ma_decoder_read_pcm_frames(&decoder, out, 500, &read);
+		AM_CHECK( read == std::min<ma_uint64>(500, frames - at) );
+		AM_CHECK( memcmp(out, &pcm[at * 2], (size_t)read * 2 * sizeof(float)) == 0 );
+		AM_CHECK( ma_decoder_get_cursor_in_pcm_frames(&decoder, &cursor) == MA_SUCCESS && cursor == at + read );
+	}
+	ma_decoder_uninit(&decoder);
+
+	// Through read & seek callbacks, as streams open files
+	Stream S = { &ogg, 0 };
+	auto config = ma_decoder_config_init(ma_format_f32, 0, 0);
+		 config.ppCustomBackendVTables	= AmDecoders;
+		 config.customBackendCount		= AM_DECODERS;
+	AM_CHECK( ma_decoder_init(StreamRead, StreamSeek, &S, &config, &decoder) == MA_SUCCESS );
+	AM_CHECK( ReadAll(decoder, 2) == pcm );
+	ma_decoder_uninit(&decoder);
+
+	// Truncated files decode up to their last whole page; garbage & WAVs go elsewhere
+	const std::vector<uint8_t> cut(ogg.begin(), ogg.begin() + ogg.size() * 3 / 5);
+	const auto P = AmDecodePCM(cut.data(), cut.size(), 2, RATE);
+	AM_CHECK( P && P -> Frames > 0 && P -> Frames < frames );
+	AM_CHECK( memcmp(P -> Data, pcm.data(), (size_t)P -> Frames * 2 * sizeof(float)) == 0 );
+	AmPCMRelease(P);
+	std::vector<uint8_t> garbage(ogg.begin(), ogg.begin() + 200);
+	for(size_t i = 60; i < garbage.size(); i++)
+		garbage[i] ^= 0x5a;
+	AM_CHECK( !AmDecodePCM(garbage.data(), garbage.size(), 2, RATE) );
+	AM_CHECK( !AmDecodePCM(ogg.data(), 3, 2, RATE) );
+	const auto wav = AmTestSine(1000, 2, RATE, 440.0f);
+	const auto W = AmDecodePCM(wav.data(), wav.size(), 2, RATE);
+	AM_CHECK(W && W -> Frames == 1000);
+	AmPCMRelease(W);
+
+	// A Player resource of it
+	AcAudio::Config engine;
+	const char* error = nullptr;
+	AM_CHECK( AcAudio::Init(engine, error) );
+	const auto R = AcAudio::CreateResource(ogg.data(), ogg.size(), false, 0.0, false, error);
+	AM_CHECK(R);
+	double length_ms = 0.0;
+	const auto U = AcAudio::CreateUnit(R, length_ms);
+	AM_CHECK( U && fabs(length_ms - frames * 1000.0 / RATE) <= 1.0 );
+	AM_CHECK( AcAudio::ReleaseUnit(U) );
+	AcAudio::ReleaseResource(R);
+	AcAudio::Final();
+	puts("vorbis: OK");
+	return 0;
+}
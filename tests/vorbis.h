@@ -0,0 +1,423 @@
+/* Ogg Vorbis Test Encoder */
+#pragma once
+
+// A small Vorbis I encoder, so that the tests & benchmarks have Ogg files without a vendored encoder; include it after core.cpp.
+// Mono or stereo, in a fixed pattern of 2048 & 256 blocks: floor 1 posts follow the local peaks, and the residues, coupled
+// for stereo, are quantized to 1/32 of the floor through a coarse & a fine VQ book. The floor curves come from the decoder's
+// own floor code, run over the encoder's own setup header, so that the only error is that quantization.
+
+/* Includes */
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+/* Bits */
+struct AmTestBits {   // LSB-first, as Vorbis packets are read
+	std::vector<uint8_t> Data;
+	size_t At = 0;
+
+	void Write(uint32_t v, int n) {
+		for(int i = 0; i < n; i++, At++) {
+			if( !(At & 7) )
+				Data.push_back(0);
+			Data.back() |= (uint8_t)( ((v >> i) & 1) << (At & 7) );
+		}
+	}
+	void Float(double v) {   // float32_pack
+		int e = 0;
+		const auto mantissa = (v == 0.0) ? 0u : (uint32_t)ldexp( frexp(fabs(v), &e), 21 );
+		Write( (v < 0.0 ? 0x80000000u : 0u) | (v == 0.0 ? 0u : (uint32_t)(e - 21 + 788) << 21) | mantissa, 32 );
+	}
+};
+
+
+/* Codebooks */
+struct AmTestBook {
+	AmVorbisBook K;   // Lengths & codewords, as the decoder assigns them
+	uint32_t Lookup, Bits;
+	double Minimum, Delta;
+	std::vector<uint32_t> Multiplicands;
+
+	void Header(AmTestBits& B) const {
+		B.Write(0x564342, 24);		B.Write(K.Dims, 16);		B.Write(K.Entries, 24);
+		B.Write(0, 1);		B.Write(0, 1);   // Unordered, not sparse
+		for(const auto l : K.Lengths)
+			B.Write(l - 1, 5);
+		B.Write(Lookup, 4);
+		if(Lookup) {
+			B.Float(Minimum);		B.Float(Delta);
+			B.Write(Bits - 1, 4);	B.Write(0, 1);
+			for(const auto m : Multiplicands)
+				B.Write(m, Bits);
+		}
+	}
+	void Write(AmTestBits& B, uint32_t e) const {
+		B.Write(K.Codes[e], K.Lengths[e]);
+	}
+};
+
+// Entries by cost: the shorts lowest-cost ones get length, the others length + 1
+template<typename F>
+static AmTestBook AmTestBookMake(uint32_t dims, uint32_t entries, uint32_t shorts, uint8_t length, const F& cost) {
+	AmTestBook T;
+	T.K.Dims = dims;
+	T.K.Entries = entries;
+	T.Lookup = T.Bits = 0;
+	T.Minimum = T.Delta = 0.0;
+	std::vector<uint32_t> order(entries);
+	for(uint32_t e = 0; e < entries; e++)
+		order[e] = e;
+	std::stable_sort( order.begin(), order.end(), [&cost](uint32_t a, uint32_t b) { return cost(a) < cost(b); } );
+	T.K.Lengths.assign(entries, length + 1);
+	for(uint32_t i = 0; i < shorts; i++)
+		T.K.Lengths[ order[i] ] = length;
+	AmVorbisCodewords(T.K);
+	return T;
+}
+
+
+/* Ogg Pages */
+struct AmTestOgg {
+	std::vector<uint8_t> File, Lacing, Body;
+	int64_t Granule = -1;   // Of the last packet completed on the open page
+	uint32_t Sequence = 0;
+	bool Continued = false;
+
+	void Flush(bool last = false) {
+		if( Lacing.empty() )
+			return;
+		std::vector<uint8_t> page(27);
+		memcpy(&page[0], "OggS", 4);
+		page[5] = (uint8_t)( (Continued ? 1 : 0) | (Sequence ? 0 : 2) | (last ? 4 : 0) );
+		for(int i = 0; i < 8; i++)
+			page[6 + i] = (uint8_t)( (uint64_t)Granule >> (8 * i) );
+		page[14] = 0x41;   // Serial
+		for(int i = 0; i < 4; i++)
+			page[18 + i] = (uint8_t)( Sequence >> (8 * i) );
+		page[26] = (uint8_t)Lacing.size();
+		page.insert( page.end(), Lacing.begin(), Lacing.end() );
+		page.insert( page.end(), Body.begin(), Body.end() );
+		const auto crc = AmOggCRC( page.data(), page.size() );
+		for(int i = 0; i < 4; i++)
+			page[22 + i] = (uint8_t)( crc >> (8 * i) );
+		File.insert( File.end(), page.begin(), page.end() );
+		Continued = Lacing.back() == 255;
+		Lacing.clear();
+		Body.clear();
+		Granule = -1;
+		Sequence++;
+	}
+	void Packet(const std::vector<uint8_t>& packet, int64_t granule) {   // Pages of up to ~4 KB
+		size_t at = 0, segment;
+		do {
+			if( Lacing.size() == 255 || Body.size() >= 4096 )
+				Flush();
+			segment = std::min<size_t>(255, packet.size() - at);
+			Lacing.push_back( (uint8_t)segment );
+			Body.insert( Body.end(), packet.begin() + at, packet.begin() + at + segment );
+			at += segment;
+		} while(segment == 255);
+		Granule = granule;
+	}
+};
+
+
+/* Encoder */
+// fn(frame, channel) returns samples in [-1, 1]
+template<typename F>
+std::vector<uint8_t> AmTestVorbis(uint32_t frames, uint32_t channels, uint32_t rate, const F& fn) {
+	const uint32_t C = channels, blocksize[2] = { 256, 2048 };
+
+	// Books: floor posts, the floor masterbook, residue classes, then coarse (-15..15) & fine (-0.5..0.5 by 1/32) pairs
+	std::vector<AmTestBook> books;
+	books.push_back( AmTestBookMake(1, 256, 256, 8, [](uint32_t) { return 0; }) );
+	books.push_back( AmTestBookMake(1, 4, 4, 2, [](uint32_t) { return 0; }) );
+	books.push_back( AmTestBookMake(2, 4, 4, 2, [](uint32_t) { return 0; }) );
+	books.push_back( AmTestBookMake(2, 961, 63, 9, [](uint32_t e) { return abs((int)(e % 31) - 15) + abs((int)(e / 31) - 15); }) );
+	books.push_back( AmTestBookMake(2, 1089, 959, 10, [](uint32_t e) { return abs((int)(e % 33) - 16) + abs((int)(e / 33) - 16); }) );
+	auto& coarse = books[3];
+		  coarse.Lookup = 1;	coarse.Minimum = -15.0;	coarse.Delta = 1.0;		coarse.Bits = 5;
+	for(uint32_t m = 0; m < 31; m++)
+		coarse.Multiplicands.push_back(m);
+	auto& fine = books[4];
+		  fine.Lookup = 2;		fine.Minimum = -0.5;	fine.Delta = 1.0 / 32;	fine.Bits = 6;
+	for(uint32_t e = 0; e < 1089; e++) {
+		fine.Multiplicands.push_back(e % 33);
+		fine.Multiplicands.push_back(e / 33);
+	}
+
+	// Headers
+	AmTestBits id, comment, setup;
+	const auto magic = [](AmTestBits& B, uint32_t type) {
+		B.Write(type, 8);
+		for(const char* c = "vorbis"; *c; c++)
+			B.Write(*c, 8);
+	};
+	magic(id, 1);
+	id.Write(0, 32);	id.Write(C, 8);		id.Write(rate, 32);
+	id.Write(0, 32);	id.Write(0, 32);	id.Write(0, 32);
+	id.Write(8, 4);		id.Write(11, 4);	id.Write(1, 1);
+	magic(comment, 3);
+	comment.Write(0, 32);	comment.Write(0, 32);	comment.Write(1, 1);
+	magic(setup, 5);
+	setup.Write( (uint32_t)books.size() - 1, 8 );
+	for(const auto& T : books)
+		T.Header(setup);
+	setup.Write(0, 6);		setup.Write(0, 16);   // Time placeholder
+	setup.Write(1, 6);   // 2 floors: type 1, partitions of classes 0, 1, 0, 1...; posts spread quadratically
+	const uint32_t floor_bits[2] = { 7, 10 }, floor_parts[2] = { 8, 16 };
+	for(int w = 0; w < 2; w++) {
+		setup.Write(1, 16);
+		setup.Write(floor_parts[w], 5);
+		uint32_t posts = 0;
+		for(uint32_t p = 0; p < floor_parts[w]; p++) {
+			setup.Write(p & 1, 4);
+			posts += (p & 1) + 1;
+		}
+		setup.Write(0, 3);		setup.Write(0, 2);		setup.Write(1, 8);   // Class 0: 1 post by book 0
+		setup.Write(1, 3);		setup.Write(1, 2);		setup.Write(1, 8);   // Class 1: 2 posts, by book 0 if flagged by book 1
+		setup.Write(0, 8);		setup.Write(1, 8);
+		setup.Write(0, 2);		setup.Write(floor_bits[w], 4);
+		for(uint32_t i = 0; i < posts; i++)
+			setup.Write( (i + 1) * (i + 1) * (1u << floor_bits[w]) / ((posts + 1) * (posts + 1)) + 1, floor_bits[w] );
+	}
+	setup.Write(1, 6);   // 2 residues: type 0 for short blocks, type 2 for long ones; class 1 goes coarse then fine
+	const uint32_t residue_type[2] = { 0, 2 }, residue_end[2] = { 128, 2048 }, residue_size[2] = { 16, 32 };
+	for(int w = 0; w < 2; w++) {
+		setup.Write(residue_type[w], 16);
+		setup.Write(0, 24);		setup.Write(residue_end[w], 24);	setup.Write(residue_size[w] - 1, 24);
+		setup.Write(1, 6);		setup.Write(2, 8);
+		setup.Write(0, 3);		setup.Write(0, 1);
+		setup.Write(3, 3);		setup.Write(0, 1);
+		setup.Write(3, 8);		setup.Write(4, 8);
+	}
+	setup.Write(1, 6);   // 2 mappings, coupling stereo
+	for(int w = 0; w < 2; w++) {
+		setup.Write(0, 16);
+		setup.Write(0, 1);
+		setup.Write(C == 2, 1);
+		if(C == 2) {
+			setup.Write(0, 8);
+			setup.Write(0, 1);		setup.Write(1, 1);
+		}
+		setup.Write(0, 2);
+		setup.Write(0, 8);		setup.Write(w, 8);		setup.Write(w, 8);
+	}
+	setup.Write(1, 6);   // 2 modes
+	for(int w = 0; w < 2; w++) {
+		setup.Write(w, 1);		setup.Write(0, 16);		setup.Write(0, 16);		setup.Write(w, 8);
+	}
+	setup.Write(1, 1);
+
+	AmTestOgg ogg;
+	ogg.Packet(id.Data, 0);
+	ogg.Flush();
+	ogg.Packet(comment.Data, 0);
+	ogg.Packet(setup.Data, 0);
+	ogg.Flush();
+
+	// The decoder's view of the setup, for its floor curves
+	AmVorbis H{};
+	H.Data = ogg.File.data();
+	H.Size = ogg.File.size();
+	if( !AmOggIndex(&H) || !AmVorbisSetup(&H) )
+		return {};
+	const auto db = AmVorbisInverseDB();
+
+	// DCT-IV tables, of cos(pi * j / 4N) over a period
+	std::vector<double> cosines[2];
+	for(int w = 0; w < 2; w++) {
+		const auto N = blocksize[w] / 2;
+		for(uint32_t j = 0; j < 8 * N; j++)
+			cosines[w].push_back( cos(3.14159265358979 * j / (4.0 * N)) );
+	}
+	std::vector<float> input( (size_t)frames * C );
+	for(uint32_t f = 0; f < frames; f++)
+		for(uint32_t c = 0; c < C; c++)
+			input[(size_t)f * C + c] = std::max( -1.0f, std::min(1.0f, (float)fn(f, c)) );
+	const auto slope = [](uint32_t i, uint32_t n) {
+		const auto s = sin( (i + 0.5) / n * 1.5707963267949 );
+		return sin( 1.5707963267949 * s * s );
+	};
+
+	// Blocks: 10 long, then 6 short, over & over; each one's center is where its packet's granule counts to
+	const auto long_block = [](uint64_t k) { return k % 16 < 10; };
+	int64_t s = -(int64_t)blocksize[1] / 2;
+	for(uint64_t k = 0; ; k++) {
+		const int w = long_block(k);
+		const uint32_t n = blocksize[w], half = n / 2, b0 = blocksize[0];
+		const bool prev = k ? long_block(k - 1) : true, next = long_block(k + 1);
+		const uint32_t left_start = (!w || prev) ? 0 : n / 4 - b0 / 4, left_n = (!w || prev) ? half : b0 / 2;
+		const uint32_t right_start = (!w || next) ? half : 3 * n / 4 - b0 / 4, right_n = (!w || next) ? half : b0 / 2;
+
+		// Windowed MDCT per channel, scaled by 4/n for the unscaled inverse
+		std::vector<std::vector<double>> X( C, std::vector<double>(half) );
+		std::vector<double> z(n), fold(half);
+		for(uint32_t c = 0; c < C; c++) {
+			for(uint32_t i = 0; i < n; i++) {
+				const auto t = s + (int64_t)i;
+				const double x = (t >= 0 && t < (int64_t)frames) ? input[(size_t)t * C + c] : 0.0;
+				double win = 1.0;
+				if(i < left_start || i >= right_start + right_n)
+					win = 0.0;
+				else if(i < left_start + left_n)
+					win = slope(i - left_start, left_n);
+				else if(i >= right_start)
+					win = slope(right_start + right_n - 1 - i, right_n);
+				z[i] = x * win;
+			}
+			const auto q = half / 2;
+			for(uint32_t j = 0; j < half; j++)
+				fold[j] = (j >= q) ? z[j - q] - z[3 * q - 1 - j] : -z[3 * q - 1 - j] - z[j + 3 * q];
+			const auto period = 8 * half;
+			for(uint32_t m = 0; m < half; m++) {
+				double sum = 0.0;
+				for(uint32_t j = 0, at = 2 * m + 1; j < half; j++, at = (at + 2 * (2 * m + 1)) % period)
+					sum += fold[j] * cosines[w][at];
+				X[c][m] = sum * 4.0 / n;
+			}
+		}
+
+		// Floor posts at the peaks around them, shared by the channels; unused in silence
+		const auto& Fl = H.Floors[w];
+		const auto posts = Fl.X.size();
+		double loudest = 0.0;
+		for(uint32_t c = 0; c < C; c++)
+			for(const auto v : X[c])
+				loudest = std::max(loudest, fabs(v));
+		AmTestBits floor;
+		std::vector<float> curve(half, 0.0f);
+		if(loudest > 0.0) {
+			int target[65], Y[65], val[65];
+			for(size_t p = 0; p < posts; p++) {
+				const auto at = std::find( Fl.Sorted.begin(), Fl.Sorted.end(), (uint8_t)p ) - Fl.Sorted.begin();
+				const uint32_t from = at ? Fl.X[ Fl.Sorted[at - 1] ] : 0;
+				const uint32_t to = std::min<uint32_t>( half, (size_t)at + 1 < posts ? Fl.X[ Fl.Sorted[at + 1] ] + 1 : half );
+				double peak = 0.0;
+				for(uint32_t c = 0; c < C; c++)
+					for(uint32_t i = from; i < to; i++)
+						peak = std::max(peak, fabs(X[c][i]));
+				target[p] = 0;
+				while( target[p] < 255 && db[ target[p] ] < peak / 7.0 )
+					target[p]++;
+			}
+			Y[0] = val[0] = target[0];
+			Y[1] = val[1] = target[1];
+			for(size_t p = 2; p < posts; p++) {   // The amplitude step of the decoder, searched for the target
+				const int lo = Fl.Low[p], hi = Fl.High[p];
+				const int predicted = AmRenderPoint(Fl.X[lo], Y[lo], Fl.X[hi], Y[hi], Fl.X[p]);
+				const int highroom = 256 - predicted, lowroom = predicted, room = std::min(highroom, lowroom) * 2;
+				int best = 0, best_y = -1;   // Never 0 while another value fits: the post then gets drawn, & holds up its region
+				for(int v = 1; v < 256; v++) {
+					const int y = (v >= room) ? ( (highroom > lowroom) ? v - lowroom + predicted : predicted - v + highroom - 1 )
+											  : ( (v & 1) ? predicted - (v + 1) / 2 : predicted + v / 2 );
+					if( y >= target[p] && (best_y < 0 || y < best_y) ) {
+						best = v;
+						best_y = y;
+					}
+				}
+				val[p] = best;
+				Y[p] = (best_y < 0) ? predicted : best_y;
+			}
+			floor.Write(1, 1);
+			floor.Write(val[0], 8);
+			floor.Write(val[1], 8);
+			size_t offset = 2;
+			for(const auto cls : Fl.Partitions) {
+				uint32_t flags = 0;
+				if( Fl.ClassSubs[cls] ) {
+					for(int d = 0; d < Fl.ClassDims[cls]; d++)
+						flags |= (uint32_t)(val[offset + d] != 0) << d;
+					books[ Fl.ClassMaster[cls] ].Write(floor, flags);
+				}
+				for(int d = 0; d < Fl.ClassDims[cls]; d++) {
+					const int book = Fl.SubBooks[cls][ (flags >> d) & 1 ];
+					if(book >= 0)
+						books[book].Write(floor, val[offset + d]);
+				}
+				offset += Fl.ClassDims[cls];
+			}
+			AmVorbisBits B( floor.Data.data(), floor.Data.size() );
+			if( !AmVorbisFloorCurve(&H, Fl, B, w, curve.data()) )
+				return {};
+		}
+		else
+			floor.Write(0, 1);
+
+		// Residues on a grid of 1/32 of the curve, so that coupling them is exact
+		std::vector<std::vector<double>> R( C, std::vector<double>(half, 0.0) );
+		if(loudest > 0.0)
+			for(uint32_t c = 0; c < C; c++)
+				for(uint32_t i = 0; i < half; i++)
+					R[c][i] = std::max( -7.5, std::min(7.5, round(X[c][i] / curve[i] * 32.0) / 32.0) );
+		if(C == 2)
+			for(uint32_t i = 0; i < half; i++) {
+				const auto L = R[0][i], Rt = R[1][i];
+				if(L > 0.0 && Rt < L)				{ R[0][i] = L;	R[1][i] = L - Rt; }
+				else if(Rt > 0.0 && L <= Rt)		{ R[0][i] = Rt;	R[1][i] = L - Rt; }
+				else if(L <= 0.0 && Rt > L)			{ R[0][i] = L;	R[1][i] = Rt - L; }
+				else								{ R[0][i] = Rt;	R[1][i] = Rt - L; }
+			}
+
+		// Packet: header, floors, then the residue in the decoder's order of passes, classes & vectors
+		AmTestBits packet;
+		packet.Write(0, 1);
+		packet.Write(w, 1);
+		if(w) {
+			packet.Write(prev, 1);
+			packet.Write(next, 1);
+		}
+		for(uint32_t c = 0; c < C; c++)
+			for(size_t b = 0; b < floor.At; b++)
+				packet.Write( (floor.Data[b >> 3] >> (b & 7)) & 1, 1 );
+		if(loudest > 0.0) {
+			std::vector<std::vector<double>> vectors;
+			if(residue_type[w] == 2) {
+				vectors.assign( 1, std::vector<double>(half * C) );
+				for(uint32_t i = 0; i < half; i++)
+					for(uint32_t c = 0; c < C; c++)
+						vectors[0][i * C + c] = R[c][i];
+			}
+			else
+				vectors = R;
+			const auto size = residue_size[w], parts = std::min<uint32_t>( residue_end[w], (uint32_t)vectors[0].size() ) / size;
+			const auto step = residue_type[w] ? 1 : size / 2, pairs = size / 2;
+			std::vector<std::vector<int>> classes( vectors.size(), std::vector<int>(parts) );
+			for(size_t c = 0; c < vectors.size(); c++)
+				for(uint32_t p = 0; p < parts; p++)
+					for(uint32_t i = 0; i < size; i++)
+						classes[c][p] |= vectors[c][p * size + i] != 0.0;
+			for(int pass = 0; pass < 2; pass++)
+				for(uint32_t p = 0; p < parts; ) {
+					if(!pass)
+						for(size_t c = 0; c < vectors.size(); c++)
+							books[2].Write( packet, classes[c][p] * 2 + (p + 1 < parts ? classes[c][p + 1] : 0) );
+					for(int i = 0; i < 2 && p < parts; i++, p++)
+						for(size_t c = 0; c < vectors.size(); c++) {
+							if( !classes[c][p] )
+								continue;
+							const auto v = &vectors[c][p * size];
+							for(uint32_t j = 0; j < pairs; j++) {
+								const auto a = v[ residue_type[w] ? 2 * j : j ], b = v[ residue_type[w] ? 2 * j + 1 : j + step ];
+								const auto qa = lround(a), qb = lround(b);
+								if(!pass)
+									books[3].Write( packet, (uint32_t)(qa + 15 + 31 * (qb + 15)) );
+								else
+									books[4].Write( packet, (uint32_t)(lround((a - qa) * 32.0) + 16 + 33 * (lround((b - qb) * 32.0) + 16)) );
+							}
+						}
+				}
+		}
+
+		const auto granule = s + (int64_t)half;
+		ogg.Packet(packet.Data, granule);
+		if( granule >= (int64_t)frames )
+			break;
+		s += (int64_t)(3 * n / 4) - (int64_t)blocksize[long_block(k + 1)] / 4;
+	}
+	ogg.Granule = frames;
+	ogg.Flush(true);
+	return ogg.File;
+}